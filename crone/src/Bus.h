@@ -7,6 +7,7 @@
 
 #include <cassert>
 
+#include "BusKernels.h"
 #include "Utilities.h"
 
 namespace crone {
@@ -15,15 +16,35 @@ template <size_t NumChannels, size_t BlockSize> class Bus {
   private:
     typedef Bus<NumChannels, BlockSize> BusT;
 
+    // constant gains, for ramps that have settled: skip, plain add or copy for 0 and 1
+    static void mixConst(float *dst, const float *src, float g, size_t numFrames) {
+        if (g == 0.f) {
+            return;
+        }
+        if (g == 1.f) {
+            kernels::add(dst, src, numFrames);
+        } else {
+            kernels::addScaled(dst, src, g, numFrames);
+        }
+    }
+
+    static void setConst(float *dst, const float *src, float g, size_t numFrames) {
+        if (g == 0.f) {
+            kernels::clear(dst, numFrames);
+        } else if (g == 1.f) {
+            kernels::copy(dst, src, numFrames);
+        } else {
+            kernels::setScaled(dst, src, g, numFrames);
+        }
+    }
+
   public:
     float buf[NumChannels][BlockSize];
 
     // clear the entire bus
     void clear() {
         for (size_t ch = 0; ch < NumChannels; ++ch) {
-            for (size_t fr = 0; fr < BlockSize; ++fr) {
-                buf[ch][fr] = 0.f;
-            }
+            kernels::clear(buf[ch], BlockSize);
         }
     }
 
@@ -31,9 +52,7 @@ template <size_t NumChannels, size_t BlockSize> class Bus {
     void clear(size_t numFrames) {
         assert(numFrames < BlockSize);
         for (size_t ch = 0; ch < NumChannels; ++ch) {
-            for (size_t fr = 0; fr < numFrames; ++fr) {
-                buf[ch][fr] = 0.f;
-            }
+            kernels::clear(buf[ch], numFrames);
         }
     }
 
@@ -41,9 +60,7 @@ template <size_t NumChannels, size_t BlockSize> class Bus {
     void copyFrom(Bus &b, size_t numFrames) {
         assert(numFrames < BlockSize);
         for (size_t ch = 0; ch < NumChannels; ++ch) {
-            for (size_t fr = 0; fr < numFrames; ++fr) {
-                buf[ch][fr] = b.buf[ch][fr];
-            }
+            kernels::copy(buf[ch], b.buf[ch], numFrames);
         }
     }
 
@@ -51,9 +68,7 @@ template <size_t NumChannels, size_t BlockSize> class Bus {
     void copyTo(float *dst[NumChannels], size_t numFrames) {
         assert(numFrames < BlockSize);
         for (size_t ch = 0; ch < NumChannels; ++ch) {
-            for (size_t fr = 0; fr < numFrames; ++fr) {
-                dst[ch][fr] = buf[ch][fr];
-            }
+            kernels::copy(dst[ch], buf[ch], numFrames);
         }
     }
 
@@ -61,9 +76,7 @@ template <size_t NumChannels, size_t BlockSize> class Bus {
     void addFrom(BusT &b, size_t numFrames) {
         assert(numFrames < BlockSize);
         for (size_t ch = 0; ch < NumChannels; ++ch) {
-            for (size_t fr = 0; fr < numFrames; ++fr) {
-                buf[ch][fr] += b.buf[ch][fr];
-            }
+            kernels::add(buf[ch], b.buf[ch], numFrames);
         }
     }
 
@@ -71,148 +84,205 @@ template <size_t NumChannels, size_t BlockSize> class Bus {
     void mixFrom(BusT &b, size_t numFrames, float level) {
         assert(numFrames < BlockSize);
         for (size_t ch = 0; ch < NumChannels; ++ch) {
-            for (size_t fr = 0; fr < numFrames; ++fr) {
-                buf[ch][fr] += b.buf[ch][fr] * level;
-            }
+            mixConst(buf[ch], b.buf[ch], level, numFrames);
         }
     }
 
     // mix from bus, with smoothed amplitude
     void mixFrom(BusT &b, size_t numFrames, LogRamp &level) {
         assert(numFrames < BlockSize);
-        float l;
-        for (size_t fr = 0; fr < numFrames; ++fr) {
-            l = level.update();
-            for (size_t ch = 0; ch < NumChannels; ++ch) {
-                buf[ch][fr] += b.buf[ch][fr] * l;
-            }
+        if (level.isSteady()) {
+            mixFrom(b, numFrames, level.getTarget());
+            return;
+        }
+        alignas(16) float l[BlockSize];
+        level.update(l, numFrames);
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            kernels::addMul(buf[ch], b.buf[ch], l, numFrames);
         }
     }
 
     // apply smoothed amplitude
     void applyGain(size_t numFrames, LogRamp &level) {
         assert(numFrames < BlockSize);
-        float l;
-        for (size_t fr = 0; fr < numFrames; ++fr) {
-            l = level.update();
+        if (level.isSteady()) {
+            float g = level.getTarget();
+            if (g == 1.f) {
+                return;
+            }
             for (size_t ch = 0; ch < NumChannels; ++ch) {
-                buf[ch][fr] *= l;
+                if (g == 0.f) {
+                    kernels::clear(buf[ch], numFrames);
+                } else {
+                    kernels::scale(buf[ch], g, numFrames);
+                }
             }
+            return;
+        }
+        alignas(16) float l[BlockSize];
+        level.update(l, numFrames);
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            kernels::mul(buf[ch], l, numFrames);
         }
     }
 
     // mix from pointer array, with smoothed amplitude
     void mixFrom(const float *src[NumChannels], size_t numFrames, LogRamp &level) {
         assert(numFrames < BlockSize);
-        float l;
-        for (size_t fr = 0; fr < numFrames; ++fr) {
-            l = level.update();
+        if (level.isSteady()) {
             for (size_t ch = 0; ch < NumChannels; ++ch) {
-                buf[ch][fr] += src[ch][fr] * l;
+                mixConst(buf[ch], src[ch], level.getTarget(), numFrames);
             }
+            return;
+        }
+        alignas(16) float l[BlockSize];
+        level.update(l, numFrames);
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            kernels::addMul(buf[ch], src[ch], l, numFrames);
         }
     }
 
     // set from pointer array, with smoothed amplitude
     void setFrom(const float *src[NumChannels], size_t numFrames, LogRamp &level) {
         assert(numFrames < BlockSize);
-        float l;
-        for (size_t fr = 0; fr < numFrames; ++fr) {
-            l = level.update();
+        if (level.isSteady()) {
             for (size_t ch = 0; ch < NumChannels; ++ch) {
-                buf[ch][fr] = src[ch][fr] * l;
+                setConst(buf[ch], src[ch], level.getTarget(), numFrames);
             }
+            return;
+        }
+        alignas(16) float l[BlockSize];
+        level.update(l, numFrames);
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            kernels::setMul(buf[ch], src[ch], l, numFrames);
         }
     }
 
     // set from pointer array, without scaling
     void setFrom(const float *src[NumChannels], size_t numFrames) {
         assert(numFrames < BlockSize);
-        for (size_t fr = 0; fr < numFrames; ++fr) {
-            for (size_t ch = 0; ch < NumChannels; ++ch) {
-                buf[ch][fr] = src[ch][fr];
-            }
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            kernels::copy(buf[ch], src[ch], numFrames);
         }
     }
 
     // mix to pointer array, with smoothed amplitude
     void mixTo(float *dst[NumChannels], size_t numFrames, LogRamp &level) {
         assert(numFrames < BlockSize);
-        float l;
-        for (size_t fr = 0; fr < numFrames; ++fr) {
-            l = level.update();
+        if (level.isSteady()) {
             for (size_t ch = 0; ch < NumChannels; ++ch) {
-                dst[ch][fr] = buf[ch][fr] * l;
+                setConst(dst[ch], buf[ch], level.getTarget(), numFrames);
             }
+            return;
+        }
+        alignas(16) float l[BlockSize];
+        level.update(l, numFrames);
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            kernels::setMul(dst[ch], buf[ch], l, numFrames);
         }
     }
 
     // mix from stereo bus with 2x2 level matrix
     void stereoMixFrom(BusT &b, size_t numFrames, const float level[4]) {
         assert(numFrames < BlockSize);
-        for (size_t fr = 0; fr < numFrames; ++fr) {
-            buf[0][fr] += b.buf[0][fr] * level[0] + b.buf[1][fr] * level[2];
-            buf[1][fr] += b.buf[0][fr] * level[1] + b.buf[1][fr] * level[3];
-        }
+        kernels::addScaled2(buf[0], b.buf[0], level[0], b.buf[1], level[2], numFrames);
+        kernels::addScaled2(buf[1], b.buf[0], level[1], b.buf[1], level[3], numFrames);
     }
 
     // mix from two busses with balance coefficient (linear)
     void xfade(BusT &a, BusT &b, size_t numFrames, LogRamp &level) {
         assert(numFrames < BlockSize);
-        float x, y, c;
-        for (size_t fr = 0; fr < numFrames; ++fr) {
-            c = level.update();
+        if (level.isSteady()) {
+            float c = level.getTarget();
             for (size_t ch = 0; ch < NumChannels; ++ch) {
-                x = a.buf[ch][fr];
-                y = b.buf[ch][fr];
-                buf[ch][fr] = x + (y - x) * c;
+                if (c == 0.f) {
+                    kernels::copy(buf[ch], a.buf[ch], numFrames);
+                } else if (c == 1.f) {
+                    kernels::copy(buf[ch], b.buf[ch], numFrames);
+                } else {
+                    kernels::setScaled2(buf[ch], a.buf[ch], 1.f - c, b.buf[ch], c, numFrames);
+                }
             }
+            return;
+        }
+        alignas(16) float c[BlockSize];
+        level.update(c, numFrames);
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            kernels::lerp(buf[ch], a.buf[ch], b.buf[ch], c, numFrames);
         }
     }
 
     // mix from two busses with balance coefficient (equal power)
     void xfadeEp(BusT &a, BusT &b, size_t numFrames, LogRamp &level) {
         assert(numFrames < BlockSize);
-        float x, y, l, c, d;
-        for (size_t fr = 0; fr < numFrames; ++fr) {
-            l = level.update() * (float)M_PI_2;
-            c = sinf(l);
-            d = cosf(l);
+        if (level.isSteady()) {
+            float l = level.getTarget() * (float)M_PI_2;
+            float c = sinf(l);
+            float d = cosf(l);
             for (size_t ch = 0; ch < NumChannels; ++ch) {
-                x = a.buf[ch][fr];
-                y = b.buf[ch][fr];
-                buf[ch][fr] = x * c + y * d;
+                kernels::setScaled2(buf[ch], a.buf[ch], c, b.buf[ch], d, numFrames);
             }
+            return;
+        }
+        alignas(16) float c[BlockSize];
+        alignas(16) float d[BlockSize];
+        level.update(c, numFrames);
+        for (size_t fr = 0; fr < numFrames; ++fr) {
+            float l = c[fr] * (float)M_PI_2;
+            c[fr] = sinf(l);
+            d[fr] = cosf(l);
+        }
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            kernels::setMul2(buf[ch], a.buf[ch], c, b.buf[ch], d, numFrames);
         }
     }
 
     // mix from mono->stereo bus, with level and pan (linear)
-    void panMixFrom(Bus<1, BlockSize> a, size_t numFrames, LogRamp &level, LogRamp &pan) {
+    void panMixFrom(const Bus<1, BlockSize> &a, size_t numFrames, LogRamp &level, LogRamp &pan) {
         assert(numFrames < BlockSize);
         static_assert(NumChannels > 1, "using panMixFrom() on mono bus");
-        float l, c, x;
+        if (level.isSteady() && pan.isSteady()) {
+            float g = level.getTarget();
+            float c = pan.getTarget();
+            mixConst(buf[0], a.buf[0], g * (1.f - c), numFrames);
+            mixConst(buf[1], a.buf[0], g * c, numFrames);
+            return;
+        }
+        alignas(16) float l[BlockSize];
+        alignas(16) float r[BlockSize];
+        level.update(l, numFrames);
+        pan.update(r, numFrames);
         for (size_t fr = 0; fr < numFrames; ++fr) {
-            x = a.buf[0][fr];
-            l = level.update();
-            c = pan.update();
-            buf[0][fr] += x * l * (1.f - c);
-            buf[1][fr] += x * l * c;
+            float c = r[fr];
+            r[fr] = l[fr] * c;
+            l[fr] *= 1.f - c;
         }
+        kernels::addMul(buf[0], a.buf[0], l, numFrames);
+        kernels::addMul(buf[1], a.buf[0], r, numFrames);
     }
 
     // mix from mono->stereo bus, with level and pan (equal power)
-    void panMixEpFrom(Bus<1, BlockSize> a, size_t numFrames, LogRamp &level, LogRamp &pan) {
+    void panMixEpFrom(const Bus<1, BlockSize> &a, size_t numFrames, LogRamp &level, LogRamp &pan) {
         assert(numFrames < BlockSize);
         static_assert(NumChannels > 1, "using panMixFrom() on mono bus");
-        float l, c, x;
+        if (level.isSteady() && pan.isSteady()) {
+            float g = level.getTarget();
+            float c = pan.getTarget() * (float)M_PI_2;
+            mixConst(buf[0], a.buf[0], g * cosf(c), numFrames);
+            mixConst(buf[1], a.buf[0], g * sinf(c), numFrames);
+            return;
+        }
+        alignas(16) float l[BlockSize];
+        alignas(16) float r[BlockSize];
+        level.update(l, numFrames);
+        pan.update(r, numFrames);
         for (size_t fr = 0; fr < numFrames; ++fr) {
-            x = a.buf[0][fr];
-            l = level.update();
-            c = pan.update();
-            c *= (float)M_PI_2;
-            buf[0][fr] += x * l * cosf(c);
-            buf[1][fr] += x * l * sinf(c);
+            float c = r[fr] * (float)M_PI_2;
+            r[fr] = l[fr] * sinf(c);
+            l[fr] *= cosf(c);
         }
+        kernels::addMul(buf[0], a.buf[0], l, numFrames);
+        kernels::addMul(buf[1], a.buf[0], r, numFrames);
     }
 };
 
@@ -0,0 +1,272 @@
+//
+// vector kernels for Bus: each works on one channel, a contiguous run of floats.
+//
+// the scalar versions are the reference, and what's used where there's no SSE or NEON.
+// the vector versions do the same arithmetic, four frames at a time, and hand any leftover
+// frames to the scalar version. results can still differ in the last bit: the compiler is free
+// to fuse the scalar multiply-adds (-ffp-contract, and the embedded release build's -ffast-math)
+// or reassociate them, so compare against the scalar code with a tolerance.
+//
+
+#ifndef CRONE_BUSKERNELS_H
+#define CRONE_BUSKERNELS_H
+
+#include <cstddef>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define CRONE_BUS_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CRONE_BUS_NEON 1
+#endif
+
+namespace crone {
+namespace kernels {
+
+namespace scalar {
+
+inline void clear(float *dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = 0.f;
+    }
+}
+
+inline void copy(float *dst, const float *src, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+// dst += src
+inline void add(float *dst, const float *src, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] += src[i];
+    }
+}
+
+// dst += src * k
+inline void addScaled(float *dst, const float *src, float k, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] += src[i] * k;
+    }
+}
+
+// dst += a * ka + b * kb
+inline void addScaled2(float *dst, const float *a, float ka, const float *b, float kb, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] += a[i] * ka + b[i] * kb;
+    }
+}
+
+// dst *= k
+inline void scale(float *dst, float k, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] *= k;
+    }
+}
+
+// dst = src * k
+inline void setScaled(float *dst, const float *src, float k, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = src[i] * k;
+    }
+}
+
+// dst = a * ka + b * kb
+inline void setScaled2(float *dst, const float *a, float ka, const float *b, float kb, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = a[i] * ka + b[i] * kb;
+    }
+}
+
+// dst += src * g
+inline void addMul(float *dst, const float *src, const float *g, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] += src[i] * g[i];
+    }
+}
+
+// dst *= g
+inline void mul(float *dst, const float *g, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] *= g[i];
+    }
+}
+
+// dst = src * g
+inline void setMul(float *dst, const float *src, const float *g, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = src[i] * g[i];
+    }
+}
+
+// dst = a + (b - a) * c
+inline void lerp(float *dst, const float *a, const float *b, const float *c, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = a[i] + (b[i] - a[i]) * c[i];
+    }
+}
+
+// dst = a * ga + b * gb
+inline void setMul2(float *dst, const float *a, const float *ga, const float *b, const float *gb, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = a[i] * ga[i] + b[i] * gb[i];
+    }
+}
+
+} // namespace scalar
+
+#if defined(CRONE_BUS_SSE) || defined(CRONE_BUS_NEON)
+
+namespace simd {
+
+#if defined(CRONE_BUS_SSE)
+typedef __m128 vec;
+inline vec load(const float *p) { return _mm_loadu_ps(p); }
+inline void store(float *p, vec v) { _mm_storeu_ps(p, v); }
+inline vec splat(float x) { return _mm_set1_ps(x); }
+inline vec add(vec a, vec b) { return _mm_add_ps(a, b); }
+inline vec sub(vec a, vec b) { return _mm_sub_ps(a, b); }
+inline vec mul(vec a, vec b) { return _mm_mul_ps(a, b); }
+#else
+typedef float32x4_t vec;
+inline vec load(const float *p) { return vld1q_f32(p); }
+inline void store(float *p, vec v) { vst1q_f32(p, v); }
+inline vec splat(float x) { return vdupq_n_f32(x); }
+inline vec add(vec a, vec b) { return vaddq_f32(a, b); }
+inline vec sub(vec a, vec b) { return vsubq_f32(a, b); }
+// not vmlaq/vfmaq: a separate multiply and add, as written in the scalar code
+inline vec mul(vec a, vec b) { return vmulq_f32(a, b); }
+#endif
+
+enum { Width = 4 };
+
+} // namespace simd
+
+// compilers already turn these into memset and memcpy
+using scalar::clear;
+using scalar::copy;
+
+inline void add(float *dst, const float *src, size_t n) {
+    size_t i = 0;
+    for (; i + simd::Width <= n; i += simd::Width) {
+        simd::store(dst + i, simd::add(simd::load(dst + i), simd::load(src + i)));
+    }
+    scalar::add(dst + i, src + i, n - i);
+}
+
+inline void addScaled(float *dst, const float *src, float k, size_t n) {
+    const simd::vec kv = simd::splat(k);
+    size_t i = 0;
+    for (; i + simd::Width <= n; i += simd::Width) {
+        simd::store(dst + i, simd::add(simd::load(dst + i), simd::mul(simd::load(src + i), kv)));
+    }
+    scalar::addScaled(dst + i, src + i, k, n - i);
+}
+
+inline void addScaled2(float *dst, const float *a, float ka, const float *b, float kb, size_t n) {
+    const simd::vec kav = simd::splat(ka);
+    const simd::vec kbv = simd::splat(kb);
+    size_t i = 0;
+    for (; i + simd::Width <= n; i += simd::Width) {
+        simd::vec x = simd::add(simd::mul(simd::load(a + i), kav), simd::mul(simd::load(b + i), kbv));
+        simd::store(dst + i, simd::add(simd::load(dst + i), x));
+    }
+    scalar::addScaled2(dst + i, a + i, ka, b + i, kb, n - i);
+}
+
+inline void scale(float *dst, float k, size_t n) {
+    const simd::vec kv = simd::splat(k);
+    size_t i = 0;
+    for (; i + simd::Width <= n; i += simd::Width) {
+        simd::store(dst + i, simd::mul(simd::load(dst + i), kv));
+    }
+    scalar::scale(dst + i, k, n - i);
+}
+
+inline void setScaled(float *dst, const float *src, float k, size_t n) {
+    const simd::vec kv = simd::splat(k);
+    size_t i = 0;
+    for (; i + simd::Width <= n; i += simd::Width) {
+        simd::store(dst + i, simd::mul(simd::load(src + i), kv));
+    }
+    scalar::setScaled(dst + i, src + i, k, n - i);
+}
+
+inline void setScaled2(float *dst, const float *a, float ka, const float *b, float kb, size_t n) {
+    const simd::vec kav = simd::splat(ka);
+    const simd::vec kbv = simd::splat(kb);
+    size_t i = 0;
+    for (; i + simd::Width <= n; i += simd::Width) {
+        simd::store(dst + i, simd::add(simd::mul(simd::load(a + i), kav), simd::mul(simd::load(b + i), kbv)));
+    }
+    scalar::setScaled2(dst + i, a + i, ka, b + i, kb, n - i);
+}
+
+inline void addMul(float *dst, const float *src, const float *g, size_t n) {
+    size_t i = 0;
+    for (; i + simd::Width <= n; i += simd::Width) {
+        simd::store(dst + i, simd::add(simd::load(dst + i), simd::mul(simd::load(src + i), simd::load(g + i))));
+    }
+    scalar::addMul(dst + i, src + i, g + i, n - i);
+}
+
+inline void mul(float *dst, const float *g, size_t n) {
+    size_t i = 0;
+    for (; i + simd::Width <= n; i += simd::Width) {
+        simd::store(dst + i, simd::mul(simd::load(dst + i), simd::load(g + i)));
+    }
+    scalar::mul(dst + i, g + i, n - i);
+}
+
+inline void setMul(float *dst, const float *src, const float *g, size_t n) {
+    size_t i = 0;
+    for (; i + simd::Width <= n; i += simd::Width) {
+        simd::store(dst + i, simd::mul(simd::load(src + i), simd::load(g + i)));
+    }
+    scalar::setMul(dst + i, src + i, g + i, n - i);
+}
+
+inline void lerp(float *dst, const float *a, const float *b, const float *c, size_t n) {
+    size_t i = 0;
+    for (; i + simd::Width <= n; i += simd::Width) {
+        simd::vec x = simd::load(a + i);
+        simd::vec y = simd::load(b + i);
+        simd::store(dst + i, simd::add(x, simd::mul(simd::sub(y, x), simd::load(c + i))));
+    }
+    scalar::lerp(dst + i, a + i, b + i, c + i, n - i);
+}
+
+inline void setMul2(float *dst, const float *a, const float *ga, const float *b, const float *gb, size_t n) {
+    size_t i = 0;
+    for (; i + simd::Width <= n; i += simd::Width) {
+        simd::vec x = simd::mul(simd::load(a + i), simd::load(ga + i));
+        simd::vec y = simd::mul(simd::load(b + i), simd::load(gb + i));
+        simd::store(dst + i, simd::add(x, y));
+    }
+    scalar::setMul2(dst + i, a + i, ga + i, b + i, gb + i, n - i);
+}
+
+#else
+
+using scalar::add;
+using scalar::addMul;
+using scalar::addScaled;
+using scalar::addScaled2;
+using scalar::clear;
+using scalar::copy;
+using scalar::lerp;
+using scalar::mul;
+using scalar::scale;
+using scalar::setMul;
+using scalar::setMul2;
+using scalar::setScaled;
+using scalar::setScaled2;
+
+#endif
+
+} // namespace kernels
+} // namespace crone
+
+#endif // CRONE_BUSKERNELS_H
@@ -14,7 +14,14 @@ using namespace crone;
 Commands Commands::mixerCommands;
 Commands Commands::softcutCommands;
 
-Commands::Commands() : q(COMMAND_Q_CAPACITY) {}
+// frame comparison that survives wraparound of the jack frame counter
+static inline bool frameBefore(uint32_t a, uint32_t b) {
+    return static_cast<int32_t>(a - b) < 0;
+}
+
+Commands::Commands() : q(COMMAND_Q_CAPACITY), numTimed(0) {
+    latest.fill(-1);
+}
 
 void Commands::post(Commands::Id id, float f) {
     CommandPacket p(id, -1, f);
@@ -44,15 +51,102 @@ void Commands::post(CommandPacket &p) {
 }
 
 void Commands::handlePending(MixerClient *client) {
-    CommandPacket p;
-    while (q.try_dequeue(p)) {
-        client->handleCommand(&p);
+    handle(client, false, 0);
+}
+
+void Commands::handlePending(SoftcutClient *client, uint32_t blockStart) {
+    handle(client, true, blockStart);
+}
+
+// commands that just set a value, where only the last in a batch matters.
+// others have side effects or are actions (stopping a voice, cutting to a position, syncing),
+// and are applied every time.
+int Commands::coalesceKey(const CommandPacket &p) {
+    if (p.timed || p.idx_0 < -1 || p.idx_0 >= COALESCE_SLOTS - 1) {
+        return -1;
+    }
+    switch (p.id) {
+    case SET_ENABLED_CUT:
+    case SET_CUT_POSITION:
+    case SET_CUT_VOICE_SYNC:
+        return -1;
+    default:
+        return p.id * COALESCE_SLOTS + p.idx_0 + 1;
+    }
+}
+
+template <class C> void Commands::flushTimed(C *client, const CommandPacket &p) {
+    int n = 0;
+    for (int i = 0; i < numTimed; ++i) {
+        CommandPacket &t = timed[i];
+        if (t.id == p.id && t.idx_0 == p.idx_0 && t.idx_1 == p.idx_1) {
+            client->handleCommand(&t);
+        } else {
+            timed[n++] = t;
+        }
     }
+    numTimed = n;
 }
 
-void Commands::handlePending(SoftcutClient *client) {
-    CommandPacket p;
-    while (q.try_dequeue(p)) {
-        client->handleCommand(&p);
+template <class C> void Commands::handle(C *client, bool useFrames, uint32_t blockStart) {
+    int n;
+    do {
+        n = 0;
+        while (n < COMMAND_Q_CAPACITY && q.try_dequeue(batch[n])) {
+            ++n;
+        }
+        // last writer wins
+        for (int i = 0; i < n; ++i) {
+            int k = coalesceKey(batch[i]);
+            if (k >= 0) {
+                latest[k] = static_cast<int16_t>(i);
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            CommandPacket &p = batch[i];
+            int k = coalesceKey(p);
+            if (k >= 0) {
+                if (latest[k] != i) {
+                    continue;
+                }
+                latest[k] = -1;
+            }
+            if (useFrames && p.timed && !frameBefore(p.frame, blockStart)) {
+                if (schedule(p)) {
+                    continue;
+                }
+                // no room to wait, so it's applied now; anything held back for the same target
+                // was posted earlier, and mustn't overwrite it later in the block
+                flushTimed(client, p);
+            }
+            client->handleCommand(&p);
+        }
+    } while (n == COMMAND_Q_CAPACITY);
+}
+
+bool Commands::schedule(const CommandPacket &p) {
+    if (numTimed == MAX_TIMED) {
+        return false;
+    }
+    // insert after any with the same frame, keeping the order they were posted in
+    int i = numTimed;
+    while (i > 0 && frameBefore(p.frame, timed[i - 1].frame)) {
+        timed[i] = timed[i - 1];
+        --i;
+    }
+    timed[i] = p;
+    ++numTimed;
+    return true;
+}
+
+bool Commands::nextTimed(uint32_t blockEnd, CommandPacket &p) {
+    if (numTimed == 0 || !frameBefore(timed[0].frame, blockEnd)) {
+        return false;
+    }
+    p = timed[0];
+    for (int i = 1; i < numTimed; ++i) {
+        timed[i - 1] = timed[i];
     }
+    --numTimed;
+    return true;
 }
@@ -5,6 +5,9 @@
 #ifndef CRONE_COMMANDS_H
 #define CRONE_COMMANDS_H
 
+#include <array>
+#include <cstdint>
+
 // #include "boost/lockfree/spsc_queue.hpp"
 #include "readerwriterqueue.h"
 
@@ -16,44 +19,24 @@ class SoftcutClient;
 class Commands {
   public:
     static constexpr int COMMAND_Q_CAPACITY = 256;
+    // timestamped commands waiting for a later block
+    static constexpr int MAX_TIMED = 64;
+    // index values (idx_0 from -1) that setters are coalesced over
+    static constexpr int COALESCE_SLOTS = 16;
     typedef enum {
-        //-- level commands
-        SET_LEVEL_ADC,
-        SET_LEVEL_DAC,
-        SET_LEVEL_EXT,
-        SET_LEVEL_EXT_AUX,
-        SET_LEVEL_CUT_MASTER,
-        SET_LEVEL_AUX_DAC,
-        SET_LEVEL_MONITOR,
-        SET_LEVEL_MONITOR_MIX,
-        SET_LEVEL_MONITOR_AUX,
-        SET_LEVEL_INS_MIX,
-
+        //-- mixer commands
+        // (levels are set through MixerClient's parameter block)
         SET_PARAM_REVERB,
         SET_PARAM_COMPRESSOR,
 
         SET_ENABLED_REVERB,
         SET_ENABLED_COMPRESSOR,
 
-        // level of stereo ext out -> stereo cut in
-        SET_LEVEL_EXT_CUT,
-        // level of stereo ADC out -> stereo cut in
-        SET_LEVEL_ADC_CUT,
-
         //-- softcut commands
+        // (levels, pans and their slew times are set through SoftcutClient's parameter block)
 
         // mix
         SET_ENABLED_CUT,
-        SET_LEVEL_CUT,
-        SET_PAN_CUT,
-        SET_LEVEL_CUT_AUX,
-        // level of individual input channel -> cut voice
-        // (separate commands just to avoid a 3rd parameter)
-        SET_LEVEL_IN_CUT,
-        SET_LEVEL_CUT_CUT,
-        SET_LEVEL_TAPE,
-        SET_LEVEL_TAPE_AUX,
-        SET_LEVEL_TAPE_CUT,
 
         // params
         SET_CUT_REC_FLAG,
@@ -87,8 +70,6 @@ class Commands {
         SET_CUT_POST_FILTER_BR,
         SET_CUT_POST_FILTER_DRY,
 
-        SET_CUT_LEVEL_SLEW_TIME,
-        SET_CUT_PAN_SLEW_TIME,
         SET_CUT_RECPRE_SLEW_TIME,
         SET_CUT_RATE_SLEW_TIME,
         SET_CUT_VOICE_SYNC,
@@ -111,6 +92,9 @@ class Commands {
         int idx_0;
         int idx_1;
         float value;
+        // if set, apply at this absolute jack frame rather than at the start of the next block
+        bool timed = false;
+        uint32_t frame = 0;
     };
 
     void post(CommandPacket &p);
@@ -119,9 +103,15 @@ class Commands {
     void post(Commands::Id id, int i, int j);
     void post(Commands::Id id, int i, int j, float f);
 
+    // apply queued commands at the start of a block.
+    // consecutive setters for the same id and index are coalesced, so only the last is applied.
     // FIXME: i guess things would be cleaner with a non-templated Client base/interface class
     void handlePending(MixerClient *client);
-    void handlePending(SoftcutClient *client);
+    // timestamped commands due after `blockStart` are held back, for nextTimed()
+    void handlePending(SoftcutClient *client, uint32_t blockStart);
+
+    // take the earliest held-back command due before `blockEnd`
+    bool nextTimed(uint32_t blockEnd, CommandPacket &p);
 
     static Commands mixerCommands;
     static Commands softcutCommands;
@@ -130,6 +120,21 @@ class Commands {
     //        boost::lockfree::spsc_queue <CommandPacket,
     //                boost::lockfree::capacity<COMMAND_Q_CAPACITY> > q;
     moodycamel::ReaderWriterQueue<CommandPacket> q;
+
+    //--- audio thread only
+    // packets drained from the queue in one pass
+    std::array<CommandPacket, COMMAND_Q_CAPACITY> batch;
+    // position in `batch` of the last packet for each coalescing key, or -1
+    std::array<int16_t, NUM_COMMANDS * COALESCE_SLOTS> latest;
+    // held-back timestamped commands, sorted by frame
+    std::array<CommandPacket, MAX_TIMED> timed;
+    int numTimed;
+
+    template <class C> void handle(C *client, bool useFrames, uint32_t blockStart);
+    static int coalesceKey(const CommandPacket &p);
+    bool schedule(const CommandPacket &p);
+    // apply and drop held-back commands with the same id and indices as `p`
+    template <class C> void flushTimed(C *client, const CommandPacket &p);
 };
 
 } // namespace crone
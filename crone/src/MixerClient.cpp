@@ -13,11 +13,48 @@
 
 using namespace crone;
 
-MixerClient::MixerClient() : Client<6, 6>("crone") {}
+MixerClient::MixerClient() : Client<6, 6>("crone"), paramSerial(0) {
+    paramRamps = {{
+            &smoothLevels.adc,
+            &smoothLevels.dac,
+            &smoothLevels.ext,
+            &smoothLevels.cut,
+            &smoothLevels.monitor,
+            &smoothLevels.tape,
+            &smoothLevels.adc_cut,
+            &smoothLevels.ext_cut,
+            &smoothLevels.tape_cut,
+            &smoothLevels.monitor_aux,
+            &smoothLevels.cut_aux,
+            &smoothLevels.ext_aux,
+            &smoothLevels.tape_aux,
+            &smoothLevels.aux,
+            &smoothLevels.ins_mix,
+    }};
+    for (size_t i = 0; i < paramRamps.size(); ++i) {
+        params.init(i, paramRamps[i]->getTarget());
+    }
+    for (int i = 0; i < 4; ++i) {
+        params.init(ParamMonitorMix + i, staticLevels.monitor_mix[i]);
+    }
+}
+
+void MixerClient::applyParams() {
+    if (!params.changed(paramSerial)) {
+        return;
+    }
+    for (size_t i = 0; i < paramRamps.size(); ++i) {
+        paramRamps[i]->setTarget(params.get(i));
+    }
+    for (int i = 0; i < 4; ++i) {
+        staticLevels.monitor_mix[i] = params.get(ParamMonitorMix + i);
+    }
+}
 
 void MixerClient::process(jack_nframes_t numFrames) {
 
     Commands::mixerCommands.handlePending(this);
+    applyParams();
 
 
     // copy inputs
@@ -119,43 +156,6 @@ void MixerClient::processFx(size_t numFrames) {
 
 void MixerClient::handleCommand(Commands::CommandPacket *p) {
     switch(p->id) {
-        case Commands::Id::SET_LEVEL_ADC:
-            smoothLevels.adc.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_DAC:
-            smoothLevels.dac.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_EXT:
-            smoothLevels.ext.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_EXT_AUX:
-            smoothLevels.ext_aux.setTarget(p->value);
-            break;
-	case Commands::Id::SET_LEVEL_CUT_MASTER:
-            smoothLevels.cut.setTarget(p->value);
-            break;	
-        case Commands::Id::SET_LEVEL_AUX_DAC:
-            smoothLevels.aux.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_MONITOR:
-            smoothLevels.monitor.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_MONITOR_AUX:
-            smoothLevels.monitor_aux.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_INS_MIX:
-            smoothLevels.ins_mix.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_MONITOR_MIX:
-            if(p->idx_0 < 0 || p->idx_0 > 3) { return; }
-            staticLevels.monitor_mix[p->idx_0] = p->value;
-            break;
-        case Commands::Id::SET_LEVEL_TAPE:
-            smoothLevels.tape.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_TAPE_AUX:
-            smoothLevels.tape_aux.setTarget(p->value);
-            break;
         case Commands::Id::SET_PARAM_REVERB:
             reverb.getUi().setParamValue(p->idx_0, p->value);
             break;
@@ -168,20 +168,6 @@ void MixerClient::handleCommand(Commands::CommandPacket *p) {
         case Commands::Id::SET_ENABLED_COMPRESSOR:
             enabled.comp = p->value > 0.f;
             break;
-
-            //-- softcut routing
-        case Commands::Id::SET_LEVEL_ADC_CUT:
-            smoothLevels.adc_cut.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_EXT_CUT:
-            smoothLevels.ext_cut.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_TAPE_CUT:
-            smoothLevels.tape_cut.setTarget(p->value);
-            break;
-        case Commands::Id::SET_LEVEL_CUT_AUX:
-            smoothLevels.cut_aux.setTarget(p->value);
-            break;
         default:
             ;;
     }
@@ -9,6 +9,7 @@
 
 #include "Bus.h"
 #include "Client.h"
+#include "ParamBlock.h"
 #include "PeakMeter.h"
 #include "Tape.h"
 #include "Utilities.h"
@@ -25,16 +26,52 @@ class MixerClient : public Client<6, 6> {
     typedef enum { SinkDac = 0, SinkCut = 1, SinkExt = 2 } SinkId;
     typedef Bus<2, MaxBufFrames> StereoBus;
 
+    // levels held in the parameter block, rather than set through the commands queue
+    typedef enum {
+        ParamLevelAdc,
+        ParamLevelDac,
+        ParamLevelExt,
+        ParamLevelCut,
+        ParamLevelMonitor,
+        ParamLevelTape,
+        ParamLevelAdcCut,
+        ParamLevelExtCut,
+        ParamLevelTapeCut,
+        ParamLevelMonitorAux,
+        ParamLevelCutAux,
+        ParamLevelExtAux,
+        ParamLevelTapeAux,
+        ParamLevelAux,
+        ParamLevelInsMix,
+        // 2x2 matrix for monitor mix
+        ParamMonitorMix,
+        NumParams = ParamMonitorMix + 4
+    } ParamId;
+
   public:
     MixerClient();
-    /// FIXME: the "commands" structure shouldn't really be necessary.
-    /// should be able to refactor most/all parameters for atomic access.
     // called from audio thread
     void handleCommand(Commands::CommandPacket *p) override;
 
+    // these can be called from any thread
+    void setLevel(ParamId id, float value) {
+        if (id < ParamMonitorMix) {
+            params.set(id, value);
+        }
+    }
+
+    void setMonitorMix(int idx, float value) {
+        if (idx < 0 || idx > 3) {
+            return;
+        }
+        params.set(ParamMonitorMix + idx, value);
+    }
+
   private:
     void process(jack_nframes_t numFrames) override;
     void setSampleRate(jack_nframes_t) override;
+    // pick up parameter changes; called once per block
+    void applyParams();
 
   private:
     void processFx(size_t numFrames);
@@ -105,6 +142,12 @@ class MixerClient : public Client<6, 6> {
     };
     StaticLevelList staticLevels;
 
+    ParamBlock<NumParams> params;
+    // parameter block serial number last applied
+    uint32_t paramSerial;
+    // ramp for each level parameter, in ParamId order
+    std::array<LogRamp *, ParamMonitorMix> paramRamps;
+
     // other state
     struct EnabledList {
         bool reverb;
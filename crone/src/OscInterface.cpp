@@ -4,6 +4,7 @@
 // Created by ezra on 11/4/18.
 //
 
+#include <mutex>
 #include <utility>
 #include <thread>
 
@@ -13,6 +14,7 @@
 #include "BufDiskWorker.h"
 #include "Commands.h"
 #include "OscInterface.h"
+#include "ShmTransport.h"
 
 using namespace crone;
 
@@ -21,6 +23,7 @@ bool OscInterface::quitFlag;
 std::string OscInterface::port;
 lo_server_thread OscInterface::st;
 lo_address OscInterface::matronAddress;
+std::recursive_mutex OscInterface::dispatchLock;
 
 std::array<OscInterface::OscMethod, OscInterface::MaxNumMethods> OscInterface::methods;
 unsigned int OscInterface::numMethods = 0;
@@ -49,7 +52,7 @@ void OscInterface::init(MixerClient *m, SoftcutClient *sc) {
     // FIXME: polls should really live somewhere else (client classes?)
     //--- VU poll
     vuPoll = std::make_unique<Poll>("vu");
-    vuPoll->setCallback([](const char *path) {
+    vuPoll->setCallback([](const char *path, lo_bundle bundle) {
         char l[4];
 
         l[0] = (uint8_t) (64 * mixerClient->getInputPeakPos(0));
@@ -58,20 +61,28 @@ void OscInterface::init(MixerClient *m, SoftcutClient *sc) {
         l[3] = (uint8_t) (64 * mixerClient->getOutputPeakPos(1));
 
         lo_blob bl = lo_blob_new(sizeof(l), l);
-        lo_send(matronAddress, path, "b", bl);
+        lo_message msg = lo_message_new();
+        lo_message_add_blob(msg, bl);
+        lo_bundle_add_message(bundle, path, msg);
+        lo_blob_free(bl);
     });
     vuPoll->setPeriod(50);
 
     //--- softcut phase poll
     phasePoll = std::make_unique<Poll>("softcut/phase");
-    phasePoll->setCallback([](const char *path) {
-        for (int i = 0; i < softCutClient->getNumVoices(); ++i) {
-            if (softCutClient->checkVoiceQuantPhase(i)) {
-                lo_send(matronAddress, path, "if", i, softCutClient->getQuantPhase(i));
-            }
+    // the audio thread queues phase changes as they happen; this just forwards them, in order.
+    // nothing is lost between ticks, so a slower tick only adds latency; at 10ms, even 16-frame blocks
+    // can't queue more than PhaseEventCapacity changes for all voices.
+    phasePoll->setCallback([](const char *path, lo_bundle bundle) {
+        SoftcutClient::PhaseEvent e;
+        while (softCutClient->nextPhaseEvent(e)) {
+            lo_message msg = lo_message_new();
+            lo_message_add_int32(msg, e.voice);
+            lo_message_add_float(msg, e.phase);
+            lo_bundle_add_message(bundle, path, msg);
         }
     });
-    phasePoll->setPeriod(1);
+    phasePoll->setPeriod(10);
 
 
     //--- TODO: softcut trigger poll?
@@ -79,6 +90,19 @@ void OscInterface::init(MixerClient *m, SoftcutClient *sc) {
     //--- TODO: tape poll?
 
     lo_server_thread_start(st);
+
+    // all polls due on a tick go to matron in one bundle
+    PollScheduler::init([](lo_bundle bundle) {
+        if (!ShmTransport::send(bundle)) {
+            lo_send_bundle(matronAddress, bundle);
+        }
+    });
+
+    // packets from matron's shared-memory link are dispatched as if they'd arrived by UDP
+    ShmTransport::init(port, [](void *data, size_t size) {
+        std::lock_guard<std::recursive_mutex> lock(dispatchLock);
+        lo_server_dispatch_data(lo_server_thread_get_server(st), data, size);
+    });
 }
 
 
@@ -97,6 +121,9 @@ void OscInterface::addServerMethod(const char *path, const char *format, Handler
                                     (void) types;
                                     (void) msg;
                                     auto pm = static_cast<OscMethod *>(data);
+                                    // handlers post to single-producer queues; the UDP and
+                                    // shared-memory threads take turns
+                                    std::lock_guard<std::recursive_mutex> lock(dispatchLock);
                                     //std::cerr << "osc rx: " << path << std::endl;
                                     pm->handler(argv, argc);
                                     return 0;
@@ -143,61 +170,60 @@ void OscInterface::addServerMethods() {
 
 
     ////////////////////////////////
-    /// FIXME: many of these methods are trivial setters;
-    // they could simply be structured around atomic fields instead of requiring the Command queue.
-    // would require some refactoring e.g. to expose level ramp targets as atomics
+    // levels, pans and slew times are set straight into the clients' parameter blocks;
+    // everything else goes through the Commands queues.
 
     //--------------------------
     //--- levels
     addServerMethod("/set/level/adc", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_ADC, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelAdc, argv[0]->f);
     });
 
     addServerMethod("/set/level/dac", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_DAC, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelDac, argv[0]->f);
     });
 
     addServerMethod("/set/level/ext", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_EXT, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelExt, argv[0]->f);
     });
 
     addServerMethod("/set/level/cut_master", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_CUT_MASTER, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelCut, argv[0]->f);
     });
 
 
     addServerMethod("/set/level/ext_rev", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_EXT_AUX, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelExtAux, argv[0]->f);
     });
 
     addServerMethod("/set/level/rev_dac", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_AUX_DAC, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelAux, argv[0]->f);
     });
 
     addServerMethod("/set/level/monitor", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_MONITOR, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelMonitor, argv[0]->f);
     });
 
     addServerMethod("/set/level/monitor_mix", "if", [](lo_arg **argv, int argc) {
         if (argc < 2) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_MONITOR_MIX, argv[0]->i, argv[1]->f);
+        mixerClient->setMonitorMix(argv[0]->i, argv[1]->f);
     });
 
     addServerMethod("/set/level/monitor_rev", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_MONITOR_AUX, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelMonitorAux, argv[0]->f);
     });
 
     addServerMethod("/set/level/compressor_mix", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_INS_MIX, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelInsMix, argv[0]->f);
     });
 
 
@@ -285,50 +311,50 @@ void OscInterface::addServerMethods() {
 
     addServerMethod("/set/level/cut", "if", [](lo_arg **argv, int argc) {
         if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_LEVEL_CUT, argv[0]->i, argv[1]->f);
+        softCutClient->setLevel(argv[0]->i, argv[1]->f);
     });
 
     addServerMethod("/set/pan/cut", "if", [](lo_arg **argv, int argc) {
         if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_PAN_CUT, argv[0]->i, argv[1]->f);
+        softCutClient->setPan(argv[0]->i, argv[1]->f);
     });
 
 
     addServerMethod("/set/level/adc_cut", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_ADC_CUT, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelAdcCut, argv[0]->f);
     });
 
     addServerMethod("/set/level/ext_cut", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_EXT_CUT, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelExtCut, argv[0]->f);
     });
 
     addServerMethod("/set/level/tape_cut", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_TAPE_CUT, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelTapeCut, argv[0]->f);
     });
 
     addServerMethod("/set/level/cut_rev", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_CUT_AUX, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelCutAux, argv[0]->f);
     });
 
 
-    //--- NB: these are handled by the softcut command queue,
+    //--- NB: these are set on the softcut client,
     // because their corresponding mix points are processed by the softcut client.
 
     // input channel -> voice levels
     addServerMethod("/set/level/in_cut", "iif", [](lo_arg **argv, int argc) {
         if (argc < 3) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_LEVEL_IN_CUT, argv[0]->i, argv[1]->i, argv[2]->f);
+        softCutClient->setInLevel(argv[0]->i, argv[1]->i, argv[2]->f);
     });
 
 
     // voice ->  voice levels
     addServerMethod("/set/level/cut_cut", "iif", [](lo_arg **argv, int argc) {
         if (argc < 3) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_LEVEL_CUT_CUT, argv[0]->i, argv[1]->i, argv[2]->f);
+        softCutClient->setFbLevel(argv[0]->i, argv[1]->i, argv[2]->f);
     });
 
 
@@ -338,7 +364,7 @@ void OscInterface::addServerMethods() {
 
     addServerMethod("/set/param/cut/rate", "if", [](lo_arg **argv, int argc) {
         if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_RATE, argv[0]->i, argv[1]->f);
+        softCutClient->postTimed({Commands::Id::SET_CUT_RATE, argv[0]->i, argv[1]->f});
     });
 
     addServerMethod("/set/param/cut/loop_start", "if", [](lo_arg **argv, int argc) {
@@ -388,7 +414,7 @@ void OscInterface::addServerMethods() {
 
     addServerMethod("/set/param/cut/position", "if", [](lo_arg **argv, int argc) {
         if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_POSITION, argv[0]->i, argv[1]->f);
+        softCutClient->postTimed({Commands::Id::SET_CUT_POSITION, argv[0]->i, argv[1]->f});
     });
 
     // --- input filter
@@ -472,7 +498,7 @@ void OscInterface::addServerMethods() {
 
     addServerMethod("/set/param/cut/voice_sync", "iif", [](lo_arg **argv, int argc) {
         if (argc < 3) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_VOICE_SYNC, argv[0]->i, argv[1]->i, argv[2]->f);
+        softCutClient->postTimed({Commands::Id::SET_CUT_VOICE_SYNC, argv[0]->i, argv[1]->i, argv[2]->f});
     });
 
 
@@ -522,12 +548,12 @@ void OscInterface::addServerMethods() {
 
     addServerMethod("/set/param/cut/level_slew_time", "if", [](lo_arg **argv, int argc) {
         if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_LEVEL_SLEW_TIME, argv[0]->i, argv[1]->f);
+        softCutClient->setLevelSlewTime(argv[0]->i, argv[1]->f);
     });
 
     addServerMethod("/set/param/cut/pan_slew_time", "if", [](lo_arg **argv, int argc) {
         if (argc < 2) { return; }
-        Commands::softcutCommands.post(Commands::Id::SET_CUT_PAN_SLEW_TIME, argv[0]->i, argv[1]->f);
+        softCutClient->setPanSlewTime(argv[0]->i, argv[1]->f);
     });
 
     addServerMethod("/set/param/cut/recpre_slew_time", "if", [](lo_arg **argv, int argc) {
@@ -794,7 +820,8 @@ void OscInterface::addServerMethods() {
         softCutClient->renderSamples(ch, argv[1]->f, argv[2]->f, sampleCt,
                                      [=](float secPerSample, float start, size_t count, float* samples) {
                                          lo_blob bl = lo_blob_new(count * sizeof(float), samples);
-                                         lo_send(matronAddress, "/softcut/buffer/render_callback", "iffb", ch, secPerSample, start, bl);
+                                         sendToMatron("/softcut/buffer/render_callback", "iffb", ch, secPerSample, start, bl);
+                                         lo_blob_free(bl);
                                      });
     });
 
@@ -802,7 +829,13 @@ void OscInterface::addServerMethods() {
       if(argc < 1) return;
       int idx = argv[0]->i;
       float pos = softCutClient->getPosition(idx);
-      lo_send(matronAddress, "/poll/softcut/position", "if", idx, pos);
+      sendToMatron("/poll/softcut/position", "if", idx, pos);
+    });
+
+    // apply rate, position and sync changes at the sample they arrived, one period later
+    addServerMethod("/softcut/timestamp_commands", "i", [](lo_arg **argv, int argc) {
+        if (argc < 1) { return; }
+        softCutClient->setTimestampCommands(argv[0]->i > 0);
     });
 
     addServerMethod("/softcut/reset", "", [](lo_arg **argv, int argc) {
@@ -813,9 +846,8 @@ void OscInterface::addServerMethods() {
         softCutClient->clearBuffer(1, 0, -1);
 
         softCutClient->reset();
-        for (int i = 0; i < SoftcutClient::NumVoices; ++i) {
-            phasePoll->stop();
-        }
+        phasePoll->stop();
+        softCutClient->stopPhaseReports();
     });
 
     //---------------------
@@ -834,6 +866,9 @@ void OscInterface::addServerMethods() {
     addServerMethod("/poll/start/cut/phase", "", [](lo_arg **argv, int argc) {
         (void) argv;
         (void) argc;
+        // restarting: the poll mustn't be reading the queue while it's cleared
+        phasePoll->stop();
+        softCutClient->startPhaseReports();
         phasePoll->start();
     });
 
@@ -841,6 +876,7 @@ void OscInterface::addServerMethods() {
         (void) argv;
         (void) argc;
         phasePoll->stop();
+        softCutClient->stopPhaseReports();
     });
 
 
@@ -883,12 +919,12 @@ void OscInterface::addServerMethods() {
 
     addServerMethod("/set/level/tape", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_TAPE, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelTape, argv[0]->f);
     });
 
     addServerMethod("/set/level/tape_rev", "f", [](lo_arg **argv, int argc) {
         if (argc < 1) { return; }
-        Commands::mixerCommands.post(Commands::Id::SET_LEVEL_TAPE_AUX, argv[0]->f);
+        mixerClient->setLevel(MixerClient::ParamLevelTapeAux, argv[0]->f);
     });
 }
 
@@ -899,6 +935,16 @@ void OscInterface::printServerMethods() {
     }
 }
 
+void OscInterface::sendMessageToMatron(const char *path, lo_message msg) {
+    if (!ShmTransport::send(path, msg)) {
+        lo_send_message(matronAddress, path, msg);
+    }
+}
+
 void OscInterface::deinit() {
+    PollScheduler::deinit();
+    vuPoll.reset();
+    phasePoll.reset();
+    ShmTransport::deinit();
     lo_address_free(matronAddress);
 }
@@ -12,6 +12,7 @@
 #include <vector>
 
 #include <array>
+#include <mutex>
 #include <lo/lo.h>
 
 #include "MixerClient.h"
@@ -29,6 +30,9 @@ class OscInterface {
   private:
     static lo_server_thread st;
     static lo_address matronAddress;
+    // held while a method handler runs; recursive, since the shared-memory thread
+    // takes it around lo_server_dispatch_data and again in the handler
+    static std::recursive_mutex dispatchLock;
 
     static bool quitFlag;
     static string port;
@@ -63,6 +67,15 @@ class OscInterface {
 
     static void addServerMethods();
 
+    // send with lo_send-style arguments, over the shared-memory link if matron is connected
+    template <typename... Args> static void sendToMatron(const char *path, const char *types, Args... args) {
+        lo_message msg = lo_message_new();
+        lo_message_add(msg, types, args...);
+        sendMessageToMatron(path, msg);
+        lo_message_free(msg);
+    }
+    static void sendMessageToMatron(const char *path, lo_message msg);
+
   public:
     static void init(MixerClient *m, SoftcutClient *sc);
     static void deinit();
@@ -0,0 +1,66 @@
+//
+// lock-free block of float parameters, for levels, pans and ramp times.
+//
+// setters on other threads store straight into the block; the audio thread checks it once
+// per process() call and applies whatever changed. unlike the Commands queue this can't fill
+// up, and a burst of writes to one parameter costs the audio thread nothing extra: it only
+// ever sees the latest value. anything that must happen in order, or that does more than
+// store a value, still goes through Commands.
+//
+
+#ifndef CRONE_PARAMBLOCK_H
+#define CRONE_PARAMBLOCK_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace crone {
+
+template <size_t N> class ParamBlock {
+  public:
+    ParamBlock() : serial(0) {
+        for (auto &v : values) {
+            v.store(0.f, std::memory_order_relaxed);
+        }
+    }
+
+    // set from any thread
+    void set(size_t i, float x) {
+        if (i >= N) {
+            return;
+        }
+        values[i].store(x, std::memory_order_relaxed);
+        serial.fetch_add(1, std::memory_order_release);
+    }
+
+    // set without flagging a change; use before the audio thread starts
+    void init(size_t i, float x) {
+        values[i].store(x, std::memory_order_relaxed);
+    }
+
+    // audio thread: true if anything was set since the last call that returned true.
+    // `seen` is the reader's own copy of the serial number.
+    bool changed(uint32_t &seen) const {
+        uint32_t s = serial.load(std::memory_order_acquire);
+        if (s == seen) {
+            return false;
+        }
+        seen = s;
+        return true;
+    }
+
+    float get(size_t i) const {
+        return values[i].load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::array<std::atomic<float>, N> values;
+    // bumped after every store, so the reader can skip the whole block when nothing changed
+    std::atomic<uint32_t> serial;
+};
+
+} // namespace crone
+
+#endif // CRONE_PARAMBLOCK_H
@@ -0,0 +1,108 @@
+//
+// poll scheduling
+//
+
+#include <algorithm>
+
+#include "Poll.h"
+
+using namespace crone;
+
+PollScheduler::Sender PollScheduler::sender;
+std::thread PollScheduler::thread;
+std::mutex PollScheduler::lock;
+std::condition_variable PollScheduler::wake;
+std::vector<Poll *> PollScheduler::polls;
+bool PollScheduler::running = false;
+
+void Poll::start() {
+    PollScheduler::add(this);
+}
+
+void Poll::stop() {
+    PollScheduler::remove(this);
+}
+
+void Poll::setPeriod(int ms) {
+    std::lock_guard<std::mutex> l(PollScheduler::lock);
+    period = std::chrono::milliseconds(std::max(1, ms));
+}
+
+void PollScheduler::init(Sender s) {
+    std::lock_guard<std::mutex> l(lock);
+    sender = std::move(s);
+    running = true;
+    thread = std::thread(loop);
+}
+
+void PollScheduler::deinit() {
+    {
+        std::lock_guard<std::mutex> l(lock);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void PollScheduler::add(Poll *p) {
+    {
+        std::lock_guard<std::mutex> l(lock);
+        if (std::find(polls.begin(), polls.end(), p) != polls.end()) {
+            return;
+        }
+        // first report straight away
+        p->deadline = Clock::now();
+        polls.push_back(p);
+    }
+    wake.notify_one();
+}
+
+void PollScheduler::remove(Poll *p) {
+    // once this returns the poll's callback isn't running, and won't be called again
+    std::lock_guard<std::mutex> l(lock);
+    polls.erase(std::remove(polls.begin(), polls.end(), p), polls.end());
+}
+
+void PollScheduler::loop() {
+    std::unique_lock<std::mutex> l(lock);
+    while (running) {
+        if (polls.empty()) {
+            wake.wait(l);
+            continue;
+        }
+        auto next = polls[0]->deadline;
+        for (auto p : polls) {
+            next = std::min(next, p->deadline);
+        }
+        auto now = Clock::now();
+        if (now < next) {
+            // woken early by a new poll, or to stop; either way, look again
+            wake.wait_until(l, next);
+            continue;
+        }
+
+        lo_timetag immediate = {0, 1};
+        lo_bundle bundle = lo_bundle_new(immediate);
+        for (auto p : polls) {
+            if (p->deadline > now) {
+                continue;
+            }
+            p->cb(p->path.c_str(), bundle);
+            // absolute deadlines, so callback and send time don't accumulate as drift.
+            // after a stall, skip the missed ticks rather than sending a burst.
+            p->deadline += p->period;
+            if (p->deadline <= now) {
+                p->deadline = now + p->period;
+            }
+        }
+        l.unlock();
+        if (lo_bundle_count(bundle) > 0) {
+            sender(bundle);
+        }
+        lo_bundle_free_recursive(bundle);
+        l.lock();
+    }
+}
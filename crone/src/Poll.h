@@ -5,61 +5,74 @@
 #ifndef CRONE_POLL_H
 #define CRONE_POLL_H
 
-#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
 #include <string>
 #include <thread>
-
-#include <chrono>
-#include <sstream>
-#include <utility>
+#include <vector>
 
 #include <lo/lo.h>
 
+namespace crone {
+
+// a value reported to matron periodically while started.
+// polls don't have threads of their own; PollScheduler runs all of them.
 class Poll {
+    friend class PollScheduler;
 
   public:
-    typedef std::function<void(const char *)> Callback;
+    // add zero or more messages to `bundle`; everything due on the same tick goes out together
+    typedef std::function<void(const char *path, lo_bundle bundle)> Callback;
 
-    explicit Poll(std::string name) {
-        std::ostringstream os;
-        os << "/poll/" << name;
-        path = os.str();
+    explicit Poll(std::string name) : path("/poll/" + name), period(std::chrono::milliseconds(100)) {}
+    ~Poll() {
+        stop();
     }
 
+    // set before starting
     void setCallback(Callback c) {
         cb = std::move(c);
     }
 
-    void start() {
-        shouldStop = false;
-        th = std::make_unique<std::thread>(std::thread([this] {
-            while (!shouldStop) {
-                this->cb(path.c_str());
-                std::this_thread::sleep_for(std::chrono::milliseconds(period));
-            }
-        }));
-        th->detach();
-    }
-
-    void stop() {
-        // in c++ there's no way to safely and non-cooperatively interrupt a thread.
-        shouldStop = true;
-        // i am reasonably sure this won't leak...
-        th.reset();
-    }
-
-    void setPeriod(int ms) {
-        period = ms;
-    }
+    void start();
+    void stop();
+    void setPeriod(int ms);
 
   private:
     Callback cb;
-    std::atomic<int> period;
-    std::atomic<bool> shouldStop;
-    std::unique_ptr<std::thread> th;
     std::string path;
-    lo_address addr;
+    std::chrono::steady_clock::duration period;
+    std::chrono::steady_clock::time_point deadline;
 };
 
+// one thread servicing every started poll, sleeping until the earliest deadline
+class PollScheduler {
+  public:
+    typedef std::function<void(lo_bundle bundle)> Sender;
+
+    static void init(Sender s);
+    // stops the thread; polls may still be started, but won't run again
+    static void deinit();
+
+  private:
+    friend class Poll;
+    typedef std::chrono::steady_clock Clock;
+
+    static void add(Poll *p);
+    static void remove(Poll *p);
+    static void loop();
+
+    static Sender sender;
+    static std::thread thread;
+    // guards everything below, and the timing fields of started polls
+    static std::mutex lock;
+    static std::condition_variable wake;
+    static std::vector<Poll *> polls;
+    static bool running;
+};
+
+} // namespace crone
+
 #endif // CRONE_POLL_H
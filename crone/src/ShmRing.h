@@ -0,0 +1,126 @@
+//
+// single-producer, single-consumer byte ring for passing OSC packets through shared memory.
+//
+// this is the crone side of matron/src/shm_ring.c, and must keep the same layout and protocol:
+// head and tail are free-running byte counts; each record is a 32-bit length followed by the
+// packet, padded to 8 bytes; a length of Wrap means the rest of the ring is unused.
+// the indices are shared with another process, so only the gcc atomic builtins touch them.
+//
+
+#ifndef CRONE_SHMRING_H
+#define CRONE_SHMRING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace crone {
+
+struct ShmRing {
+    static constexpr uint32_t Magic = 0x676e726e;
+    static constexpr uint32_t Version = 1;
+    static constexpr uint32_t Size = 1 << 16;
+    static constexpr uint32_t Mask = Size - 1;
+    static constexpr size_t RecordMax = Size / 4;
+    static constexpr uint32_t Wrap = 0xffffffffu;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t reserved;
+    // written by the producer only
+    alignas(64) uint32_t head;
+    // written by the consumer only
+    alignas(64) uint32_t tail;
+    alignas(64) uint8_t data[Size];
+
+    void init() {
+        size = Size;
+        version = Version;
+        reserved = 0;
+        head = 0;
+        tail = 0;
+        __atomic_store_n(&magic, Magic, __ATOMIC_RELEASE);
+    }
+
+    bool valid() const {
+        return __atomic_load_n(&magic, __ATOMIC_ACQUIRE) == Magic && version == Version && size == Size;
+    }
+
+    //--- producer
+
+    // space for a packet of `len` bytes, or nullptr if the ring is too full
+    void *reserve(size_t len) {
+        if (len > RecordMax) {
+            return nullptr;
+        }
+        uint32_t h = head;
+        uint32_t t = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+        uint32_t rec = recordSize(len);
+        uint32_t skip = wrapSkip(h, rec);
+        if (skip + rec > Size - (h - t)) {
+            return nullptr;
+        }
+        if (skip > 0) {
+            uint32_t w = Wrap;
+            std::memcpy(&data[h & Mask], &w, sizeof(w));
+            h += skip;
+        }
+        uint8_t *rp = &data[h & Mask];
+        auto n = static_cast<uint32_t>(len);
+        std::memcpy(rp, &n, sizeof(n));
+        return rp + sizeof(n);
+    }
+
+    // publish the reserved packet; returns true if the consumer may be asleep and needs a wakeup
+    bool commit(size_t len) {
+        uint32_t h = head;
+        uint32_t rec = recordSize(len);
+        __atomic_store_n(&head, h + wrapSkip(h, rec) + rec, __ATOMIC_SEQ_CST);
+        return __atomic_load_n(&tail, __ATOMIC_SEQ_CST) == h;
+    }
+
+    //--- consumer
+
+    // next packet, or nullptr if the ring is empty
+    const void *peek(size_t &len) {
+        uint32_t t = tail;
+        uint32_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+        while (t != h) {
+            const uint8_t *rp = &data[t & Mask];
+            uint32_t n;
+            std::memcpy(&n, rp, sizeof(n));
+            if (n != Wrap) {
+                len = n;
+                return rp + sizeof(n);
+            }
+            t += Size - (t & Mask);
+            __atomic_store_n(&tail, t, __ATOMIC_RELEASE);
+        }
+        return nullptr;
+    }
+
+    // done with the peeked packet; returns true if the ring is now empty and it's safe to wait
+    bool release(size_t len) {
+        uint32_t t = tail + recordSize(len);
+        __atomic_store_n(&tail, t, __ATOMIC_SEQ_CST);
+        return __atomic_load_n(&head, __ATOMIC_SEQ_CST) == t;
+    }
+
+  private:
+    static uint32_t recordSize(size_t len) {
+        return static_cast<uint32_t>((sizeof(uint32_t) + len + 7) & ~static_cast<size_t>(7));
+    }
+
+    static uint32_t wrapSkip(uint32_t h, uint32_t rec) {
+        uint32_t room = Size - (h & Mask);
+        return room < rec ? room : 0;
+    }
+};
+
+static_assert(offsetof(ShmRing, head) == 64 && offsetof(ShmRing, tail) == 128 && offsetof(ShmRing, data) == 192,
+              "ShmRing layout must match matron's struct shm_ring");
+
+} // namespace crone
+
+#endif // CRONE_SHMRING_H
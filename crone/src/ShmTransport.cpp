@@ -0,0 +1,280 @@
+//
+// shared-memory link to matron
+//
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ShmTransport.h"
+
+using namespace crone;
+
+ShmTransport::PacketHandler ShmTransport::handler;
+std::thread ShmTransport::thread;
+int ShmTransport::listenFd = -1;
+int ShmTransport::stopFd = -1;
+
+std::mutex ShmTransport::sendLock;
+ShmTransport::Link *ShmTransport::link = nullptr;
+int ShmTransport::wakeCroneFd = -1;
+int ShmTransport::wakeMatronFd = -1;
+std::atomic<bool> ShmTransport::connected(false);
+std::atomic<unsigned int> ShmTransport::dropped(0);
+
+void ShmTransport::init(const std::string &port, PacketHandler h) {
+    handler = std::move(h);
+
+    // abstract namespace: leading nul, no file to clean up
+    std::string name = "crone/" + port;
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path + 1, name.c_str(), name.size());
+    auto addrLen = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + 1 + name.size());
+
+    listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 || bind(listenFd, reinterpret_cast<struct sockaddr *>(&addr), addrLen) < 0 ||
+        listen(listenFd, 1) < 0) {
+        std::cerr << "shm transport: can't listen (" << std::strerror(errno) << "), using UDP only" << std::endl;
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            listenFd = -1;
+        }
+        return;
+    }
+    stopFd = eventfd(0, EFD_CLOEXEC);
+    thread = std::thread(loop);
+}
+
+void ShmTransport::deinit() {
+    if (!thread.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(stopFd, &one, sizeof(one)) < 0) {
+        std::cerr << "shm transport: failed to signal thread" << std::endl;
+    }
+    thread.join();
+    ::close(stopFd);
+    ::close(listenFd);
+    stopFd = -1;
+    listenFd = -1;
+}
+
+bool ShmTransport::send(const char *path, lo_message msg) {
+    return writePacket(lo_message_length(msg, path), [&](void *dst) {
+        size_t size;
+        lo_message_serialise(msg, path, dst, &size);
+    });
+}
+
+bool ShmTransport::send(lo_bundle bundle) {
+    return writePacket(lo_bundle_length(bundle), [&](void *dst) {
+        size_t size;
+        lo_bundle_serialise(bundle, dst, &size);
+    });
+}
+
+bool ShmTransport::writePacket(size_t len, const std::function<void(void *)> &serialise) {
+    if (!connected.load()) {
+        return false;
+    }
+    if (len > ShmRing::RecordMax) {
+        // sending it over UDP instead would let it overtake whatever is still in the ring
+        std::cerr << "shm transport: dropped oversized packet (" << len << " bytes)" << std::endl;
+        return true;
+    }
+    // matron drains the ring on a thread of its own, so when it's full there should be room shortly
+    for (int tries = 0; tries < FullTries; ++tries) {
+        {
+            std::lock_guard<std::mutex> lock(sendLock);
+            if (link == nullptr) {
+                return false;
+            }
+            void *dst = link->toMatron.reserve(len);
+            if (dst != nullptr) {
+                serialise(dst);
+                if (link->toMatron.commit(len)) {
+                    uint64_t one = 1;
+                    if (write(wakeMatronFd, &one, sizeof(one)) < 0) {
+                        std::cerr << "shm transport: failed to wake matron" << std::endl;
+                    }
+                }
+                return true;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(FullWaitUs));
+    }
+    unsigned int n = ++dropped;
+    std::cerr << "shm transport: ring full, dropped packet (" << n << " dropped so far)" << std::endl;
+    return true;
+}
+
+void ShmTransport::loop() {
+    struct pollfd fds[2] = {
+            {listenFd, POLLIN, 0},
+            {stopFd, POLLIN, 0},
+    };
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        // one matron at a time; another connecting meanwhile waits in the backlog
+        int conn = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn < 0) {
+            continue;
+        }
+        bool running = true;
+        if (openLink(conn)) {
+            running = serve(conn);
+            closeLink();
+        }
+        ::close(conn);
+        if (!running) {
+            break;
+        }
+    }
+}
+
+// create the rings and wakeups, and hand them to matron
+bool ShmTransport::openLink(int conn) {
+    int memFd = memfd_create("crone-shm", MFD_CLOEXEC);
+    if (memFd < 0 || ftruncate(memFd, sizeof(Link)) < 0) {
+        std::cerr << "shm transport: can't create shared memory: " << std::strerror(errno) << std::endl;
+        if (memFd >= 0) {
+            ::close(memFd);
+        }
+        return false;
+    }
+    void *mem = mmap(nullptr, sizeof(Link), PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    if (mem == MAP_FAILED) {
+        std::cerr << "shm transport: mmap failed: " << std::strerror(errno) << std::endl;
+        ::close(memFd);
+        return false;
+    }
+    auto *l = static_cast<Link *>(mem);
+    l->toCrone.init();
+    l->toMatron.init();
+
+    int fds[3] = {memFd, eventfd(0, EFD_CLOEXEC), eventfd(0, EFD_CLOEXEC)};
+    bool ok = fds[1] >= 0 && fds[2] >= 0;
+
+    if (ok) {
+        uint32_t version = ShmRing::Version;
+        struct iovec iov {};
+        iov.iov_base = &version;
+        iov.iov_len = sizeof(version);
+        union {
+            char buf[CMSG_SPACE(sizeof(fds))];
+            struct cmsghdr align;
+        } control {};
+        struct msghdr msg {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+        ok = sendmsg(conn, &msg, MSG_NOSIGNAL) == sizeof(version);
+    }
+    // matron has its own copies now, and the mapping keeps the memory alive
+    ::close(memFd);
+    if (!ok) {
+        std::cerr << "shm transport: handshake with matron failed" << std::endl;
+        for (int i = 1; i < 3; ++i) {
+            if (fds[i] >= 0) {
+                ::close(fds[i]);
+            }
+        }
+        munmap(mem, sizeof(Link));
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(sendLock);
+    link = l;
+    wakeCroneFd = fds[1];
+    wakeMatronFd = fds[2];
+    connected = true;
+    std::cout << "shm transport: matron connected" << std::endl;
+    return true;
+}
+
+void ShmTransport::closeLink() {
+    Link *l;
+    {
+        std::lock_guard<std::mutex> lock(sendLock);
+        connected = false;
+        l = link;
+        link = nullptr;
+        ::close(wakeCroneFd);
+        ::close(wakeMatronFd);
+        wakeCroneFd = -1;
+        wakeMatronFd = -1;
+    }
+    munmap(l, sizeof(Link));
+    std::cout << "shm transport: matron disconnected" << std::endl;
+}
+
+void ShmTransport::drain() {
+    ShmRing &ring = link->toCrone;
+    size_t len;
+    const void *data;
+    while ((data = ring.peek(len)) != nullptr) {
+        handler(const_cast<void *>(data), len);
+        if (ring.release(len)) {
+            break;
+        }
+    }
+}
+
+// returns false when asked to stop
+bool ShmTransport::serve(int conn) {
+    struct pollfd fds[3] = {
+            {wakeCroneFd, POLLIN, 0},
+            {conn, POLLIN, 0},
+            {stopFd, POLLIN, 0},
+    };
+    while (true) {
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return true;
+        }
+        if (fds[2].revents) {
+            return false;
+        }
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            if (read(wakeCroneFd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                return true;
+            }
+            drain();
+        }
+        if (fds[1].revents) {
+            // matron never sends on the socket after connecting; anything here is a hangup
+            return true;
+        }
+    }
+}
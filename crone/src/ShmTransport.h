@@ -0,0 +1,79 @@
+//
+// shared-memory link to matron.
+//
+// crone listens on an abstract unix socket named after its OSC port. when matron connects it
+// gets a memfd holding a pair of ShmRings (one each way) and an eventfd per ring for wakeups.
+// OSC packets then travel through the rings instead of UDP; the socket stays open only so
+// each side notices when the other goes away. UDP is used for everything while no matron is
+// connected, and never while one is, so packets stay in order.
+//
+
+#ifndef CRONE_SHMTRANSPORT_H
+#define CRONE_SHMTRANSPORT_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <lo/lo.h>
+
+#include "ShmRing.h"
+
+namespace crone {
+
+class ShmTransport {
+  public:
+    // called on the transport thread with each raw OSC packet from matron
+    typedef std::function<void(void *data, size_t size)> PacketHandler;
+
+    static void init(const std::string &port, PacketHandler handler);
+    static void deinit();
+
+    // send a message to matron over the link, waiting a few ms for room if the ring is full.
+    // returns false if no matron is connected; the caller should send it over UDP instead.
+    // while one is connected everything goes through the link, so a packet too big for the
+    // ring, or one matron has no room for in time, is dropped with an error rather than
+    // overtaking the rest by UDP.
+    static bool send(const char *path, lo_message msg);
+    static bool send(lo_bundle bundle);
+
+  private:
+    // layout of the shared memory; must match matron/src/crone_shm.c
+    struct Link {
+        ShmRing toCrone;
+        ShmRing toMatron;
+    };
+
+    // how long to wait for matron to make room in a full ring: FullTries tries FullWaitUs apart.
+    // a matron that can't keep up for that long is stuck; its packets are dropped, as UDP would.
+    static constexpr int FullWaitUs = 100;
+    static constexpr int FullTries = 50;
+
+    static void loop();
+    static bool openLink(int conn);
+    static void closeLink();
+    static bool serve(int conn);
+    static void drain();
+    // copy one packet into the ring; `serialise` writes exactly `len` bytes to the pointer it's given
+    static bool writePacket(size_t len, const std::function<void(void *)> &serialise);
+
+    static PacketHandler handler;
+    static std::thread thread;
+    static int listenFd;
+    static int stopFd;
+
+    // guards the mapping and matron's wakeup fd against teardown while sending
+    static std::mutex sendLock;
+    static Link *link;
+    static int wakeCroneFd;
+    static int wakeMatronFd;
+    static std::atomic<bool> connected;
+    // packets dropped because matron let the ring fill up
+    static std::atomic<unsigned int> dropped;
+};
+
+} // namespace crone
+
+#endif // CRONE_SHMTRANSPORT_H
@@ -24,28 +24,110 @@ static inline void clamp(float &x, const float min, const float max) {
     x = std::max(min, std::min(max, x));
 }
 
-crone::SoftcutClient::SoftcutClient() : Client<2, 2>("softcut") {
+crone::SoftcutClient::SoftcutClient()
+        : Client<2, 2>("softcut"), reportPhase(false), paramSerial(0), timestampCommands(false),
+          phaseEvents(PhaseEventCapacity) {
     for (unsigned int i = 0; i < NumVoices; ++i) {
         cut.setVoiceBuffer(i, buf[i & 1], BufFrames);
+        quantPhase[i] = cut.getQuantPhase(i);
+    }
+    for (int v = 0; v < NumVoices; ++v) {
+        params.init(ParamLevel + v, outLevel[v].getTarget());
+        params.init(ParamPan + v, outPan[v].getTarget());
+        params.init(ParamLevelSlew + v, outLevel[v].time);
+        params.init(ParamPanSlew + v, outPan[v].time);
+        for (int ch = 0; ch < 2; ++ch) {
+            params.init(ParamInLevel + ch * NumVoices + v, inLevel[ch][v].getTarget());
+        }
+        for (int w = 0; w < NumVoices; ++w) {
+            params.init(ParamFbLevel + v * NumVoices + w, fbLevel[v][w].getTarget());
+        }
     }
     bufIdx[0] = BufDiskWorker::registerBuffer(buf[0], BufFrames);
     bufIdx[1] = BufDiskWorker::registerBuffer(buf[1], BufFrames);
 }
 
 void crone::SoftcutClient::process(jack_nframes_t numFrames) {
-    Commands::softcutCommands.handlePending(this);
+    jack_nframes_t blockStart = jack_last_frame_time(client);
+    Commands::softcutCommands.handlePending(this, blockStart);
+    applyParams();
     clearBusses(numFrames);
     mixInput(numFrames);
-    // process softcuts (overwrites output bus)
-    for (int v = 0; v < NumVoices; ++v) {
-        if (enabled[v]) {
-            cut.processBlock(v, input[v].buf[0], output[v].buf[0], static_cast<int>(numFrames));
+    // process softcuts (overwrites output bus),
+    // splitting the block wherever a timestamped command lands in it
+    size_t offset = 0;
+    Commands::CommandPacket p;
+    while (Commands::softcutCommands.nextTimed(blockStart + numFrames, p)) {
+        // anything left over from before an xrun lands at the start
+        auto frame = static_cast<size_t>(std::max(0, static_cast<int32_t>(p.frame - blockStart)));
+        if (frame > offset) {
+            processVoices(offset, frame - offset, blockStart + frame);
+            offset = frame;
         }
+        handleCommand(&p);
     }
+    processVoices(offset, numFrames - offset, blockStart + numFrames);
     mixOutput(numFrames);
     mix.copyTo(sink[0], numFrames);
 }
 
+void crone::SoftcutClient::processVoices(size_t offset, size_t numFrames, jack_nframes_t end) {
+    if (numFrames == 0) {
+        return;
+    }
+    for (int v = 0; v < NumVoices; ++v) {
+        if (enabled[v]) {
+            cut.processBlock(v, input[v].buf[0] + offset, output[v].buf[0] + offset, static_cast<int>(numFrames));
+        }
+    }
+    if (!reportPhase.load(std::memory_order_relaxed)) {
+        return;
+    }
+    for (int v = 0; v < NumVoices; ++v) {
+        softcut::phase_t phase = cut.getQuantPhase(v);
+        if (phase != quantPhase[v]) {
+            quantPhase[v] = phase;
+            // never allocates; if the poll has fallen that far behind, the event is dropped
+            phaseEvents.try_enqueue(PhaseEvent{end, v, phase});
+        }
+    }
+}
+
+void crone::SoftcutClient::postTimed(Commands::CommandPacket p) {
+    if (timestampCommands.load(std::memory_order_relaxed)) {
+        // one period after arrival: always still in the future when the audio thread gets it,
+        // so commands keep their relative timing instead of bunching up on block boundaries
+        p.timed = true;
+        p.frame = jack_frame_time(client) + jack_get_buffer_size(client);
+    }
+    Commands::softcutCommands.post(p);
+}
+
+void crone::SoftcutClient::applyParams() {
+    if (!params.changed(paramSerial)) {
+        return;
+    }
+    for (int v = 0; v < NumVoices; ++v) {
+        outLevel[v].setTarget(params.get(ParamLevel + v));
+        outPan[v].setTarget(params.get(ParamPan + v));
+        // setTime() computes a new coefficient; only do that when the time has changed
+        float t = params.get(ParamLevelSlew + v);
+        if (t != outLevel[v].time) {
+            outLevel[v].setTime(t);
+        }
+        t = params.get(ParamPanSlew + v);
+        if (t != outPan[v].time) {
+            outPan[v].setTime(t);
+        }
+        for (int ch = 0; ch < 2; ++ch) {
+            inLevel[ch][v].setTarget(params.get(ParamInLevel + ch * NumVoices + v));
+        }
+        for (int w = 0; w < NumVoices; ++w) {
+            fbLevel[v][w].setTarget(params.get(ParamFbLevel + v * NumVoices + w));
+        }
+    }
+}
+
 void crone::SoftcutClient::setSampleRate(jack_nframes_t sr) {
     bufDur = (float)BufFrames / sr;
     cut.setSampleRate(sr);
@@ -93,21 +175,6 @@ void crone::SoftcutClient::handleCommand(Commands::CommandPacket *p) {
 	    cut.stopVoice(idx_0);
 	}
 	break;
-    case Commands::Id::SET_LEVEL_CUT:
-	outLevel[idx_0].setTarget(value);
-	break;;
-    case Commands::Id::SET_PAN_CUT:
-	clamp(value, -1.f, 1.f);
-	outPan[idx_0].setTarget((value/2)+0.5);
-	break;
-    case Commands::Id::SET_LEVEL_IN_CUT:
-	clamp(idx_1, NumVoices-1);
-	inLevel[idx_0][idx_1].setTarget(value);
-	break;
-    case Commands::Id::SET_LEVEL_CUT_CUT:
-	clamp(idx_1, NumVoices-1);
-	fbLevel[idx_0][idx_1].setTarget(value);
-	break;
 	//-- softcut commands
     case Commands::Id::SET_CUT_RATE:
 	clamp(value, MinRate, MaxRate);
@@ -200,14 +267,6 @@ void crone::SoftcutClient::handleCommand(Commands::CommandPacket *p) {
 	cut.setPostFilterDry(idx_0, value);
 	break;
 
-    case Commands::Id::SET_CUT_LEVEL_SLEW_TIME:
-	value = std::max(0.f, value);
-	outLevel[idx_0].setTime(value);
-	break;
-    case Commands::Id::SET_CUT_PAN_SLEW_TIME:
-	value = std::max(0.f, value);
-	outPan[idx_0].setTime(value);
-	break;
     case Commands::Id::SET_CUT_RECPRE_SLEW_TIME:
 	value = std::max(0.f, value);
 	cut.setRecPreSlewTime(idx_0, value);
@@ -231,10 +290,10 @@ void crone::SoftcutClient::handleCommand(Commands::CommandPacket *p) {
 void crone::SoftcutClient::reset() {
     for (int v = 0; v < NumVoices; ++v) {
         cut.setVoiceBuffer(v, buf[v%2], BufFrames);
-        outLevel[v].setTarget(0.f);
-        outLevel->setTime(0.001);
-        outPan[v].setTarget(0.5f);
-        outPan->setTime(0.001);
+        setLevel(v, 0.f);
+        setLevelSlewTime(v, 0.001);
+        setPan(v, 0.f);
+        setPanSlewTime(v, 0.001);
 
         enabled[v] = false;
 
@@ -243,12 +302,12 @@ void crone::SoftcutClient::reset() {
 
         for (int i=0; i<2; ++i) {
             inLevel[i][v].setTime(0.001);
-            inLevel[i][v].setTarget(0.0);
+            setInLevel(i, v, 0.f);
         }
 
         for (int w=0; w<NumVoices; ++w) {
             fbLevel[v][w].setTime(0.001);
-            fbLevel[v][w].setTarget(0.0);
+            setFbLevel(v, w, 0.f);
         }
 
         cut.setLoopStart(v, v*2);
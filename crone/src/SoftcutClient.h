@@ -5,12 +5,16 @@
 #ifndef CRONE_CUTCLIENT_H
 #define CRONE_CUTCLIENT_H
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 
 #include "BufDiskWorker.h"
 #include "Bus.h"
 #include "Client.h"
+#include "ParamBlock.h"
 #include "Utilities.h"
+#include "readerwriterqueue.h"
 #include <softcut/Softcut.h>
 #include <softcut/Types.h>
 
@@ -24,9 +28,31 @@ class SoftcutClient : public Client<2, 2> {
     enum { NumVoices = 6 };
     enum { NumBuffers = 2 };
     typedef enum { SourceAdc = 0 } SourceId;
+    enum { PhaseEventCapacity = 256 };
+    // a voice's quantized phase changed, at the end of the block (or part block) ending on `frame`
+    struct PhaseEvent {
+        jack_nframes_t frame;
+        int voice;
+        softcut::phase_t phase;
+    };
     typedef Bus<2, MaxBlockFrames> StereoBus;
     typedef Bus<1, MaxBlockFrames> MonoBus;
 
+    // levels, pans and their slew times, held in the parameter block
+    // rather than set through the commands queue
+    enum {
+        // per voice
+        ParamLevel = 0,
+        ParamPan = ParamLevel + NumVoices,
+        ParamLevelSlew = ParamPan + NumVoices,
+        ParamPanSlew = ParamLevelSlew + NumVoices,
+        // [input channel][voice]
+        ParamInLevel = ParamPanSlew + NumVoices,
+        // [source voice][destination voice]
+        ParamFbLevel = ParamInLevel + 2 * NumVoices,
+        NumParams = ParamFbLevel + NumVoices * NumVoices
+    };
+
   public:
     SoftcutClient();
 
@@ -48,12 +74,29 @@ class SoftcutClient : public Client<2, 2> {
     LogRamp fbLevel[NumVoices][NumVoices];
     // enabled flags
     bool enabled[NumVoices];
+    // last quantized phase seen by the audio thread
     softcut::phase_t quantPhase[NumVoices];
+    // queue phase changes for the phase poll; nothing is checked while this is off
+    std::atomic<bool> reportPhase;
     float bufDur;
+    ParamBlock<NumParams> params;
+    // parameter block serial number last applied
+    uint32_t paramSerial;
+    // stamp position, rate and sync commands with the frame they should land on
+    std::atomic<bool> timestampCommands;
+    moodycamel::ReaderWriterQueue<PhaseEvent> phaseEvents;
 
   private:
     void process(jack_nframes_t numFrames) override;
     void setSampleRate(jack_nframes_t) override;
+    // pick up parameter changes; called once per block
+    void applyParams();
+    // run enabled voices over part of the block, ending on absolute frame `end`
+    void processVoices(size_t offset, size_t numFrames, jack_nframes_t end);
+    // out-of-range voice numbers are clamped, as for commands
+    static int voiceIndex(int i) {
+        return (i < 0 || i >= NumVoices) ? NumVoices - 1 : i;
+    }
     inline size_t secToFrame(float sec) {
         return static_cast<size_t>(sec * jack_get_sample_rate(Client::client));
     }
@@ -63,6 +106,44 @@ class SoftcutClient : public Client<2, 2> {
     void handleCommand(Commands::CommandPacket *p) override;
 
     // these accessors can be called from other threads, so don't need to go through the commands queue
+    //-- mix
+    void setLevel(int voice, float level) {
+        params.set(ParamLevel + voiceIndex(voice), level);
+    }
+
+    // -1 (left) to 1 (right)
+    void setPan(int voice, float pan) {
+        pan = std::max(-1.f, std::min(1.f, pan));
+        params.set(ParamPan + voiceIndex(voice), (pan / 2) + 0.5f);
+    }
+
+    void setLevelSlewTime(int voice, float sec) {
+        params.set(ParamLevelSlew + voiceIndex(voice), std::max(0.f, sec));
+    }
+
+    void setPanSlewTime(int voice, float sec) {
+        params.set(ParamPanSlew + voiceIndex(voice), std::max(0.f, sec));
+    }
+
+    void setInLevel(int ch, int voice, float level) {
+        if (ch < 0 || ch > 1) {
+            return;
+        }
+        params.set(ParamInLevel + ch * NumVoices + voiceIndex(voice), level);
+    }
+
+    void setFbLevel(int src, int dst, float level) {
+        params.set(ParamFbLevel + voiceIndex(src) * NumVoices + voiceIndex(dst), level);
+    }
+
+    //-- commands that can be applied mid-block, at the frame they arrived plus one period.
+    //-- with timestamps off they're applied at the start of the next block, like any other
+    void postTimed(Commands::CommandPacket p);
+
+    void setTimestampCommands(bool enabled) {
+        timestampCommands = enabled;
+    }
+
     //-- buffer manipulation
     //-- time parameters are in seconds
     //-- negative 'dur' parameter reads/clears/writes as much as possible.
@@ -114,14 +195,22 @@ class SoftcutClient : public Client<2, 2> {
         BufDiskWorker::requestRender(bufIdx[chan], start, dur, count, callback);
     }
 
-    // check if quantized phase has changed for a given voice
-    bool checkVoiceQuantPhase(int i) {
-        if (quantPhase[i] != cut.getQuantPhase(i)) {
-            quantPhase[i] = cut.getQuantPhase(i);
-            return true;
-        } else {
-            return false;
+    //-- phase changes are pushed from the audio thread as they happen.
+    //-- start and stop are called with the phase poll stopped, so only one thread reads the queue.
+    void startPhaseReports() {
+        PhaseEvent e;
+        // drop anything queued before the last stop
+        while (phaseEvents.try_dequeue(e)) {
         }
+        reportPhase = true;
+    }
+
+    void stopPhaseReports() {
+        reportPhase = false;
+    }
+
+    bool nextPhaseEvent(PhaseEvent &e) {
+        return phaseEvents.try_dequeue(e);
     }
 
     softcut::phase_t getQuantPhase(int i) {
@@ -201,9 +201,13 @@ class LogRamp {
         x0 = x;
     }
 
+    // closer than this to the target counts as there (-100dB)
+    static constexpr float SnapDistance = 1e-5f;
+
     // update output only
     float update() {
         y0 = smooth1pole(x0, y0, b);
+        snap();
         return y0;
     }
 
@@ -213,9 +217,51 @@ class LogRamp {
         return this->update();
     }
 
+    // update output for a run of samples, storing each.
+    // the distance to the target after i+1 samples is (y0 - x0) * b^(i+1); this steps four
+    // such distances at once by b^4, so there's no chain of dependent updates per sample.
+    void update(float *dst, size_t n) {
+        if (n == 0) {
+            return;
+        }
+        const float b2 = b * b;
+        const float b4 = b2 * b2;
+        const float d0 = y0 - x0;
+        float d[4] = {d0 * b, d0 * b2, d0 * b2 * b, d0 * b4};
+        float y = y0;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            for (size_t k = 0; k < 4; ++k) {
+                y = std::fabs(d[k]) < SnapDistance ? x0 : x0 + d[k];
+                dst[i + k] = y;
+                d[k] *= b4;
+            }
+        }
+        for (size_t k = 0; i + k < n; ++k) {
+            y = std::fabs(d[k]) < SnapDistance ? x0 : x0 + d[k];
+            dst[i + k] = y;
+        }
+        y0 = y;
+        snap();
+    }
+
+    // the output has reached the target, and stays there until it changes
+    bool isSteady() const {
+        return y0 == x0;
+    }
+
     float getTarget() {
         return x0;
     }
+
+  private:
+    // a one-pole smoother only approaches its target, and in floating point can stall short
+    // of it; settle on the target exactly so callers can treat the level as constant
+    void snap() {
+        if (std::fabs(y0 - x0) < SnapDistance) {
+            y0 = x0;
+        }
+    }
 };
 
 // a smoother with separate rise and fall times
@@ -0,0 +1,148 @@
+// time each Bus operation against the original per-sample loops, in ns per frame.
+//
+// usage: bench_bus [block size] [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Bus.h"
+#include "bus_reference.h"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+using crone::LogRamp;
+
+enum { MaxBlockSize = 2048 };
+typedef crone::Bus<2, MaxBlockSize> StereoBus;
+typedef crone::Bus<1, MaxBlockSize> MonoBus;
+typedef reference::Bus<2, MaxBlockSize> RefStereoBus;
+typedef reference::Bus<1, MaxBlockSize> RefMonoBus;
+
+static StereoBus a, b, c;
+static RefStereoBus ra, rb, rc;
+static MonoBus m;
+static RefMonoBus rm;
+
+static size_t blockSize = 128;
+static long iterations = 100000;
+
+// whether the ramps keep moving, or have settled on a constant gain
+static bool settled = false;
+
+// run `op` for every iteration and return ns per frame
+template <class Op> static double nsPerFrame(Op op) {
+    LogRamp level, pan;
+    if (settled) {
+        level.setTime(0.f);
+        pan.setTime(0.f);
+        level.setTarget(0.7f);
+        pan.setTarget(0.3f);
+        level.update();
+        pan.update();
+    } else {
+        // retarget often enough that they never get there
+        level.setTime(0.5f);
+        pan.setTime(0.5f);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        if (!settled && (i & 63) == 0) {
+            float t = (i & 64) ? 1.f : 0.f;
+            level.setTarget(t);
+            pan.setTarget(1.f - t);
+        }
+        op(level, pan);
+        // otherwise the compiler may notice that repeating some ops is redundant
+        asm volatile("" ::: "memory");
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (static_cast<double>(iterations) * blockSize);
+}
+
+template <class Op, class RefOp> static void bench(const char *name, Op op, RefOp ref) {
+    // best of four, taking turns to go first
+    double r = nsPerFrame(ref);
+    double t = nsPerFrame(op);
+    for (int i = 0; i < 3; ++i) {
+        if (i & 1) {
+            r = std::min(r, nsPerFrame(ref));
+            t = std::min(t, nsPerFrame(op));
+        } else {
+            t = std::min(t, nsPerFrame(op));
+            r = std::min(r, nsPerFrame(ref));
+        }
+    }
+    printf("%-14s %8.3f %8.3f   x%.1f\n", name, r, t, r / t);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        blockSize = static_cast<size_t>(atoi(argv[1]));
+    }
+    if (argc > 2) {
+        iterations = atol(argv[2]);
+    }
+    if (blockSize < 1 || blockSize >= MaxBlockSize) {
+        fprintf(stderr, "block size must be 1-%d\n", MaxBlockSize - 1);
+        return 1;
+    }
+#if defined(__SSE__)
+    // repeated gains wear the busses down to denormals, which would swamp everything else
+    _mm_setcsr(_mm_getcsr() | 0x8040);
+#endif
+    for (size_t fr = 0; fr < MaxBlockSize; ++fr) {
+        for (int ch = 0; ch < 2; ++ch) {
+            a.buf[ch][fr] = ra.buf[ch][fr] = 0.f;
+            b.buf[ch][fr] = rb.buf[ch][fr] = static_cast<float>(rand()) / RAND_MAX - 0.5f;
+            c.buf[ch][fr] = rc.buf[ch][fr] = static_cast<float>(rand()) / RAND_MAX - 0.5f;
+        }
+        m.buf[0][fr] = rm.buf[0][fr] = static_cast<float>(rand()) / RAND_MAX - 0.5f;
+    }
+    const size_t n = blockSize;
+    const float matrix[4] = {0.9f, 0.1f, 0.3f, 0.6f};
+    float *dst[2] = {c.buf[0], c.buf[1]};
+    float *rdst[2] = {rc.buf[0], rc.buf[1]};
+
+    printf("%zu frames per block, %ld blocks; ns/frame\n", blockSize, iterations);
+    for (int mode = 0; mode < 2; ++mode) {
+        settled = mode == 1;
+        printf("\n%-14s %8s %8s   (%s ramps)\n", "op", "scalar", "vector", settled ? "settled" : "moving");
+        bench(
+                "clear", [&](LogRamp &, LogRamp &) { a.clear(n); }, [&](LogRamp &, LogRamp &) { ra.clear(n); });
+        bench(
+                "copyFrom", [&](LogRamp &, LogRamp &) { a.copyFrom(b, n); },
+                [&](LogRamp &, LogRamp &) { ra.copyFrom(rb, n); });
+        bench(
+                "addFrom", [&](LogRamp &, LogRamp &) { a.addFrom(b, n); },
+                [&](LogRamp &, LogRamp &) { ra.addFrom(rb, n); });
+        bench(
+                "mixFrom", [&](LogRamp &l, LogRamp &) { a.mixFrom(b, n, l); },
+                [&](LogRamp &l, LogRamp &) { ra.mixFrom(rb, n, l); });
+        bench(
+                "applyGain", [&](LogRamp &l, LogRamp &) { a.applyGain(n, l); },
+                [&](LogRamp &l, LogRamp &) { ra.applyGain(n, l); });
+        bench(
+                "mixTo", [&](LogRamp &l, LogRamp &) { a.mixTo(dst, n, l); },
+                [&](LogRamp &l, LogRamp &) { ra.mixTo(rdst, n, l); });
+        bench(
+                "stereoMixFrom", [&](LogRamp &, LogRamp &) { a.stereoMixFrom(b, n, matrix); },
+                [&](LogRamp &, LogRamp &) { ra.stereoMixFrom(rb, n, matrix); });
+        bench(
+                "xfade", [&](LogRamp &l, LogRamp &) { a.xfade(b, c, n, l); },
+                [&](LogRamp &l, LogRamp &) { ra.xfade(rb, rc, n, l); });
+        bench(
+                "xfadeEp", [&](LogRamp &l, LogRamp &) { a.xfadeEp(b, c, n, l); },
+                [&](LogRamp &l, LogRamp &) { ra.xfadeEp(rb, rc, n, l); });
+        bench(
+                "panMixFrom", [&](LogRamp &l, LogRamp &p) { a.panMixFrom(m, n, l, p); },
+                [&](LogRamp &l, LogRamp &p) { ra.panMixFrom(rm, n, l, p); });
+        bench(
+                "panMixEpFrom", [&](LogRamp &l, LogRamp &p) { a.panMixEpFrom(m, n, l, p); },
+                [&](LogRamp &l, LogRamp &p) { ra.panMixEpFrom(rm, n, l, p); });
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+#ifndef BUS_REFERENCE_H
+#define BUS_REFERENCE_H
+
+// the original per-sample Bus loops, with the ramp updated inside the frame loop.
+// the vectorised Bus is checked and benchmarked against these.
+
+#include <cstddef>
+
+#include "Utilities.h"
+
+namespace reference {
+
+using crone::LogRamp;
+
+template <size_t NumChannels, size_t BlockSize> struct Bus {
+    float buf[NumChannels][BlockSize];
+
+    void clear(size_t numFrames) {
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            for (size_t fr = 0; fr < numFrames; ++fr) {
+                buf[ch][fr] = 0.f;
+            }
+        }
+    }
+
+    void copyFrom(Bus &b, size_t numFrames) {
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            for (size_t fr = 0; fr < numFrames; ++fr) {
+                buf[ch][fr] = b.buf[ch][fr];
+            }
+        }
+    }
+
+    void copyTo(float *dst[NumChannels], size_t numFrames) {
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            for (size_t fr = 0; fr < numFrames; ++fr) {
+                dst[ch][fr] = buf[ch][fr];
+            }
+        }
+    }
+
+    void addFrom(Bus &b, size_t numFrames) {
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            for (size_t fr = 0; fr < numFrames; ++fr) {
+                buf[ch][fr] += b.buf[ch][fr];
+            }
+        }
+    }
+
+    void mixFrom(Bus &b, size_t numFrames, float level) {
+        for (size_t ch = 0; ch < NumChannels; ++ch) {
+            for (size_t fr = 0; fr < numFrames; ++fr) {
+                buf[ch][fr] += b.buf[ch][fr] * level;
+            }
+        }
+    }
+
+    void mixFrom(Bus &b, size_t numFrames, LogRamp &level) {
+        for (size_t fr = 0; fr < numFrames; ++fr) {
+            float l = level.update();
+            for (size_t ch = 0; ch < NumChannels; ++ch) {
+                buf[ch][fr] += b.buf[ch][fr] * l;
+            }
+        }
+    }
+
+    void applyGain(size_t numFrames, LogRamp &level) {
+        for (size_t fr = 0; fr < numFrames; ++fr) {
+            float l = level.update();
+            for (size_t ch = 0; ch < NumChannels; ++ch) {
+                buf[ch][fr] *= l;
+            }
+        }
+    }
+
+    void mixFrom(const float *src[NumChannels], size_t numFrames, LogRamp &level) {
+        for (size_t fr = 0; fr < numFrames; ++fr) {
+            float l = level.update();
+            for (size_t ch = 0; ch < NumChannels; ++ch) {
+                buf[ch][fr] += src[ch][fr] * l;
+            }
+        }
+    }
+
+    void setFrom(const float *src[NumChannels], size_t numFrames, LogRamp &level) {
+        for (size_t fr = 0; fr < numFrames; ++fr) {
+            float l = level.update();
+            for (size_t ch = 0; ch < NumChannels; ++ch) {
+                buf[ch][fr] = src[ch][fr] * l;
+            }
+        }
+    }
+
+    void setFrom(const float *src[NumChannels], size_t numFrames) {
+        for (size_t fr = 0; fr < numFrames; ++fr) {
+            for (size_t ch = 0; ch < NumChannels; ++ch) {
+                buf[ch][fr] = src[ch][fr];
+            }
+        }
+    }
+
+    void mixTo(float *dst[NumChannels], size_t numFrames, LogRamp &level) {
+        for (size_t fr = 0; fr < numFrames; ++fr) {
+            float l = level.update();
+            for (size_t ch = 0; ch < NumChannels; ++ch) {
+                dst[ch][fr] = buf[ch][fr] * l;
+            }
+        }
+    }
+
+    void stereoMixFrom(Bus &b, size_t numFrames, const float level[4]) {
+        for (size_t fr = 0; fr < numFrames; ++fr) {
+            buf[0][fr] += b.buf[0][fr] * level[0] + b.buf[1][fr] * level[2];
+            buf[1][fr] += b.buf[0][fr] * level[1] + b.buf[1][fr] * level[3];
+        }
+    }
+
+    void xfade(Bus &a, Bus &b, size_t numFrames, LogRamp &level) {
+        for (size_t fr = 0; fr < numFrames; ++fr) {
+            float c = level.update();
+            for (size_t ch = 0; ch < NumChannels; ++ch) {
+                float x = a.buf[ch][fr];
+                float y = b.buf[ch][fr];
+                buf[ch][fr] = x + (y - x) * c;
+            }
+        }
+    }
+
+    void xfadeEp(Bus &a, Bus &b, size_t numFrames, LogRamp &level) {
+        for (size_t fr = 0; fr < numFrames; ++fr) {
+            float l = level.update() * (float)M_PI_2;
+            float c = sinf(l);
+            float d = cosf(l);
+            for (size_t ch = 0; ch < NumChannels; ++ch) {
+                buf[ch][fr] = a.buf[ch][fr] * c + b.buf[ch][fr] * d;
+            }
+        }
+    }
+
+    void panMixFrom(const Bus<1, BlockSize> &a, size_t numFrames, LogRamp &level, LogRamp &pan) {
+        for (size_t fr = 0; fr < numFrames; ++fr) {
+            float x = a.buf[0][fr];
+            float l = level.update();
+            float c = pan.update();
+            buf[0][fr] += x * l * (1.f - c);
+            buf[1][fr] += x * l * c;
+        }
+    }
+
+    void panMixEpFrom(const Bus<1, BlockSize> &a, size_t numFrames, LogRamp &level, LogRamp &pan) {
+        for (size_t fr = 0; fr < numFrames; ++fr) {
+            float x = a.buf[0][fr];
+            float l = level.update();
+            float c = pan.update() * (float)M_PI_2;
+            buf[0][fr] += x * l * cosf(c);
+            buf[1][fr] += x * l * sinf(c);
+        }
+    }
+};
+
+} // namespace reference
+
+#endif /* BUS_REFERENCE_H */
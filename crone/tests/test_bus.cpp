@@ -0,0 +1,296 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "Bus.h"
+#include "bus_reference.h"
+#include "test_helpers.h"
+
+using crone::LogRamp;
+
+enum { BlockSize = 2048 };
+typedef crone::Bus<2, BlockSize> StereoBus;
+typedef crone::Bus<1, BlockSize> MonoBus;
+typedef reference::Bus<2, BlockSize> RefStereoBus;
+typedef reference::Bus<1, BlockSize> RefMonoBus;
+
+// odd sizes exercise the scalar tail after the vector loop
+static const size_t frameCounts[] = {0, 1, 3, 4, 5, 64, 127, BlockSize - 1};
+
+// smoothed gains are computed in closed form rather than one sample at a time, which rounds
+// a little differently, and can settle on the target a sample earlier or later (LogRamp::SnapDistance)
+static const float tolerance = 5e-5f;
+
+// two busses holding the same noise
+template <class A, class B> static void fill(A &a, B &b) {
+    for (size_t ch = 0; ch < sizeof(a.buf) / sizeof(a.buf[0]); ++ch) {
+        for (size_t fr = 0; fr < BlockSize; ++fr) {
+            float x = static_cast<float>(rand()) / RAND_MAX * 2.f - 1.f;
+            a.buf[ch][fr] = x;
+            b.buf[ch][fr] = x;
+        }
+    }
+}
+
+// the vector kernels need not round exactly like the scalar ones: the compiler may fuse the
+// scalar multiply-adds (-ffp-contract, -ffast-math) where the vector code keeps them separate
+static void assertSameFrames(const float *expected, const float *actual) {
+    for (size_t fr = 0; fr < BlockSize; ++fr) {
+        TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected[fr], actual[fr]);
+    }
+}
+
+template <class A, class B> static void assertSame(const A &a, const B &b) {
+    for (size_t ch = 0; ch < sizeof(a.buf) / sizeof(a.buf[0]); ++ch) {
+        for (size_t fr = 0; fr < BlockSize; ++fr) {
+            TEST_ASSERT_FLOAT_WITHIN(tolerance, b.buf[ch][fr], a.buf[ch][fr]);
+        }
+    }
+}
+
+// a ramp partway to a new target, so every frame gets a different gain
+static void moving(LogRamp &r, LogRamp &s, float from, float to) {
+    r.setTime(0.01f);
+    s.setTime(0.01f);
+    r.setTarget(from);
+    s.setTarget(from);
+    for (int i = 0; i < 2000; ++i) {
+        r.update();
+        s.update();
+    }
+    r.setTarget(to);
+    s.setTarget(to);
+}
+
+static StereoBus a, b, c;
+static RefStereoBus ra, rb, rc;
+static MonoBus m;
+static RefMonoBus rm;
+
+static void fillAll() {
+    fill(a, ra);
+    fill(b, rb);
+    fill(c, rc);
+    fill(m, rm);
+}
+
+void test_kernels_match_scalar(void) {
+    float x[BlockSize], y[BlockSize], g[BlockSize], h[BlockSize], d0[BlockSize], d1[BlockSize];
+    for (size_t i = 0; i < BlockSize; ++i) {
+        x[i] = static_cast<float>(rand()) / RAND_MAX - 0.5f;
+        y[i] = static_cast<float>(rand()) / RAND_MAX - 0.5f;
+        g[i] = static_cast<float>(rand()) / RAND_MAX;
+        h[i] = static_cast<float>(rand()) / RAND_MAX;
+    }
+    for (size_t n : frameCounts) {
+        std::memcpy(d0, x, sizeof(d0));
+        std::memcpy(d1, x, sizeof(d1));
+        crone::kernels::addMul(d0, y, g, n);
+        crone::kernels::scalar::addMul(d1, y, g, n);
+        assertSameFrames(d1, d0);
+
+        crone::kernels::mul(d0, h, n);
+        crone::kernels::scalar::mul(d1, h, n);
+        assertSameFrames(d1, d0);
+
+        crone::kernels::addScaled2(d0, x, 0.3f, y, 0.7f, n);
+        crone::kernels::scalar::addScaled2(d1, x, 0.3f, y, 0.7f, n);
+        assertSameFrames(d1, d0);
+
+        crone::kernels::lerp(d0, x, y, g, n);
+        crone::kernels::scalar::lerp(d1, x, y, g, n);
+        assertSameFrames(d1, d0);
+
+        crone::kernels::setMul2(d0, x, g, y, h, n);
+        crone::kernels::scalar::setMul2(d1, x, g, y, h, n);
+        assertSameFrames(d1, d0);
+
+        crone::kernels::clear(d0, n);
+        crone::kernels::scalar::clear(d1, n);
+        assertSameFrames(d1, d0);
+    }
+}
+
+void test_copy_add_clear(void) {
+    for (size_t n : frameCounts) {
+        fillAll();
+        a.addFrom(b, n);
+        ra.addFrom(rb, n);
+        assertSame(a, ra);
+        a.mixFrom(c, n, 0.25f);
+        ra.mixFrom(rc, n, 0.25f);
+        assertSame(a, ra);
+        a.copyFrom(b, n);
+        ra.copyFrom(rb, n);
+        assertSame(a, ra);
+
+        const float *src[2] = {c.buf[0], c.buf[1]};
+        const float *rsrc[2] = {rc.buf[0], rc.buf[1]};
+        a.setFrom(src, n);
+        ra.setFrom(rsrc, n);
+        assertSame(a, ra);
+        // copyTo writes only the first n frames of each channel
+        float *dst[2] = {b.buf[0], b.buf[1]};
+        float *rdst[2] = {rb.buf[0], rb.buf[1]};
+        a.copyTo(dst, n);
+        ra.copyTo(rdst, n);
+        assertSame(b, rb);
+        a.clear(n);
+        ra.clear(n);
+        assertSame(a, ra);
+    }
+}
+
+void test_smoothed_gain(void) {
+    for (size_t n : frameCounts) {
+        LogRamp l, rl;
+        fillAll();
+        moving(l, rl, 0.2f, 1.f);
+        a.mixFrom(b, n, l);
+        ra.mixFrom(rb, n, rl);
+        assertSame(a, ra);
+        a.applyGain(n, l);
+        ra.applyGain(n, rl);
+        assertSame(a, ra);
+
+        const float *src[2] = {c.buf[0], c.buf[1]};
+        const float *rsrc[2] = {rc.buf[0], rc.buf[1]};
+        a.mixFrom(src, n, l);
+        ra.mixFrom(rsrc, n, rl);
+        assertSame(a, ra);
+        a.setFrom(src, n, l);
+        ra.setFrom(rsrc, n, rl);
+        assertSame(a, ra);
+
+        float *dst[2] = {b.buf[0], b.buf[1]};
+        float *rdst[2] = {rb.buf[0], rb.buf[1]};
+        a.mixTo(dst, n, l);
+        ra.mixTo(rdst, n, rl);
+        assertSame(b, rb);
+        // the ramps have to end up in the same place too
+        TEST_ASSERT_FLOAT_WITHIN(tolerance, rl.update(), l.update());
+    }
+}
+
+void test_matrix_and_xfade(void) {
+    const float matrix[4] = {0.9f, 0.1f, 0.3f, 0.6f};
+    for (size_t n : frameCounts) {
+        LogRamp l, rl;
+        fillAll();
+        a.stereoMixFrom(b, n, matrix);
+        ra.stereoMixFrom(rb, n, matrix);
+        assertSame(a, ra);
+
+        moving(l, rl, 0.f, 1.f);
+        a.xfade(b, c, n, l);
+        ra.xfade(rb, rc, n, rl);
+        assertSame(a, ra);
+
+        moving(l, rl, 1.f, 0.f);
+        a.xfadeEp(b, c, n, l);
+        ra.xfadeEp(rb, rc, n, rl);
+        assertSame(a, ra);
+    }
+}
+
+void test_pan(void) {
+    for (size_t n : frameCounts) {
+        LogRamp l, rl, p, rp;
+        fillAll();
+        moving(l, rl, 0.5f, 1.f);
+        moving(p, rp, 0.f, 1.f);
+        a.panMixFrom(m, n, l, p);
+        ra.panMixFrom(rm, n, rl, rp);
+        assertSame(a, ra);
+        a.panMixEpFrom(m, n, l, p);
+        ra.panMixEpFrom(rm, n, rl, rp);
+        assertSame(a, ra);
+    }
+}
+
+// a ramp that has settled on `x`
+static void steady(LogRamp &r, LogRamp &s, float x) {
+    r.setTime(0.f);
+    s.setTime(0.f);
+    r.setTarget(x);
+    s.setTarget(x);
+    r.update();
+    s.update();
+}
+
+void test_ramp_settles(void) {
+    LogRamp r;
+    r.setTime(0.05f);
+    r.setTarget(0.7f);
+    TEST_ASSERT_FALSE(r.isSteady());
+    float buf[BlockSize];
+    // -60dB in 0.05s, so -100dB well within a second
+    for (int i = 0; i < 48000 / 512; ++i) {
+        r.update(buf, 512);
+    }
+    TEST_ASSERT_TRUE(r.isSteady());
+    TEST_ASSERT_EQUAL_FLOAT(0.7f, r.update());
+    r.setTarget(0.f);
+    TEST_ASSERT_FALSE(r.isSteady());
+}
+
+// settled ramps take the constant-gain paths, including skipping and copying for 0 and 1
+void test_steady_gain(void) {
+    const float gains[] = {0.f, 1.f, 0.5f};
+    for (float g : gains) {
+        for (size_t n : frameCounts) {
+            LogRamp l, rl, p, rp;
+            fillAll();
+            steady(l, rl, g);
+            a.mixFrom(b, n, l);
+            ra.mixFrom(rb, n, rl);
+            assertSame(a, ra);
+            a.applyGain(n, l);
+            ra.applyGain(n, rl);
+            assertSame(a, ra);
+
+            const float *src[2] = {c.buf[0], c.buf[1]};
+            const float *rsrc[2] = {rc.buf[0], rc.buf[1]};
+            a.mixFrom(src, n, l);
+            ra.mixFrom(rsrc, n, rl);
+            assertSame(a, ra);
+            a.setFrom(src, n, l);
+            ra.setFrom(rsrc, n, rl);
+            assertSame(a, ra);
+
+            float *dst[2] = {b.buf[0], b.buf[1]};
+            float *rdst[2] = {rb.buf[0], rb.buf[1]};
+            a.mixTo(dst, n, l);
+            ra.mixTo(rdst, n, rl);
+            assertSame(b, rb);
+
+            a.xfade(b, c, n, l);
+            ra.xfade(rb, rc, n, rl);
+            assertSame(a, ra);
+            a.xfadeEp(b, c, n, l);
+            ra.xfadeEp(rb, rc, n, rl);
+            assertSame(a, ra);
+
+            steady(p, rp, 1.f - g);
+            a.panMixFrom(m, n, l, p);
+            ra.panMixFrom(rm, n, rl, rp);
+            assertSame(a, ra);
+            a.panMixEpFrom(m, n, l, p);
+            ra.panMixEpFrom(rm, n, rl, rp);
+            assertSame(a, ra);
+        }
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_kernels_match_scalar);
+    RUN_TEST(test_copy_add_clear);
+    RUN_TEST(test_smoothed_gain);
+    RUN_TEST(test_matrix_and_xfade);
+    RUN_TEST(test_pan);
+    RUN_TEST(test_ramp_settles);
+    RUN_TEST(test_steady_gain);
+
+    return UNITY_END();
+}
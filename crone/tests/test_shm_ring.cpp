@@ -0,0 +1,169 @@
+// ShmRing is crone's copy of matron/src/shm_ring.c; these follow matron/tests/test_shm_ring.c.
+
+#include <cstdint>
+#include <cstring>
+
+#include "ShmRing.h"
+#include "test_helpers.h"
+
+using crone::ShmRing;
+
+static ShmRing ring;
+
+// a packet of `len` bytes, each the low byte of `seq` plus its offset
+static bool push(size_t len, uint32_t seq) {
+    auto *dst = static_cast<uint8_t *>(ring.reserve(len));
+    if (dst == nullptr) {
+        return false;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        dst[i] = static_cast<uint8_t>(seq + i);
+    }
+    ring.commit(len);
+    return true;
+}
+
+static bool pop(size_t expectedLen, uint32_t seq) {
+    size_t len = 0;
+    auto *src = static_cast<const uint8_t *>(ring.peek(len));
+    if (src == nullptr || len != expectedLen) {
+        return false;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        if (src[i] != static_cast<uint8_t>(seq + i)) {
+            return false;
+        }
+    }
+    ring.release(len);
+    return true;
+}
+
+static void test_init() {
+    std::memset(&ring, 0, sizeof(ring));
+    TEST_ASSERT_FALSE(ring.valid());
+    ring.init();
+    TEST_ASSERT_TRUE(ring.valid());
+    size_t len;
+    TEST_ASSERT_NULL(ring.peek(len));
+}
+
+// records of awkward sizes, with the producer running ahead, go round the ring many times
+static void test_wraparound() {
+    enum { Backlog = 32 };
+    size_t lens[Backlog];
+    uint32_t produced = 0;
+    uint32_t consumed = 0;
+    uint32_t rng = 1;
+    int wraps = 0;
+    const void *last = nullptr;
+
+    ring.init();
+    while (consumed < 2000) {
+        while (produced - consumed < Backlog) {
+            rng = rng * 1664525u + 1013904223u;
+            size_t len = 1 + (rng >> 8) % 3000;
+            if (!push(len, produced)) {
+                break;
+            }
+            lens[produced % Backlog] = len;
+            produced++;
+        }
+        uint32_t n = 1 + (rng >> 20) % (produced - consumed);
+        for (uint32_t i = 0; i < n; ++i) {
+            size_t len;
+            const void *src = ring.peek(len);
+            TEST_ASSERT_NOT_NULL(src);
+            if (last != nullptr && src < last) {
+                wraps++;
+            }
+            last = src;
+            TEST_ASSERT_TRUE(pop(lens[consumed % Backlog], consumed));
+            consumed++;
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(10, wraps);
+}
+
+// a full ring refuses records until the consumer makes room
+static void test_full() {
+    // 4 bytes of length plus 1020 of packet: 1024 to a record, so 64 fill the ring exactly
+    const size_t len = 1020;
+    const int fit = ShmRing::Size / 1024;
+
+    ring.init();
+    for (int i = 0; i < fit; ++i) {
+        TEST_ASSERT_TRUE(push(len, i));
+    }
+    TEST_ASSERT_NULL(ring.reserve(len));
+    TEST_ASSERT_NULL(ring.reserve(1));
+
+    TEST_ASSERT_TRUE(pop(len, 0));
+    TEST_ASSERT_TRUE(push(len, fit));
+    TEST_ASSERT_NULL(ring.reserve(1));
+
+    for (int i = 1; i <= fit; ++i) {
+        TEST_ASSERT_TRUE(pop(len, i));
+    }
+    size_t n;
+    TEST_ASSERT_NULL(ring.peek(n));
+}
+
+// the producer wakes the consumer only on empty -> non-empty; the consumer sleeps only on empty
+static void test_wakeups() {
+    ring.init();
+
+    TEST_ASSERT_NOT_NULL(ring.reserve(16));
+    TEST_ASSERT_TRUE(ring.commit(16));
+    TEST_ASSERT_NOT_NULL(ring.reserve(16));
+    TEST_ASSERT_FALSE(ring.commit(16));
+
+    size_t len;
+    TEST_ASSERT_NOT_NULL(ring.peek(len));
+    TEST_ASSERT_FALSE(ring.release(len));
+    TEST_ASSERT_NOT_NULL(ring.peek(len));
+    TEST_ASSERT_TRUE(ring.release(len));
+
+    TEST_ASSERT_NOT_NULL(ring.reserve(16));
+    TEST_ASSERT_TRUE(ring.commit(16));
+}
+
+// a commit that has to skip the end of the ring still reports an empty ring
+static void test_wakeup_across_wrap() {
+    const size_t len = 1000;
+    ring.init();
+    // 65 records of 1008 bytes leave 16 at the end, too few for the next
+    for (int i = 0; i < 65; ++i) {
+        TEST_ASSERT_TRUE(push(len, i));
+        TEST_ASSERT_TRUE(pop(len, i));
+    }
+    TEST_ASSERT_NOT_NULL(ring.reserve(len));
+    TEST_ASSERT_TRUE(ring.commit(len));
+    size_t n;
+    const void *p = ring.peek(n);
+    TEST_ASSERT_EQUAL_PTR(&ring.data[sizeof(uint32_t)], p);
+    TEST_ASSERT_TRUE(ring.release(n));
+}
+
+static void test_oversized() {
+    ring.init();
+    TEST_ASSERT_NULL(ring.reserve(ShmRing::RecordMax + 1));
+    TEST_ASSERT_NULL(ring.reserve(ShmRing::Size));
+    size_t n;
+    TEST_ASSERT_NULL(ring.peek(n));
+
+    TEST_ASSERT_TRUE(push(ShmRing::RecordMax, 7));
+    TEST_ASSERT_TRUE(pop(ShmRing::RecordMax, 7));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_init);
+    RUN_TEST(test_wraparound);
+    RUN_TEST(test_full);
+    RUN_TEST(test_wakeups);
+    RUN_TEST(test_wakeup_across_wrap);
+    RUN_TEST(test_oversized);
+
+    return UNITY_END();
+}
@@ -25,7 +25,10 @@ for i = 1, 4 do
 
 		led = vport.wrap_method("led"),
 		all = vport.wrap_method("all"),
+		ring = vport.wrap_method("ring"),
+		ring_range = vport.wrap_method("ring_range"),
 		refresh = vport.wrap_method("refresh"),
+		refresh_rate = vport.wrap_method("refresh_rate"),
 		segment = vport.wrap_method("segment"),
 	}
 end
@@ -34,14 +37,14 @@ end
 -- @tparam integer id : arbitrary numeric identifier
 -- @tparam string serial : serial
 -- @tparam string name : name
--- @tparam userdata dev : opaque pointer to device
+-- @tparam integer dev : opaque handle to device
 function Arc.new(id, serial, name, dev)
 	local device = setmetatable({}, Arc)
 
 	device.id = id
 	device.serial = serial
 	device.name = name .. " " .. serial
-	device.dev = dev -- opaque pointer
+	device.dev = dev -- opaque handle
 	device.delta = nil -- delta event callback
 	device.key = nil -- key event callback
 	device.remove = nil -- device unplug callback
@@ -92,11 +95,37 @@ function Arc:all(val)
 	_norns.arc_all_led(self.dev, val)
 end
 
+--- set the LEDs of a ring in one call.
+-- @tparam integer ring : ring index (1-based)
+-- @param levels : string of up to 64 bytes, or table of up to 64 values, in [0, 15]
+function Arc:ring(ring, levels)
+	if type(levels) == "table" then
+		levels = string.char(table.unpack(levels))
+	end
+	_norns.arc_set_ring(self.dev, ring, levels)
+end
+
+--- set a range of LEDs on a ring to the same brightness.
+-- @tparam integer ring : ring index (1-based)
+-- @tparam integer from : first LED (1-based)
+-- @tparam integer to : last LED (1-based), wrapping past 64
+-- @tparam integer val : LED brightness in [0, 15]
+function Arc:ring_range(ring, from, to, val)
+	_norns.arc_ring_range(self.dev, ring, from, to, val)
+end
+
 --- update any dirty quads on this arc device.
+-- LEDs are sent from a background thread, at most once per refresh interval.
 function Arc:refresh()
 	_norns.monome_refresh(self.dev)
 end
 
+--- limit how often LED updates are sent to this arc device.
+-- @tparam number fps : updates per second (default 60)
+function Arc:refresh_rate(fps)
+	_norns.monome_refresh_rate(self.dev, fps)
+end
+
 --- create an anti-aliased point to point arc
 -- segment/range on a specific LED ring.
 -- each point can be a decimal, LEDs will fade for in between values.
@@ -135,8 +164,8 @@ function Arc:segment(ring, from, to, level)
 
 		local o = overlap_segments(from, to, sa, sb)
 		m[i] = util.round(o / sl * level)
-		self:led(ring, i, m[i])
 	end
+	self:ring(ring, m)
 end
 
 --- create device, returns object with handler and send
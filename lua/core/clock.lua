@@ -9,6 +9,9 @@ local clock = {}
 
 clock.threads = {}
 
+-- lattices pulsed by the native clock engine, indexed by engine id (see lib/lattice)
+clock.lattices = {}
+
 local clock_id_counter = 1
 local function new_id()
   local id = clock_id_counter
@@ -89,6 +92,9 @@ clock.cleanup = function()
     end
   end
 
+  _norns.clock_lattice_free_all()
+  clock.lattices = {}
+
   clock.transport.start = nil
   clock.transport.stop = nil
   clock.tempo_change_handler = nil
@@ -125,6 +131,12 @@ clock.get_beat_sec = function()
   return 60.0 / clock.get_tempo()
 end
 
+--- get current clock system time in seconds.
+-- this is the time base used for timestamped midi output (see midi:send_at).
+clock.get_system_time = function()
+  return _norns.clock_get_system_time()
+end
+
 
 clock.transport = {}
 
@@ -202,6 +214,13 @@ _norns.clock.stop = function()
   end
 end
 
+_norns.clock.lattice = function(id, sprocket_id, transport, phase)
+  local lattice = clock.lattices[id]
+  if lattice ~= nil then
+    lattice:fire(sprocket_id, transport, phase)
+  end
+end
+
 
 function clock.add_params()
   local send_midi_clock = {}
@@ -380,6 +399,7 @@ clock.get_beats()             (returns) current time in beats
 clock.get_tempo()             (returns) current tempo
 clock.get_beat_sec()          (returns) length of a single beat at current
                                 tempo in seconds
+clock.get_system_time()       (returns) current clock system time in seconds
 -- -----------------------------------------------------------------------------
 -- example
 
@@ -23,26 +23,13 @@ _norns.crow.remove = function(id)
   norns.crow.remove(id)
 end
 
-local ebuffer = ""
+-- called once per complete line from crow (framed in C, without the line terminator)
 _norns.crow.event = function(id, line)
-  local function evalcrow(line)
-    line, reps = (ebuffer .. line):gsub("%^%^", "norns.crow.events.")
-    ebuffer = "" -- ebuffer has been processed, so reset it
-    if reps > 0 then
-      assert(load(line))()
-    else
-      norns.crow.receive(line)
-    end
-  end
-
-  local n, m = line:find "%c+"
-  if not n then                -- no control chars found
-    ebuffer = ebuffer .. line  -- line incomplete so add it to the buffer
+  local line, reps = line:gsub("%^%^", "norns.crow.events.")
+  if reps > 0 then
+    assert(load(line))()
   else
-    evalcrow(line:sub(1, n - 1)) -- process complete segment
-    if m < #line then          -- recur with post-whitespace remainder
-      _norns.crow.event(id, line:sub(m + 1, -1))
-    end
+    norns.crow.receive(line)
   end
 end
 
@@ -18,6 +18,7 @@ encoders.time = { now, now, now }
 encoders.callback = norns.none
 
 --- set acceleration
+-- hardware encoders are accelerated by their drivers, before deltas are batched
 encoders.set_accel = function(n, z)
   if n == 0 then
     for k = 1, 3 do
@@ -28,6 +29,7 @@ encoders.set_accel = function(n, z)
     encoders.accel[n] = z
     encoders.tick[n] = 0
   end
+  _norns.enc_accel(n, z and true or false)
 end
 
 --- set sensitivity
@@ -59,7 +61,9 @@ encoders.process = function(n, d)
   end
 end
 
---- process delta, selected if _norns.adc_rev() == 0 in norns.lua
+--- process delta, accelerating by the time between calls.
+-- no longer selected in norns.lua: encoder events now carry batched deltas,
+-- so their spacing says little about speed.
 encoders.process_with_accel = function(n, d)
   now = util.time()
   local diff = now - encoders.time[n]
@@ -82,6 +82,21 @@ Engine.list_commands = function()
   end
 end
 
+--- send the commands issued in each callback as one OSC bundle.
+-- a chord of many voice commands then costs one packet instead of one per command.
+-- @param enabled - boolean
+-- @param latency - (optional) seconds ahead to timestamp each bundle, for scheduling in sclang;
+-- default 0 (run on arrival)
+Engine.set_bundling = function(enabled, latency)
+  _norns.command_bundling(enabled, latency or 0)
+end
+
+--- count commands sent, and the packets that carried them.
+-- @return - commands, packets
+Engine.command_stats = function()
+  return _norns.command_stats()
+end
+
 --- load a named engine, with a callback.
 -- @param name - name of engine
 -- @param callback - function to call on engine load. will receive command list
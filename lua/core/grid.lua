@@ -24,9 +24,11 @@ for i = 1, 4 do
 
     led = vport.wrap_method('led'),
     all = vport.wrap_method('all'),
+    region = vport.wrap_method('region'),
     refresh = vport.wrap_method('refresh'),
     rotation = vport.wrap_method('rotation'),
     intensity = vport.wrap_method('intensity'),
+    refresh_rate = vport.wrap_method('refresh_rate'),
     tilt_enable = vport.wrap_method('tilt_enable'),
 
     cols = 0,
@@ -38,14 +40,14 @@ end
 -- @tparam integer id : arbitrary numeric identifier
 -- @tparam string serial : serial
 -- @tparam string name : name
--- @tparam userdata dev : opaque pointer to device
+-- @tparam integer dev : opaque handle to device
 function Grid.new(id, serial, name, dev)
   local g = setmetatable({}, Grid)
 
   g.id = id
   g.serial = serial
   g.name = name .. " " .. serial
-  g.dev = dev    -- opaque pointer
+  g.dev = dev    -- opaque handle
   g.key = nil    -- key event callback
   g.tilt = nil   -- tilt event callback
   g.remove = nil -- device unplug callback
@@ -115,11 +117,31 @@ function Grid:all(val)
   _norns.grid_all_led(self.dev, val)
 end
 
+--- set a rectangle of LEDs on this grid device in one call.
+-- @tparam integer x : left column (1-based!)
+-- @tparam integer y : top row (1-based!)
+-- @tparam integer w : width
+-- @tparam integer h : height
+-- @param levels : string of w*h bytes, or table of w*h values, in [0, 15], row by row
+function Grid:region(x, y, w, h, levels)
+  if type(levels) == "table" then
+    levels = string.char(table.unpack(levels))
+  end
+  _norns.grid_set_region(self.dev, x, y, w, h, levels)
+end
+
 --- update any dirty quads on this grid device.
+-- LEDs are sent from a background thread, at most once per refresh interval.
 function Grid:refresh()
   _norns.monome_refresh(self.dev)
 end
 
+--- limit how often LED updates are sent to this grid device.
+-- @tparam number fps : updates per second (default 60)
+function Grid:refresh_rate(fps)
+  _norns.monome_refresh_rate(self.dev, fps)
+end
+
 --- intensity
 function Grid:intensity(i)
   _norns.monome_intensity(self.dev, i)
@@ -24,6 +24,7 @@ for i = 1, 4 do
     device = nil,
 
     event = nil,
+    frame = nil,
   }
 end
 
@@ -32,15 +33,16 @@ end
 -- @tparam string name : name
 -- @tparam table types : array of supported event types. keys are type codes, values are strings
 -- @tparam table codes : array of supported codes. each entry is a table of codes of a given type. subtables are indexed by supported code numbers; values are code names
--- @tparam userdata dev : opaque pointer to device
+-- @tparam integer dev : opaque handle to device
 function Hid.new(id, name, types, codes, dev, guid)
   local device = setmetatable({}, Hid)
 
   device.id = id
   device.name = vport.get_unique_device_name(name, Hid.devices)
-  device.dev = dev    -- opaque pointer
+  device.dev = dev    -- opaque handle
   device.guid = guid  -- SDL format GUID
-  device.event = nil  -- event callback
+  device.event = nil  -- event callback, once per input code
+  device.frame = nil  -- frame callback, once per SYN_REPORT
   device.remove = nil -- device unplug callback
   device.port = nil
 
@@ -97,6 +99,15 @@ end
 -- @param dev : a Hid table
 function Hid.remove(dev) end
 
+--- choose which input codes are delivered from this device.
+-- unsubscribed codes are dropped before they reach lua.
+-- @tparam integer type : event type (see Hid.types), or nil for all types
+-- @tparam integer code : event code, or nil for all codes of the type
+-- @tparam boolean enabled : deliver (true) or drop (false)
+function Hid:subscribe(type, code, enabled)
+  _norns.hid_subscribe(self.dev, type or -1, code or -1, enabled ~= false)
+end
+
 --- create device, returns object with handler and send
 -- @static
 function Hid.connect(n)
@@ -110,10 +121,13 @@ end
 function Hid.cleanup()
   for i = 1, 4 do
     Hid.vports[i].event = nil
+    Hid.vports[i].frame = nil
   end
 
   for _, dev in pairs(Hid.devices) do
     dev.event = nil
+    dev.frame = nil
+    _norns.hid_subscribe(dev.dev, -1, -1, true)
   end
 
   Hid.add = function(dev)
@@ -168,6 +182,27 @@ _norns.hid.remove = function(id)
   Hid.update_devices()
 end
 
+-- all codes reported together by the device, as a flat array of
+-- type, code, value triples. absolute axes appear once with their latest value.
+_norns.hid.frame = function(id, frame)
+  local device = Hid.devices[id]
+
+  if device == nil then
+    error('no entry for hid ' .. id)
+  end
+
+  if device.frame then
+    device.frame(frame)
+  end
+  if device.port and Hid.vports[device.port].frame then
+    Hid.vports[device.port].frame(frame)
+  end
+
+  for i = 1, #frame, 3 do
+    _norns.hid.event(id, frame[i], frame[i + 1], frame[i + 2])
+  end
+end
+
 _norns.hid.event = function(id, type, code, value)
   local device = Hid.devices[id]
 
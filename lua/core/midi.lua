@@ -20,8 +20,14 @@ for i = 1, 16 do
     device = nil,
     connected = false,
     event = nil,
+    sysex = nil,
 
     send = function(self, ...) if self.device then self.device:send(...) end end,
+    send_at = function(self, ...) if self.device then return self.device:send_at(...) end end,
+    send_at_beat = function(self, ...) if self.device then return self.device:send_at_beat(...) end end,
+    clear_scheduled = function(self) if self.device then self.device:clear_scheduled() end end,
+    filter = function(self, ...) if self.device then self.device:filter(...) end end,
+    clear_filters = function(self) if self.device then self.device:clear_filters() end end,
 
     note_on = vport.wrap_method('note_on'),
     note_off = vport.wrap_method('note_off'),
@@ -42,14 +48,15 @@ end
 --- constructor
 -- @tparam integer id : arbitrary numeric identifier
 -- @tparam string name : name
--- @tparam userdata dev : opaque pointer to device
+-- @tparam integer dev : opaque handle to device
 function Midi.new(id, name, dev)
   local d = setmetatable({}, Midi)
 
   d.id = id
   d.name = vport.get_unique_device_name(name, Midi.devices)
-  d.dev = dev    -- opaque pointer
-  d.event = nil  -- event callback
+  d.dev = dev    -- opaque handle
+  d.event = nil  -- event callback, receives (data, time) where time is the arrival time (see clock.get_system_time)
+  d.sysex = nil  -- system exclusive callback, receives each complete message as a string
   d.remove = nil -- device unplug callback
   d.port = nil
 
@@ -94,6 +101,36 @@ function Midi:send(data)
   end
 end
 
+--- schedule midi event for a future clock time.
+-- messages are emitted by a dedicated output thread,
+-- independent of when the calling coroutine resumes.
+-- @tparam number time : clock time in seconds (see clock.get_system_time)
+-- @param data
+-- @treturn boolean false if the output queue is full
+function Midi:send_at(time, data)
+  if data.type then
+    data = Midi.to_data(data)
+  end
+  return _norns.midi_send_at(self.dev, data, time)
+end
+
+--- schedule midi event for a future beat.
+-- the beat is resolved against the current clock source when it comes due.
+-- @tparam number beat : clock beat (see clock.get_beats)
+-- @param data
+-- @treturn boolean false if the output queue is full
+function Midi:send_at_beat(beat, data)
+  if data.type then
+    data = Midi.to_data(data)
+  end
+  return _norns.midi_send_at_beat(self.dev, data, beat)
+end
+
+--- discard all scheduled midi events for this device.
+function Midi:clear_scheduled()
+  _norns.midi_clear_scheduled(self.dev)
+end
+
 --- send midi note on event.
 -- @tparam integer note : note number
 -- @tparam integer vel : velocity
@@ -187,6 +224,63 @@ function Midi:clock_receive(enabled)
   _norns.midi_clock_receive(self.dev, enabled)
 end
 
+-- status bytes for message types accepted by Midi:filter()
+local filter_status = {
+  note_off = 0x80,
+  note_on = 0x90,
+  key_pressure = 0xa0,
+  cc = 0xb0,
+  program_change = 0xc0,
+  channel_pressure = 0xd0,
+  pitchbend = 0xe0,
+  sysex = 0xf0,
+  quarter_frame = 0xf1,
+  song_position = 0xf2,
+  song_select = 0xf3,
+  tune_request = 0xf6,
+  clock = 0xf8,
+  start = 0xfa,
+  continue = 0xfb,
+  stop = 0xfc,
+  active_sensing = 0xfe,
+  reset = 0xff,
+}
+
+--- drop incoming messages of a type before they reach lua.
+-- filtered clock messages still drive clock sync.
+-- @tparam string type : message type, eg "active_sensing", "clock", "key_pressure"
+-- @tparam[opt] table channels : for channel messages, the channels (1-16) to drop; all if omitted
+-- @tparam[opt] boolean enabled : pass false to let the type through again
+function Midi:filter(type, channels, enabled)
+  local status = filter_status[type]
+  if status == nil then
+    error('unknown midi message type: ' .. tostring(type))
+  end
+  local mask = 0
+  if enabled ~= false then
+    if channels == nil then
+      mask = 0xffff
+    else
+      for _, ch in ipairs(channels) do
+        mask = mask | (1 << (ch - 1))
+      end
+    end
+  end
+  _norns.midi_set_filter(self.dev, status, mask)
+end
+
+--- let all incoming messages through.
+function Midi:clear_filters()
+  _norns.midi_clear_filters(self.dev)
+end
+
+--- count of incoming messages delivered to lua and dropped by filters.
+-- @treturn table { delivered = n, filtered = n }
+function Midi:filter_stats()
+  local delivered, filtered = _norns.midi_filter_stats(self.dev)
+  return { delivered = delivered, filtered = filtered }
+end
+
 --- create device, returns object with handler and send.
 -- @tparam integer n : vport index
 function Midi.connect(n)
@@ -198,10 +292,14 @@ end
 function Midi.cleanup()
   for i = 1, 16 do
     Midi.vports[i].event = nil
+    Midi.vports[i].sysex = nil
   end
 
   for _, dev in pairs(Midi.devices) do
     dev.event = nil
+    dev.sysex = nil
+    dev:clear_scheduled()
+    dev:clear_filters()
   end
 
   Midi.add = function(dev) end
@@ -459,17 +557,17 @@ _norns.midi.remove = function(id)
 end
 
 -- handle a midi event.
-_norns.midi.event = function(id, data)
+_norns.midi.event = function(id, data, time)
   local d = Midi.devices[id]
 
   if d ~= nil then
     if d.event ~= nil then
-      d.event(data)
+      d.event(data, time)
     end
 
     if d.port then
       if Midi.vports[d.port].event then
-        Midi.vports[d.port].event(data)
+        Midi.vports[d.port].event(data, time)
       end
       -- hack = send all midi to menu for param-cc-map
       norns.menu_midi_event(data, d.port)
@@ -479,4 +577,28 @@ _norns.midi.event = function(id, data)
   end
 end
 
+-- handle a complete system exclusive message.
+-- `sysex` callbacks get the raw message string; `event` callbacks still get
+-- the whole message as one table of bytes.
+_norns.midi.sysex = function(id, msg, time)
+  local d = Midi.devices[id]
+
+  if d ~= nil then
+    if d.sysex ~= nil then
+      d.sysex(msg, time)
+    end
+
+    local vp = d.port and Midi.vports[d.port] or nil
+    if vp and vp.sysex then
+      vp.sysex(msg, time)
+    end
+
+    if d.event ~= nil or (vp and vp.event) then
+      _norns.midi.event(id, { string.byte(msg, 1, -1) }, time)
+    end
+  else
+    error('no entry for midi ' .. id)
+  end
+end
+
 return Midi
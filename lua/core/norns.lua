@@ -38,6 +38,7 @@ _norns.arc.key = function(id, n, s) end
 _norns.hid = {}
 _norns.hid.add = function(id, name, types, codes, dev) end
 _norns.hid.event = function(id, ev_type, ev_code, value) end
+_norns.hid.frame = function(id, frame) end
 
 -- midi callbacks (defined in midi.lua).
 _norns.midi = {}
@@ -130,8 +131,7 @@ norns.script = require 'core/script'
 norns.state = require 'core/state'
 norns.encoders = require 'core/encoders'
 
-_norns.enc = _norns.adc_rev() == 1 and norns.encoders.process or norns.encoders.process_with_accel
---_norns.enc = norns.encoders.process_with_accel
+_norns.enc = norns.encoders.process
 
 -- extend paths config table
 local p = _path
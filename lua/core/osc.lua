@@ -36,6 +36,24 @@ function OSC.send(to, path, args)
   end
 end
 
+--- forget cached destinations, so their addresses are resolved again.
+-- destinations are kept resolved between sends; use this when a host's address changes.
+-- @tparam table to : (optional) a {host, port} table; all destinations if nil
+function OSC.invalidate(to)
+  if to ~= nil then
+    _norns.osc_invalidate(to[1], to[2])
+  else
+    _norns.osc_invalidate()
+  end
+end
+
+--- static method to get counters for messages sent with OSC.send.
+-- @treturn table : sent, errors, hits, misses and evictions of the destination cache
+function OSC.send_stats()
+  local sent, errors, hits, misses, evictions = _norns.osc_send_stats()
+  return { sent = sent, errors = errors, hits = hits, misses = misses, evictions = evictions }
+end
+
 -- static method to send osc event directly to sclang.
 -- @tparam string path : osc message path
 -- @tparam string args : osc message args
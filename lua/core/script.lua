@@ -80,6 +80,7 @@ Script.clear = function()
 
   -- clear engine
   engine.name = nil
+  engine.set_bundling(false)
 
   -- clear softcut
   softcut.reset()
@@ -76,12 +76,11 @@ function Buffer:led_level_all(l)
 end
 
 function Buffer:render(grid)
-  -- TODO: use map when it's available
+  local rows = {}
   for row = 1, self.height do
-    for col = 1, self.width do
-      grid:led(col, row, self.grid[row][col])
-    end
+    rows[row] = string.char(table.unpack(self.grid[row]))
   end
+  grid:region(1, 1, self.width, self.height, table.concat(rows))
 end
 
 function Buffer:print()
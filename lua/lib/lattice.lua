@@ -14,6 +14,7 @@ local Lattice, Sprocket = {}, {}
 -- @tparam[opt] table args optional named attributes are:
 -- - "auto" (boolean) turn off "auto" pulses from the norns clock, defaults to true
 -- - "ppqn" (number) the number of pulses per quarter cycle of this superclock, defaults to 96
+-- - "native" (boolean) pulse "auto" lattices from the native clock engine rather than a lua coroutine, defaults to true
 -- @treturn table a new lattice
 function Lattice:new(args)
   local l = setmetatable({}, { __index = Lattice })
@@ -23,16 +24,27 @@ function Lattice:new(args)
   l.enabled = false
   l.transport = 0
   l.superclock_id = nil
+  l.native_id = nil
   l.sprocket_id_counter = 100
   l.sprockets = {}
   l.sprocket_ordering = { {}, {}, {}, {}, {} }
+  if l.auto and args.native ~= false then
+    -- sprockets are pulsed in C and lua only runs when one of them fires;
+    -- falls back to the lua superclock if no native lattice is available
+    l.native_id = _norns.clock_lattice_new(l.ppqn)
+    if l.native_id ~= nil then
+      clock.lattices[l.native_id] = l
+    end
+  end
   return l
 end
 
 --- start running the lattice
 function Lattice:start()
   self.enabled = true
-  if self.auto and self.superclock_id == nil then
+  if self.native_id ~= nil then
+    _norns.clock_lattice_start(self.native_id)
+  elseif self.auto and self.superclock_id == nil then
     self.superclock_id = clock.run(self.auto_pulse, self)
   end
 end
@@ -50,6 +62,9 @@ function Lattice:reset()
     (1 - sprocket.delay)                                                      -- "4" because in music a "quarter note" == "1/4"
     sprocket.downbeat = false
   end
+  if self.native_id ~= nil then
+    _norns.clock_lattice_reset(self.native_id)
+  end
   self.transport = 0
   params:set("clock_reset", 1)
 end
@@ -63,11 +78,18 @@ end
 --- stop the lattice
 function Lattice:stop()
   self.enabled = false
+  if self.native_id ~= nil then
+    _norns.clock_lattice_stop(self.native_id)
+  end
 end
 
 --- toggle the lattice
 function Lattice:toggle()
-  self.enabled = not self.enabled
+  if self.native_id ~= nil then
+    if self.enabled then self:stop() else self:start() end
+  else
+    self.enabled = not self.enabled
+  end
 end
 
 --- destroy the lattice
@@ -76,6 +98,11 @@ function Lattice:destroy()
   if self.superclock_id ~= nil then
     clock.cancel(self.superclock_id)
   end
+  if self.native_id ~= nil then
+    _norns.clock_lattice_free(self.native_id)
+    clock.lattices[self.native_id] = nil
+    self.native_id = nil
+  end
   self.sprockets = {}
   self.sprocket_ordering = {}
 end
@@ -131,6 +158,26 @@ function Lattice:pulse()
   end
 end
 
+--- "private" method called from the clock engine when a sprocket of a native lattice fires
+-- @tparam number id the sprocket id
+-- @tparam number transport the lattice transport at the firing pulse
+-- @tparam number phase the sprocket's phase after firing
+function Lattice:fire(id, transport, phase)
+  -- the event may have been queued before the lattice or sprocket was stopped
+  if not self.enabled then return end
+  local sprocket = self.sprockets[id]
+  self.transport = transport
+  if sprocket ~= nil and sprocket.enabled then
+    sprocket.phase = phase
+    if sprocket.delay_new ~= nil then
+      sprocket.delay = sprocket.delay_new
+      sprocket.delay_new = nil
+    end
+    sprocket.action(transport)
+    sprocket.downbeat = not sprocket.downbeat
+  end
+end
+
 --- factory method to add a new sprocket to this lattice
 -- @tparam[opt] table args optional named attributes are:
 --
@@ -152,9 +199,16 @@ function Lattice:new_sprocket(args)
   args.phase = args.division * self.ppqn * 4 -- "4" because in music a "quarter note" == "1/4"
   args.swing = args.swing == nil and 50 or util.clamp(args.swing, 0, 100)
   args.delay = args.delay == nil and 0 or util.clamp(args.delay, 0, 1)
+  args.lattice = self
   local sprocket = Sprocket:new(args)
   self.sprockets[self.sprocket_id_counter] = sprocket
   self:order_sprockets()
+  if self.native_id ~= nil then
+    if not _norns.clock_lattice_add_sprocket(self.native_id, sprocket.id, sprocket.order, sprocket.division,
+        sprocket.swing, sprocket.delay, sprocket.enabled) then
+      print("lattice: unable to add sprocket " .. sprocket.id .. " to native lattice")
+    end
+  end
   return sprocket
 end
 
@@ -181,6 +235,7 @@ end
 function Sprocket:new(args)
   local p = setmetatable({}, { __index = Sprocket })
   p.id = args.id
+  p.lattice = args.lattice
   p.order = args.order
   p.division = args.division
   p.action = args.action
@@ -193,31 +248,50 @@ function Sprocket:new(args)
   return p
 end
 
+--- "private" method to push sprocket state to a native lattice
+function Sprocket:update()
+  local lattice = self.lattice
+  if lattice ~= nil and lattice.native_id ~= nil then
+    _norns.clock_lattice_set_sprocket(lattice.native_id, self.id, self.enabled, self.division, self.swing)
+  end
+end
+
 --- start the sprocket
 function Sprocket:start()
   self.enabled = true
+  self:update()
 end
 
 --- stop the sprocket
 function Sprocket:stop()
   self.enabled = false
+  self:update()
 end
 
 --- toggle the sprocket
 function Sprocket:toggle()
   self.enabled = not self.enabled
+  self:update()
 end
 
 --- flag the sprocket to be destroyed
 function Sprocket:destroy()
   self.enabled = false
   self.flag = true
+  local lattice = self.lattice
+  if lattice ~= nil and lattice.native_id ~= nil then
+    -- native lattices are not pulsed from lua, so remove it right away
+    _norns.clock_lattice_remove_sprocket(lattice.native_id, self.id)
+    lattice.sprockets[self.id] = nil
+    lattice:order_sprockets()
+  end
 end
 
 --- set the division of the sprocket
 -- @tparam number n the division of the sprocket
 function Sprocket:set_division(n)
   self.division = n
+  self:update()
 end
 
 --- set the action for this sprocket
@@ -230,12 +304,17 @@ end
 -- @param swing number the swing value 0-100%
 function Sprocket:set_swing(swing)
   self.swing = util.clamp(swing, 0, 100)
+  self:update()
 end
 
 --- set the delay for this sprocket
 -- @param delay fraction of the time between beats to delay (0-1)
 function Sprocket:set_delay(delay)
   self.delay_new = util.clamp(delay, 0, 1)
+  local lattice = self.lattice
+  if lattice ~= nil and lattice.native_id ~= nil then
+    _norns.clock_lattice_set_sprocket_delay(lattice.native_id, self.id, self.delay_new)
+  end
 end
 
 return Lattice
@@ -1,5 +1,6 @@
 #define _POSIX_C_SOURCE 200809L
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,6 +14,7 @@ struct args {
     char remote_port[ARG_BUF_SIZE];
     char crone_port[ARG_BUF_SIZE];
     char framebuffer[ARG_BUF_SIZE];
+    bool crone_shm;
 };
 
 static struct args a = {
@@ -21,11 +23,12 @@ static struct args a = {
     .crone_port = "9999",
     .remote_port = "10111",
     .framebuffer = "/dev/fb0",
+    .crone_shm = true,
 };
 
 int args_parse(int argc, char **argv) {
     int opt;
-    while ((opt = getopt(argc, argv, "o:e:l:c:f:h")) != -1) {
+    while ((opt = getopt(argc, argv, "o:e:l:c:f:uh")) != -1) {
         switch (opt) {
         case 'l':
             strncpy(a.loc_port, optarg, ARG_BUF_SIZE - 1);
@@ -39,6 +42,9 @@ int args_parse(int argc, char **argv) {
         case 'c':
             strncpy(a.crone_port, optarg, ARG_BUF_SIZE - 1);
             break;
+        case 'u':
+            a.crone_shm = false;
+            break;
         case '?':
         case 'h':
         default:
@@ -46,6 +52,7 @@ int args_parse(int argc, char **argv) {
             fprintf(stdout, "-l   override OSC local port [default %s]\n", a.loc_port);
             fprintf(stdout, "-e   override OSC ext port [default %s]\n", a.ext_port);
             fprintf(stdout, "-c   override crone port [default %s]\n", a.crone_port);
+            fprintf(stdout, "-u   talk to crone over UDP only, without the shared-memory link\n");
             exit(1);
             ;
         }
@@ -68,3 +75,7 @@ const char *args_remote_port(void) {
 const char *args_crone_port(void) {
     return a.crone_port;
 }
+
+bool args_crone_shm(void) {
+    return a.crone_shm;
+}
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <stdbool.h>
+
 extern int args_parse(int argc, char **argv);
 
 extern const char *args_local_port(void);
 extern const char *args_ext_port(void);
 extern const char *args_remote_port(void);
 extern const char *args_crone_port(void);
+// use the shared-memory link to crone when available
+extern bool args_crone_shm(void);
 extern const char *args_monome_path(void);
@@ -98,12 +98,14 @@ double clock_get_reference_tempo(clock_reference_t *reference) {
 }
 
 void clock_update_source_reference(clock_reference_t *reference, double beat, double beat_duration) {
-    pthread_mutex_lock(&(reference->lock));
+    clock_update_source_reference_at(reference, beat, beat_duration, clock_get_system_time());
+}
 
-    double current_time = clock_get_system_time();
+void clock_update_source_reference_at(clock_reference_t *reference, double beat, double beat_duration, double time) {
+    pthread_mutex_lock(&(reference->lock));
 
     reference->beat_duration = beat_duration;
-    reference->last_beat_time = current_time;
+    reference->last_beat_time = time;
     reference->beat = beat;
 
     pthread_mutex_unlock(&(reference->lock));
@@ -21,6 +21,8 @@ void clock_init();
 void clock_reference_init(clock_reference_t *reference);
 void clock_deinit();
 void clock_update_source_reference(clock_reference_t *reference, double beats, double beat_duration);
+// as above, for a beat position observed at `time` (system time) rather than now
+void clock_update_source_reference_at(clock_reference_t *reference, double beats, double beat_duration, double time);
 double clock_get_reference_beat(clock_reference_t *reference);
 double clock_get_reference_tempo(clock_reference_t *reference);
 void clock_start_from_source(clock_source_t source);
@@ -0,0 +1,297 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../clock.h"
+#include "../events.h"
+
+#include "clock_lattice.h"
+
+// a lattice pulses its sprockets every 1/ppqn beat, as lib/lattice does from lua.
+// sprockets are kept sorted by (order, id) so firing order matches the lua implementation.
+
+typedef struct {
+    int id;
+    int order;
+    bool enabled;
+    bool downbeat;
+    double division;
+    double swing;
+    double delay;
+    double delay_new;
+    bool delay_changed;
+    double phase;
+} clock_lattice_sprocket_t;
+
+typedef struct {
+    bool allocated;
+    bool enabled;
+    bool start_pending;
+    int ppqn;
+    uint32_t transport;
+    int64_t last_pulse;
+    int num_sprockets;
+    clock_lattice_sprocket_t sprockets[CLOCK_LATTICE_MAX_SPROCKETS];
+} clock_lattice_t;
+
+static clock_lattice_t clock_lattices[CLOCK_LATTICE_MAX_LATTICES];
+static pthread_mutex_t clock_lattice_lock;
+
+static void clock_lattice_post_event(int lattice, int sprocket_id, uint32_t transport, double phase) {
+    union event_data *ev = event_data_new(EVENT_CLOCK_LATTICE);
+    ev->clock_lattice.lattice = lattice;
+    ev->clock_lattice.sprocket = sprocket_id;
+    ev->clock_lattice.transport = transport;
+    ev->clock_lattice.phase = phase;
+    event_post(ev);
+}
+
+static clock_lattice_t *clock_lattice_get(int lattice) {
+    if (lattice < 0 || lattice >= CLOCK_LATTICE_MAX_LATTICES || !clock_lattices[lattice].allocated) {
+        return NULL;
+    }
+    return &clock_lattices[lattice];
+}
+
+static clock_lattice_sprocket_t *clock_lattice_find_sprocket(clock_lattice_t *l, int sprocket_id) {
+    for (int i = 0; i < l->num_sprockets; i++) {
+        if (l->sprockets[i].id == sprocket_id) {
+            return &l->sprockets[i];
+        }
+    }
+    return NULL;
+}
+
+static inline double clock_lattice_pulses_per_cycle(clock_lattice_t *l) {
+    // "4" because in music a "quarter note" == "1/4"
+    return l->ppqn * 4.0;
+}
+
+static void clock_lattice_sprocket_rewind(clock_lattice_t *l, clock_lattice_sprocket_t *s) {
+    s->phase = s->division * clock_lattice_pulses_per_cycle(l) * (1 - s->delay);
+    s->downbeat = false;
+}
+
+// advance a lattice by one pulse. call with lock held.
+static void clock_lattice_pulse(int lattice, clock_lattice_t *l) {
+    double ppc = clock_lattice_pulses_per_cycle(l);
+
+    for (int i = 0; i < l->num_sprockets; i++) {
+        clock_lattice_sprocket_t *s = &l->sprockets[i];
+        if (!s->enabled) {
+            continue;
+        }
+
+        s->phase += 1;
+        double swing_val = s->downbeat ? 2 * s->swing / 100 : 1;
+        if (s->phase > s->division * ppc * swing_val) {
+            s->phase -= s->division * ppc;
+            if (s->delay_changed) {
+                s->phase -= (s->division * ppc) * (1 - (s->delay - s->delay_new));
+                s->delay = s->delay_new;
+                s->delay_changed = false;
+            }
+            clock_lattice_post_event(lattice, s->id, l->transport, s->phase);
+            s->downbeat = !s->downbeat;
+        }
+    }
+
+    l->transport++;
+}
+
+//-----------------------------
+//--- extern function definitions
+
+void clock_lattice_init() {
+    pthread_mutex_init(&clock_lattice_lock, NULL);
+    memset(clock_lattices, 0, sizeof(clock_lattices));
+}
+
+int clock_lattice_new(int ppqn) {
+    int result = -1;
+
+    if (ppqn <= 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&clock_lattice_lock);
+    for (int i = 0; i < CLOCK_LATTICE_MAX_LATTICES; i++) {
+        clock_lattice_t *l = &clock_lattices[i];
+        if (!l->allocated) {
+            memset(l, 0, sizeof(clock_lattice_t));
+            l->allocated = true;
+            l->ppqn = ppqn;
+            result = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&clock_lattice_lock);
+
+    if (result < 0) {
+        fprintf(stderr, "clock_lattice: no free lattices (max %d)\n", CLOCK_LATTICE_MAX_LATTICES);
+    }
+    return result;
+}
+
+void clock_lattice_free(int lattice) {
+    pthread_mutex_lock(&clock_lattice_lock);
+    clock_lattice_t *l = clock_lattice_get(lattice);
+    if (l != NULL) {
+        l->allocated = false;
+        l->enabled = false;
+    }
+    pthread_mutex_unlock(&clock_lattice_lock);
+}
+
+void clock_lattice_free_all() {
+    pthread_mutex_lock(&clock_lattice_lock);
+    for (int i = 0; i < CLOCK_LATTICE_MAX_LATTICES; i++) {
+        clock_lattices[i].allocated = false;
+        clock_lattices[i].enabled = false;
+    }
+    pthread_mutex_unlock(&clock_lattice_lock);
+}
+
+void clock_lattice_start(int lattice) {
+    pthread_mutex_lock(&clock_lattice_lock);
+    clock_lattice_t *l = clock_lattice_get(lattice);
+    if (l != NULL && !l->enabled) {
+        l->enabled = true;
+        // first pulse is emitted by the next tick, as from a freshly started coroutine
+        l->start_pending = true;
+    }
+    pthread_mutex_unlock(&clock_lattice_lock);
+}
+
+void clock_lattice_stop(int lattice) {
+    pthread_mutex_lock(&clock_lattice_lock);
+    clock_lattice_t *l = clock_lattice_get(lattice);
+    if (l != NULL) {
+        l->enabled = false;
+    }
+    pthread_mutex_unlock(&clock_lattice_lock);
+}
+
+void clock_lattice_reset(int lattice) {
+    pthread_mutex_lock(&clock_lattice_lock);
+    clock_lattice_t *l = clock_lattice_get(lattice);
+    if (l != NULL) {
+        l->enabled = false;
+        l->transport = 0;
+        for (int i = 0; i < l->num_sprockets; i++) {
+            clock_lattice_sprocket_rewind(l, &l->sprockets[i]);
+        }
+    }
+    pthread_mutex_unlock(&clock_lattice_lock);
+}
+
+bool clock_lattice_add_sprocket(int lattice, int sprocket_id, int order, double division, double swing,
+                                double delay, bool enabled) {
+    bool result = false;
+
+    pthread_mutex_lock(&clock_lattice_lock);
+    clock_lattice_t *l = clock_lattice_get(lattice);
+    if (l != NULL && l->num_sprockets < CLOCK_LATTICE_MAX_SPROCKETS &&
+        clock_lattice_find_sprocket(l, sprocket_id) == NULL) {
+        // insertion sort by (order, id)
+        int pos = l->num_sprockets;
+        while (pos > 0) {
+            clock_lattice_sprocket_t *prev = &l->sprockets[pos - 1];
+            if (prev->order < order || (prev->order == order && prev->id < sprocket_id)) {
+                break;
+            }
+            l->sprockets[pos] = *prev;
+            pos--;
+        }
+
+        clock_lattice_sprocket_t *s = &l->sprockets[pos];
+        memset(s, 0, sizeof(clock_lattice_sprocket_t));
+        s->id = sprocket_id;
+        s->order = order;
+        s->enabled = enabled;
+        s->division = division;
+        s->swing = swing;
+        s->delay = delay;
+        clock_lattice_sprocket_rewind(l, s);
+
+        l->num_sprockets++;
+        result = true;
+    }
+    pthread_mutex_unlock(&clock_lattice_lock);
+
+    return result;
+}
+
+void clock_lattice_remove_sprocket(int lattice, int sprocket_id) {
+    pthread_mutex_lock(&clock_lattice_lock);
+    clock_lattice_t *l = clock_lattice_get(lattice);
+    if (l != NULL) {
+        clock_lattice_sprocket_t *s = clock_lattice_find_sprocket(l, sprocket_id);
+        if (s != NULL) {
+            int idx = s - l->sprockets;
+            memmove(s, s + 1, (l->num_sprockets - idx - 1) * sizeof(clock_lattice_sprocket_t));
+            l->num_sprockets--;
+        }
+    }
+    pthread_mutex_unlock(&clock_lattice_lock);
+}
+
+void clock_lattice_set_sprocket(int lattice, int sprocket_id, bool enabled, double division, double swing) {
+    pthread_mutex_lock(&clock_lattice_lock);
+    clock_lattice_t *l = clock_lattice_get(lattice);
+    clock_lattice_sprocket_t *s = l != NULL ? clock_lattice_find_sprocket(l, sprocket_id) : NULL;
+    if (s != NULL) {
+        s->enabled = enabled;
+        s->division = division;
+        s->swing = swing;
+    }
+    pthread_mutex_unlock(&clock_lattice_lock);
+}
+
+void clock_lattice_set_sprocket_delay(int lattice, int sprocket_id, double delay) {
+    pthread_mutex_lock(&clock_lattice_lock);
+    clock_lattice_t *l = clock_lattice_get(lattice);
+    clock_lattice_sprocket_t *s = l != NULL ? clock_lattice_find_sprocket(l, sprocket_id) : NULL;
+    if (s != NULL) {
+        s->delay_new = delay;
+        s->delay_changed = true;
+    }
+    pthread_mutex_unlock(&clock_lattice_lock);
+}
+
+void clock_lattice_tick(double beat) {
+    pthread_mutex_lock(&clock_lattice_lock);
+
+    for (int i = 0; i < CLOCK_LATTICE_MAX_LATTICES; i++) {
+        clock_lattice_t *l = &clock_lattices[i];
+        if (!l->allocated || !l->enabled) {
+            continue;
+        }
+
+        // the last pulse boundary strictly behind the current beat,
+        // matching the comparison used for clock.sync()
+        int64_t pulse = (int64_t)ceil(beat * l->ppqn) - 1;
+
+        if (l->start_pending) {
+            l->start_pending = false;
+            l->last_pulse = pulse;
+            clock_lattice_pulse(i, l);
+            continue;
+        }
+
+        if (pulse < l->last_pulse || pulse - l->last_pulse > l->ppqn) {
+            // clock restarted or jumped; pulse once and follow from here
+            l->last_pulse = pulse - 1;
+        }
+
+        while (l->last_pulse < pulse) {
+            l->last_pulse++;
+            clock_lattice_pulse(i, l);
+        }
+    }
+
+    pthread_mutex_unlock(&clock_lattice_lock);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+
+#define CLOCK_LATTICE_MAX_LATTICES 16
+#define CLOCK_LATTICE_MAX_SPROCKETS 64
+
+void clock_lattice_init();
+// create a lattice pulsing at ppqn; returns lattice index, or -1 if none are free
+int clock_lattice_new(int ppqn);
+void clock_lattice_free(int lattice);
+void clock_lattice_free_all();
+void clock_lattice_start(int lattice);
+void clock_lattice_stop(int lattice);
+// stop, rewind transport and restore all sprocket phases
+void clock_lattice_reset(int lattice);
+
+// sprocket ids are chosen by the caller and must be unique within a lattice
+bool clock_lattice_add_sprocket(int lattice, int sprocket_id, int order, double division, double swing,
+                                double delay, bool enabled);
+void clock_lattice_remove_sprocket(int lattice, int sprocket_id);
+void clock_lattice_set_sprocket(int lattice, int sprocket_id, bool enabled, double division, double swing);
+// takes effect on the next firing of the sprocket
+void clock_lattice_set_sprocket_delay(int lattice, int sprocket_id, double delay);
+
+// advance all running lattices to the given clock beat, posting an event for each sprocket that fires
+void clock_lattice_tick(double beat);
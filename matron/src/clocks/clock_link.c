@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -10,140 +11,260 @@
 
 #include "clock.h"
 
+// pending requests from lua; the link thread drains these in order
+#define CLOCK_LINK_COMMAND_QUEUE_SIZE 32
+// while in a session, the beat reference is refreshed at this interval (in seconds).
+// tempo and start/stop changes from peers are picked up immediately via link callbacks.
+#define CLOCK_LINK_REFERENCE_INTERVAL 0.02
+
+typedef enum {
+    CLOCK_LINK_COMMAND_ENABLE,
+    CLOCK_LINK_COMMAND_SET_QUANTUM,
+    CLOCK_LINK_COMMAND_SET_TEMPO,
+    CLOCK_LINK_COMMAND_TRANSPORT_START,
+    CLOCK_LINK_COMMAND_TRANSPORT_STOP,
+    CLOCK_LINK_COMMAND_START_STOP_SYNC,
+} clock_link_command_type_t;
+
+typedef struct {
+    clock_link_command_type_t type;
+    double value;
+} clock_link_command_t;
+
 static pthread_t clock_link_thread;
 
 static struct clock_link_shared_data_t {
+    clock_link_command_t commands[CLOCK_LINK_COMMAND_QUEUE_SIZE];
+    unsigned int head;
+    unsigned int count;
+    bool session_changed;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} clock_link_shared_data;
+
+// owned by the link thread
+static struct clock_link_state_t {
     double quantum;
-    double requested_tempo;
     bool playing;
     bool enabled;
     bool start_stop_sync;
-    bool transport_start;
-    bool transport_stop;
-    pthread_mutex_t lock;
-} clock_link_shared_data;
+} clock_link_state;
 
 static clock_reference_t clock_link_reference;
 
+static void clock_link_post_command(clock_link_command_type_t type, double value) {
+    struct clock_link_shared_data_t *shared = &clock_link_shared_data;
+
+    pthread_mutex_lock(&shared->lock);
+
+    if (shared->count < CLOCK_LINK_COMMAND_QUEUE_SIZE) {
+        unsigned int tail = (shared->head + shared->count) % CLOCK_LINK_COMMAND_QUEUE_SIZE;
+        shared->commands[tail].type = type;
+        shared->commands[tail].value = value;
+        shared->count++;
+        pthread_cond_signal(&shared->cond);
+    } else {
+        fprintf(stderr, "clock_link: command queue full, dropping command %d\n", type);
+    }
+
+    pthread_mutex_unlock(&shared->lock);
+}
+
+// called from link's own threads when peers change the session
+static void clock_link_session_callback(void) {
+    pthread_mutex_lock(&clock_link_shared_data.lock);
+    clock_link_shared_data.session_changed = true;
+    pthread_cond_signal(&clock_link_shared_data.cond);
+    pthread_mutex_unlock(&clock_link_shared_data.lock);
+}
+
+static void clock_link_tempo_callback(double tempo, void *context) {
+    (void)tempo;
+    (void)context;
+    clock_link_session_callback();
+}
+
+static void clock_link_start_stop_callback(bool is_playing, void *context) {
+    (void)is_playing;
+    (void)context;
+    clock_link_session_callback();
+}
+
+static void clock_link_deadline(struct timespec *ts, double seconds) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    long nsec = ts->tv_nsec + (long)(seconds * 1000000000);
+    ts->tv_sec += nsec / 1000000000;
+    ts->tv_nsec = nsec % 1000000000;
+}
+
+// block until there is work to do, then move pending commands into `commands`.
+// returns the number of commands taken.
+static unsigned int clock_link_wait(clock_link_command_t *commands) {
+    struct timespec deadline;
+    unsigned int n = 0;
+
+    clock_link_deadline(&deadline, CLOCK_LINK_REFERENCE_INTERVAL);
+
+    pthread_mutex_lock(&clock_link_shared_data.lock);
+
+    while (clock_link_shared_data.count == 0 && !clock_link_shared_data.session_changed) {
+        if (!clock_link_state.enabled) {
+            // outside of a session there is nothing to follow
+            pthread_cond_wait(&clock_link_shared_data.cond, &clock_link_shared_data.lock);
+        } else if (pthread_cond_timedwait(&clock_link_shared_data.cond, &clock_link_shared_data.lock, &deadline) ==
+                   ETIMEDOUT) {
+            break;
+        }
+    }
+
+    while (clock_link_shared_data.count > 0) {
+        commands[n++] = clock_link_shared_data.commands[clock_link_shared_data.head];
+        clock_link_shared_data.head = (clock_link_shared_data.head + 1) % CLOCK_LINK_COMMAND_QUEUE_SIZE;
+        clock_link_shared_data.count--;
+    }
+    clock_link_shared_data.session_changed = false;
+
+    pthread_mutex_unlock(&clock_link_shared_data.lock);
+
+    return n;
+}
+
 static void *clock_link_run(void *p) {
     (void)p;
 
     abl_link link;
     abl_link_session_state state;
+    clock_link_command_t commands[CLOCK_LINK_COMMAND_QUEUE_SIZE];
 
     link = abl_link_create(120);
     state = abl_link_create_session_state();
 
-    while (true) {
-        if (pthread_mutex_trylock(&clock_link_shared_data.lock) == 0) {
-            abl_link_capture_app_session_state(link, state);
-
-            uint64_t micros = abl_link_clock_micros(link);
-            double link_tempo = abl_link_tempo(state);
-            bool link_playing = abl_link_is_playing(state);
+    abl_link_set_tempo_callback(link, &clock_link_tempo_callback, NULL);
+    abl_link_set_start_stop_callback(link, &clock_link_start_stop_callback, NULL);
 
-            if (clock_link_shared_data.transport_start) {
+    while (true) {
+        unsigned int n = clock_link_wait(commands);
+        bool commit = false;
+
+        abl_link_capture_app_session_state(link, state);
+
+        uint64_t micros = abl_link_clock_micros(link);
+
+        for (unsigned int i = 0; i < n; i++) {
+            switch (commands[i].type) {
+            case CLOCK_LINK_COMMAND_ENABLE:
+                clock_link_state.enabled = commands[i].value != 0;
+                abl_link_enable(link, clock_link_state.enabled);
+                break;
+            case CLOCK_LINK_COMMAND_SET_QUANTUM:
+                clock_link_state.quantum = commands[i].value;
+                break;
+            case CLOCK_LINK_COMMAND_SET_TEMPO:
+                abl_link_set_tempo(state, commands[i].value, micros);
+                commit = true;
+                break;
+            case CLOCK_LINK_COMMAND_TRANSPORT_START:
                 abl_link_set_is_playing(state, true, micros);
-                abl_link_commit_app_session_state(link, state);
-                clock_link_shared_data.transport_start = false;
-            }
-
-            if (clock_link_shared_data.transport_stop) {
+                commit = true;
+                break;
+            case CLOCK_LINK_COMMAND_TRANSPORT_STOP:
                 abl_link_set_is_playing(state, false, micros);
-                abl_link_commit_app_session_state(link, state);
-                clock_link_shared_data.transport_stop = false;
+                commit = true;
+                break;
+            case CLOCK_LINK_COMMAND_START_STOP_SYNC:
+                clock_link_state.start_stop_sync = commands[i].value != 0;
+                abl_link_enable_start_stop_sync(link, clock_link_state.start_stop_sync);
+                break;
             }
+        }
 
-            if (clock_link_shared_data.start_stop_sync) {
-                if (!clock_link_shared_data.playing && link_playing) {
-                    abl_link_request_beat_at_start_playing_time(state, 0, clock_link_shared_data.quantum);
-                    clock_link_shared_data.playing = true;
-
-                    // this will also reschedule pending sync events to beat 0
-                    clock_start_from_source(CLOCK_SOURCE_LINK);
-                    abl_link_commit_app_session_state(link, state);
-                } else if (clock_link_shared_data.playing && !link_playing) {
-                    clock_link_shared_data.playing = false;
-                    clock_stop_from_source(CLOCK_SOURCE_LINK);
-                }
-            }
+        if (commit) {
+            abl_link_commit_app_session_state(link, state);
+            commit = false;
+        }
+
+        double link_tempo = abl_link_tempo(state);
+        bool link_playing = abl_link_is_playing(state);
 
-            double link_beat = abl_link_beat_at_time(state, micros, clock_link_shared_data.quantum);
-            clock_update_source_reference(&clock_link_reference, link_beat, 60.0f / link_tempo);
+        if (clock_link_state.start_stop_sync) {
+            if (!clock_link_state.playing && link_playing) {
+                abl_link_request_beat_at_start_playing_time(state, 0, clock_link_state.quantum);
+                clock_link_state.playing = true;
 
-            if (clock_link_shared_data.requested_tempo > 0) {
-                abl_link_set_tempo(state, clock_link_shared_data.requested_tempo, micros);
-                abl_link_commit_app_session_state(link, state);
-                clock_link_shared_data.requested_tempo = 0;
+                // this will also reschedule pending sync events to beat 0
+                clock_start_from_source(CLOCK_SOURCE_LINK);
+                commit = true;
+            } else if (clock_link_state.playing && !link_playing) {
+                clock_link_state.playing = false;
+                clock_stop_from_source(CLOCK_SOURCE_LINK);
             }
+        }
 
-            abl_link_enable(link, clock_link_shared_data.enabled);
-            abl_link_enable_start_stop_sync(link, clock_link_shared_data.start_stop_sync);
+        double link_beat = abl_link_beat_at_time(state, micros, clock_link_state.quantum);
+        clock_update_source_reference(&clock_link_reference, link_beat, 60.0f / link_tempo);
 
-            pthread_mutex_unlock(&clock_link_shared_data.lock);
+        if (commit) {
+            abl_link_commit_app_session_state(link, state);
         }
-
-        usleep(1000000 / 100);
     }
 
     return NULL;
 }
 
 void clock_link_init() {
+    pthread_condattr_t cond_attr;
+
     clock_reference_init(&clock_link_reference);
+
+    pthread_mutex_init(&clock_link_shared_data.lock, NULL);
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&clock_link_shared_data.cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    clock_link_shared_data.head = 0;
+    clock_link_shared_data.count = 0;
+    clock_link_shared_data.session_changed = false;
 }
 
 void clock_link_start() {
     pthread_attr_t attr;
     pthread_attr_init(&attr);
 
-    clock_link_shared_data.quantum = 4;
-    clock_link_shared_data.requested_tempo = 0;
-    clock_link_shared_data.enabled = false;
+    clock_link_state.quantum = 4;
+    clock_link_state.playing = false;
+    clock_link_state.enabled = false;
+    clock_link_state.start_stop_sync = false;
 
     pthread_create(&clock_link_thread, &attr, &clock_link_run, NULL);
 }
 
 void clock_link_join_session() {
-    pthread_mutex_lock(&clock_link_shared_data.lock);
-    clock_link_shared_data.enabled = true;
-    pthread_mutex_unlock(&clock_link_shared_data.lock);
+    clock_link_post_command(CLOCK_LINK_COMMAND_ENABLE, 1);
 }
 
 void clock_link_leave_session() {
-    pthread_mutex_lock(&clock_link_shared_data.lock);
-    clock_link_shared_data.enabled = false;
-    pthread_mutex_unlock(&clock_link_shared_data.lock);
+    clock_link_post_command(CLOCK_LINK_COMMAND_ENABLE, 0);
 }
 
 void clock_link_set_quantum(double quantum) {
-    pthread_mutex_lock(&clock_link_shared_data.lock);
-    clock_link_shared_data.quantum = quantum;
-    pthread_mutex_unlock(&clock_link_shared_data.lock);
+    clock_link_post_command(CLOCK_LINK_COMMAND_SET_QUANTUM, quantum);
 }
 
 void clock_link_set_tempo(double tempo) {
-    pthread_mutex_lock(&clock_link_shared_data.lock);
-    clock_link_shared_data.requested_tempo = tempo;
-    pthread_mutex_unlock(&clock_link_shared_data.lock);
+    clock_link_post_command(CLOCK_LINK_COMMAND_SET_TEMPO, tempo);
 }
 
 void clock_link_set_transport_stop() {
-    pthread_mutex_lock(&clock_link_shared_data.lock);
-    clock_link_shared_data.transport_stop = true;
-    pthread_mutex_unlock(&clock_link_shared_data.lock);
+    clock_link_post_command(CLOCK_LINK_COMMAND_TRANSPORT_STOP, 0);
 }
 
 void clock_link_set_transport_start() {
-    pthread_mutex_lock(&clock_link_shared_data.lock);
-    clock_link_shared_data.transport_start = true;
-    pthread_mutex_unlock(&clock_link_shared_data.lock);
+    clock_link_post_command(CLOCK_LINK_COMMAND_TRANSPORT_START, 0);
 }
 
 void clock_link_set_start_stop_sync(bool sync_enabled) {
-    pthread_mutex_lock(&clock_link_shared_data.lock);
-    clock_link_shared_data.start_stop_sync = sync_enabled;
-    pthread_mutex_unlock(&clock_link_shared_data.lock);
+    clock_link_post_command(CLOCK_LINK_COMMAND_START_STOP_SYNC, sync_enabled);
 }
 
 double clock_link_get_beat() {
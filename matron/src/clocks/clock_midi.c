@@ -24,9 +24,8 @@ void clock_midi_init() {
     clock_reference_init(&clock_midi_reference);
 }
 
-static void clock_midi_handle_clock() {
+static void clock_midi_handle_clock(double current_time) {
     double beat_duration;
-    double current_time = clock_get_system_time();
 
     if (clock_midi_last_tick_time_set == false) {
         clock_midi_last_tick_time_set = true;
@@ -53,7 +52,7 @@ static void clock_midi_handle_clock() {
             clock_midi_last_tick_time = current_time;
 
             double reference_beat = clock_midi_counter / 24.0;
-            clock_update_source_reference(&clock_midi_reference, reference_beat, mean_sum);
+            clock_update_source_reference_at(&clock_midi_reference, reference_beat, mean_sum, current_time);
 
             if (clock_midi_counter == 0) {
                 clock_start_from_source(CLOCK_SOURCE_MIDI);
@@ -70,13 +69,13 @@ static void clock_midi_handle_stop() {
     clock_stop_from_source(CLOCK_SOURCE_MIDI);
 }
 
-void clock_midi_handle_message(uint8_t message) {
+void clock_midi_handle_message(uint8_t message, double time) {
     switch (message) {
     case 0xfa:
         clock_midi_handle_start();
         break;
     case 0xf8:
-        clock_midi_handle_clock();
+        clock_midi_handle_clock(time);
         break;
     case 0xfc:
         clock_midi_handle_stop();
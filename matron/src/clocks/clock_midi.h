@@ -3,6 +3,7 @@
 #include <stdint.h>
 
 void clock_midi_init();
-void clock_midi_handle_message(uint8_t message);
+// `time` is the system time at which the message arrived
+void clock_midi_handle_message(uint8_t message, double time);
 double clock_midi_get_beat();
 double clock_midi_get_tempo();
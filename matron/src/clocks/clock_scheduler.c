@@ -8,6 +8,7 @@
 #include "../clock.h"
 #include "../events.h"
 
+#include "clock_lattice.h"
 #include "clock_scheduler.h"
 
 typedef enum {
@@ -107,6 +108,8 @@ static void *clock_scheduler_tick_thread_run(void *p) {
         }
 
         pthread_mutex_unlock(&clock_scheduler_events_lock);
+
+        clock_lattice_tick(clock_beat);
         usleep(1000);
     }
 
@@ -121,6 +124,7 @@ void clock_scheduler_init() {
         clock_scheduler_events[i].thread_id = -1;
     }
 
+    clock_lattice_init();
     clock_scheduler_start();
 }
 
@@ -0,0 +1,315 @@
+/*
+ * crone_shm.c
+ *
+ * shared-memory link to crone
+ *
+ * crone listens on an abstract unix socket named after its OSC port. on connection it hands
+ * over a memfd holding two rings (one each way) and an eventfd per ring for wakeups; the
+ * socket then stays open only so each side notices when the other goes away.
+ *
+ * a single thread connects (retrying while crone isn't up), drains the ring from crone into
+ * the oracle's handler, and tears the link down when crone exits.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "crone_shm.h"
+#include "shm_ring.h"
+
+// milliseconds between connection attempts
+#define CRONE_SHM_RETRY_MS 1000
+// how long to wait for crone to make room in a full ring: 50 tries 100us apart.
+// a crone that can't keep up for that long is stuck; its messages are dropped, as UDP would.
+#define CRONE_SHM_FULL_WAIT_US 100
+#define CRONE_SHM_FULL_TRIES 50
+// fds passed by crone: the shared memory, then the wakeups for each ring
+#define CRONE_SHM_NUM_FDS 3
+
+// layout of the shared memory; must match crone/src/ShmTransport.cpp
+struct shm_link {
+    struct shm_ring to_crone;
+    struct shm_ring to_matron;
+};
+
+static char socket_name[64];
+static crone_shm_handler_t handler;
+
+static pthread_t link_thread;
+static bool link_thread_running = false;
+static int stop_fd = -1;
+
+// guards the mapping and crone's wakeup fd against teardown while sending
+static pthread_mutex_t send_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct shm_link *link_mem = NULL;
+static int wake_crone_fd = -1;
+static int wake_matron_fd = -1;
+static atomic_bool connected = false;
+// messages dropped because crone let the ring fill up
+static atomic_uint dropped = 0;
+
+static socklen_t socket_address(struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    // abstract namespace: leading nul, no file to clean up
+    size_t len = strlen(socket_name);
+    memcpy(addr->sun_path + 1, socket_name, len);
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + len);
+}
+
+static int link_connect(void) {
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    struct sockaddr_un addr;
+    socklen_t addr_len = socket_address(&addr);
+    if (connect(sock, (struct sockaddr *)&addr, addr_len) < 0) {
+        close(sock);
+        return -1;
+    }
+    // don't hang if crone accepted but is busy serving another client
+    struct timeval tv = {.tv_sec = 1, .tv_usec = 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return sock;
+}
+
+// close whatever fds arrived with a handshake we can't use
+static void close_received_fds(struct msghdr *msg) {
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len < CMSG_LEN(0)) {
+            continue;
+        }
+        size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < n; ++i) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+            close(fd);
+        }
+    }
+}
+
+// receive the shared memory and wakeup fds, and map the rings
+static bool link_open(int sock) {
+    uint32_t version = 0;
+    struct iovec iov = {.iov_base = &version, .iov_len = sizeof(version)};
+    union {
+        char buf[CMSG_SPACE(CRONE_SHM_NUM_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+
+    ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if (n != sizeof(version)) {
+        fprintf(stderr, "crone_shm: no handshake from crone\n");
+        if (n >= 0) {
+            close_received_fds(&msg);
+        }
+        return false;
+    }
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(CRONE_SHM_NUM_FDS * sizeof(int)) || (msg.msg_flags & MSG_CTRUNC)) {
+        fprintf(stderr, "crone_shm: bad handshake from crone\n");
+        close_received_fds(&msg);
+        return false;
+    }
+    int fds[CRONE_SHM_NUM_FDS];
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    struct shm_link *mem = NULL;
+    if (version == SHM_RING_VERSION) {
+        mem = mmap(NULL, sizeof(struct shm_link), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+        if (mem == MAP_FAILED) {
+            fprintf(stderr, "crone_shm: mmap failed: %s\n", strerror(errno));
+            mem = NULL;
+        } else if (!shm_ring_valid(&mem->to_crone) || !shm_ring_valid(&mem->to_matron)) {
+            munmap(mem, sizeof(struct shm_link));
+            mem = NULL;
+        }
+    }
+    close(fds[0]);
+    if (mem == NULL) {
+        fprintf(stderr, "crone_shm: incompatible link (version %u), using UDP\n", version);
+        close(fds[1]);
+        close(fds[2]);
+        return false;
+    }
+
+    pthread_mutex_lock(&send_lock);
+    link_mem = mem;
+    wake_crone_fd = fds[1];
+    wake_matron_fd = fds[2];
+    atomic_store(&connected, true);
+    pthread_mutex_unlock(&send_lock);
+    fprintf(stderr, "crone_shm: connected\n");
+    return true;
+}
+
+static void link_close(void) {
+    pthread_mutex_lock(&send_lock);
+    atomic_store(&connected, false);
+    struct shm_link *mem = link_mem;
+    link_mem = NULL;
+    close(wake_crone_fd);
+    close(wake_matron_fd);
+    wake_crone_fd = -1;
+    wake_matron_fd = -1;
+    pthread_mutex_unlock(&send_lock);
+    munmap(mem, sizeof(struct shm_link));
+    fprintf(stderr, "crone_shm: disconnected\n");
+}
+
+static void link_drain(void) {
+    struct shm_ring *ring = &link_mem->to_matron;
+    const void *data;
+    size_t len;
+    while ((data = shm_ring_peek(ring, &len)) != NULL) {
+        handler((void *)data, len);
+        if (shm_ring_release(ring, len)) {
+            break;
+        }
+    }
+}
+
+// returns false when asked to stop
+static bool link_serve(int sock) {
+    struct pollfd fds[3] = {
+        {.fd = wake_matron_fd, .events = POLLIN},
+        {.fd = sock, .events = POLLIN},
+        {.fd = stop_fd, .events = POLLIN},
+    };
+    // crone may have written before the wakeup fd was being watched
+    link_drain();
+    for (;;) {
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return true;
+        }
+        if (fds[2].revents) {
+            return false;
+        }
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            if (read(wake_matron_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                return true;
+            }
+            link_drain();
+        }
+        if (fds[1].revents) {
+            // crone never sends on the socket after the handshake; anything here is a hangup
+            return true;
+        }
+    }
+}
+
+// wait for the retry interval; returns false when asked to stop
+static bool link_wait(void) {
+    struct pollfd pfd = {.fd = stop_fd, .events = POLLIN};
+    return poll(&pfd, 1, CRONE_SHM_RETRY_MS) == 0;
+}
+
+static void *link_loop(void *arg) {
+    (void)arg;
+    bool running = true;
+    while (running) {
+        int sock = link_connect();
+        if (sock >= 0) {
+            if (link_open(sock)) {
+                running = link_serve(sock);
+                link_close();
+            }
+            close(sock);
+        }
+        running = running && link_wait();
+    }
+    return NULL;
+}
+
+void crone_shm_init(const char *crone_port, crone_shm_handler_t h) {
+    handler = h;
+    snprintf(socket_name, sizeof(socket_name), "crone/%s", crone_port);
+    stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (stop_fd < 0) {
+        fprintf(stderr, "crone_shm: eventfd failed, using UDP only\n");
+        return;
+    }
+    if (pthread_create(&link_thread, NULL, link_loop, NULL) != 0) {
+        fprintf(stderr, "crone_shm: failed to start thread, using UDP only\n");
+        close(stop_fd);
+        stop_fd = -1;
+        return;
+    }
+    link_thread_running = true;
+}
+
+void crone_shm_deinit(void) {
+    if (!link_thread_running) {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) < 0) {
+        fprintf(stderr, "crone_shm: failed to signal thread\n");
+    }
+    pthread_join(link_thread, NULL);
+    link_thread_running = false;
+    close(stop_fd);
+    stop_fd = -1;
+}
+
+bool crone_shm_send(const char *path, lo_message msg) {
+    if (!atomic_load(&connected)) {
+        return false;
+    }
+    size_t len = lo_message_length(msg, path);
+    if (len > SHM_RING_RECORD_MAX) {
+        // sending it over UDP instead would let it overtake whatever is still in the ring
+        fprintf(stderr, "crone_shm: dropped oversized message %s (%zu bytes)\n", path, len);
+        return true;
+    }
+
+    // crone drains the ring on a thread of its own, so when it's full there should be room shortly
+    for (int tries = 0; tries < CRONE_SHM_FULL_TRIES; tries++) {
+        pthread_mutex_lock(&send_lock);
+        if (link_mem == NULL) {
+            pthread_mutex_unlock(&send_lock);
+            return false;
+        }
+        struct shm_ring *ring = &link_mem->to_crone;
+        void *dst = shm_ring_reserve(ring, len);
+        if (dst != NULL) {
+            size_t size = len;
+            lo_message_serialise(msg, path, dst, &size);
+            if (shm_ring_commit(ring, len)) {
+                uint64_t one = 1;
+                if (write(wake_crone_fd, &one, sizeof(one)) < 0) {
+                    fprintf(stderr, "crone_shm: failed to wake crone\n");
+                }
+            }
+            pthread_mutex_unlock(&send_lock);
+            return true;
+        }
+        pthread_mutex_unlock(&send_lock);
+        usleep(CRONE_SHM_FULL_WAIT_US);
+    }
+    unsigned int n = atomic_fetch_add(&dropped, 1) + 1;
+    fprintf(stderr, "crone_shm: ring full, dropped message %s (%u dropped so far)\n", path, n);
+    return true;
+}
@@ -0,0 +1,29 @@
+/*
+ * crone_shm.h
+ *
+ * shared-memory link to crone
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <lo/lo.h>
+
+// when crone runs on the same machine it offers a pair of shared rings on a unix socket.
+// OSC packets to and from crone then go through the rings instead of UDP, and incoming ones
+// are passed to `handler`, on the link's own thread. while the link is down (crone not running
+// yet, or restarting) callers fall back to UDP; while it's up they never do, so messages can't
+// overtake one another.
+typedef void (*crone_shm_handler_t)(void *data, size_t size);
+extern void crone_shm_init(const char *crone_port, crone_shm_handler_t handler);
+extern void crone_shm_deinit(void);
+
+// send a message to crone over the link, waiting a few ms for room if the ring is full.
+// returns false if the link is down; send it over UDP instead. while the link is up everything
+// goes through it, so a message too big for the ring, or one crone has no room for in time,
+// is dropped with an error.
+extern bool crone_shm_send(const char *path, lo_message msg);
+
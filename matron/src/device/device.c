@@ -6,13 +6,15 @@
 #include <string.h>
 
 #include "device.h"
+#include "device_loopback.h"
+#include "device_reactor.h"
 
 #define TEST_NULL_AND_FREE(p) \
     if ((p) != NULL) {        \
         free(p);              \
     }
 
-// start the rx thread for a device
+// start watching a device for input
 static int dev_start(union dev *d);
 
 union dev *dev_new(device_t type, const char *path, const char *name, bool multiport_device,
@@ -32,17 +34,21 @@ union dev *dev_new(device_t type, const char *path, const char *name, bool multi
     // initialize the subclass
     switch (type) {
     case DEV_TYPE_MONOME:
-        if (dev_monome_init(d) < 0) {
+        if ((dev_loopback_path(path) ? dev_monome_loopback_init(d) : dev_monome_init(d)) < 0) {
             goto err_init;
         };
         break;
     case DEV_TYPE_HID:
-        if (dev_hid_init(d) < 0) {
+        if ((dev_loopback_path(path) ? dev_hid_loopback_init(d) : dev_hid_init(d)) < 0) {
             goto err_init;
         }
         break;
     case DEV_TYPE_MIDI:
-        if (dev_midi_init(d, midi_port_index, multiport_device) < 0) {
+        if (dev_loopback_path(path)) {
+            if (dev_midi_loopback_init(d) < 0) {
+                goto err_init;
+            }
+        } else if (dev_midi_init(d, midi_port_index, multiport_device) < 0) {
             goto err_init;
         }
         break;
@@ -70,26 +76,15 @@ err_init:
 }
 
 void dev_delete(union dev *d) {
-    int ret;
-    // if the device has a start function, then it has an input thread that needs stopping
-    if (d->base.start != NULL) {
-        if (pthread_kill(d->base.tid, 0) == 0) {
-            // device i/o thread still running
-            ret = pthread_cancel(d->base.tid);
-            if (ret) {
-                fprintf(stderr, "dev_delete(): error in pthread_cancel(): %d\n", ret);
-                exit(EXIT_FAILURE);
-            }
-        }
-
-        ret = pthread_join(d->base.tid, NULL);
-        if (ret) {
-            fprintf(stderr, "dev_delete(): error in pthread_join(): %d\n", ret);
-            exit(EXIT_FAILURE);
-        }
+    // input handlers must be finished before the device goes away
+    if (d->base.source != NULL) {
+        dev_reactor_remove(d->base.source);
+        d->base.source = NULL;
     }
 
     d->base.deinit(d);
+    // after deinit, which may still write to it (e.g. looped-back midi output)
+    dev_loopback_free(d->base.loopback);
 
     TEST_NULL_AND_FREE(d->base.path);
     TEST_NULL_AND_FREE(d->base.serial);
@@ -98,24 +93,28 @@ void dev_delete(union dev *d) {
     free(d);
 }
 
+static void dev_handle_input(void *ctx, uint32_t events) {
+    union dev *d = (union dev *)ctx;
+    d->base.handle_input(d, events);
+}
+
 int dev_start(union dev *d) {
-    pthread_attr_t attr;
-    int ret;
+    int fd;
 
-    if (d->base.start == NULL) {
-        // fprintf(stderr, "device.c: no `start` function defined (no input); skipping\n");
+    if (d->base.input_fd == NULL) {
+        // fprintf(stderr, "device.c: no `input_fd` function defined (no input); skipping\n");
         return 0;
     }
 
-    ret = pthread_attr_init(&attr);
-    if (ret) {
-        fprintf(stderr, "m_init(): error on thread attributes \n");
+    fd = d->base.input_fd(d);
+    if (fd < 0) {
+        fprintf(stderr, "dev_start(): no input descriptor for device %s\n", d->base.name);
         return -1;
     }
-    ret = pthread_create(&d->base.tid, &attr, d->base.start, d);
-    pthread_attr_destroy(&attr);
-    if (ret) {
-        fprintf(stderr, "m_init(): error creating thread\n");
+
+    d->base.source = dev_reactor_add(fd, &dev_handle_input, d);
+    if (d->base.source == NULL) {
+        fprintf(stderr, "dev_start(): error watching device %s\n", d->base.name);
         return -1;
     }
     return 0;
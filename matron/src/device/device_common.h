@@ -2,6 +2,9 @@
 
 #include <stdint.h>
 
+struct dev_reactor_source;
+struct dev_loopback;
+
 typedef enum {
     // libmonome devices
     DEV_TYPE_MONOME = 0,
@@ -23,16 +26,20 @@ struct dev_common {
     device_t type;
     // numerical id; unique over matron's lifetime
     uint32_t id;
-    // thread id
-    pthread_t tid;
     // path to device node in filesystem
     char *path;
     // serial string or similar
     char *serial;
     // human readable string
     char *name;
-    // start function for pthread_create
-    void *(*start)(void *self);
+    // input watch registered with the device reactor, if any
+    struct dev_reactor_source *source;
+    // returns a file descriptor to watch for input, or -1; NULL if the device has no input
+    int (*input_fd)(void *self);
+    // consume available input; called from the reactor thread when input_fd is readable
+    void (*handle_input)(void *self, uint32_t events);
     // stop function
     void (*deinit)(void *self);
+    // software input source, for loopback devices; NULL for hardware
+    struct dev_loopback *loopback;
 };
@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/input.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +26,9 @@
 
 #define CROW_RETRIES 10
 
+static void line_reset(struct dev_crow *d);
+static void line_parse(struct dev_crow *d, const char *buf, size_t len);
+
 int dev_crow_init(void *self) {
     struct dev_crow *d = (struct dev_crow *)self;
     struct dev_common *base = (struct dev_common *)self;
@@ -68,43 +72,119 @@ int dev_crow_init(void *self) {
         return -1;
     }
 
-    base->start = &dev_crow_start;
+    line_reset(d);
+
+    base->input_fd = &dev_crow_input_fd;
+    base->handle_input = &dev_crow_handle_input;
     base->deinit = &dev_crow_deinit;
 
     return 0;
 }
 
-static void handle_event(void *dev, uint8_t id) {
+static void line_reset(struct dev_crow *d) {
+    d->line_len = 0;
+    d->line_state = CROW_LINE_TEXT;
+}
+
+// whether the event that just ended is ^^name(args)
+static bool line_is_event(struct dev_crow *d, const char *name, const char *args) {
+    return d->event_name_len == strlen(name) && memcmp(d->line + d->event_name_start, name, d->event_name_len) == 0 &&
+           d->event_args_len == strlen(args) && memcmp(d->line + d->event_args_start, args, d->event_args_len) == 0;
+}
+
+// track events through the line as `c` is appended; returns true when `c` closes one
+static bool line_advance(struct dev_crow *d, char c) {
+    switch (d->line_state) {
+    case CROW_LINE_TEXT:
+        if (c == '^') {
+            d->line_state = CROW_LINE_CARET;
+        }
+        break;
+    case CROW_LINE_CARET:
+        if (c == '^') {
+            d->line_state = CROW_LINE_EVENT_NAME;
+            d->event_name_start = d->line_len + 1;
+            d->event_name_len = 0;
+        } else {
+            d->line_state = CROW_LINE_TEXT;
+        }
+        break;
+    case CROW_LINE_EVENT_NAME:
+        if (c == '(') {
+            d->line_state = CROW_LINE_EVENT_ARGS;
+            d->event_args_start = d->line_len + 1;
+            d->event_args_len = 0;
+        } else if (c == '^') {
+            d->line_state = CROW_LINE_CARET;
+        } else {
+            d->event_name_len++;
+        }
+        break;
+    case CROW_LINE_EVENT_ARGS:
+        if (c == ')') {
+            d->line_state = CROW_LINE_TEXT;
+            return true;
+        }
+        d->event_args_len++;
+        break;
+    }
+    return false;
+}
+
+// post the current line, if any, and start a new one
+static void line_finish(struct dev_crow *d) {
+    if (d->line_len == 0) {
+        return;
+    }
+
     union event_data *ev = event_data_new(EVENT_CROW_EVENT);
-    ev->crow_event.dev = dev;
-    ev->crow_event.id = id;
+    ev->crow_event.dev = d;
+    ev->crow_event.id = d->base.id;
+    ev->crow_event.line = strndup(d->line, d->line_len);
     event_post(ev);
 
-    struct dev_crow *d = (struct dev_crow *)dev;
-    if (strstr(d->line, "^^change(1,1)")) {
-        clock_crow_handle_clock();
+    line_reset(d);
+}
+
+// feed bytes read from the device; complete lines may span reads and a read may hold several lines
+static void line_parse(struct dev_crow *d, const char *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = buf[i];
+
+        if (c == '\n' || c == '\r' || c == '\0') {
+            line_finish(d);
+            continue;
+        }
+
+        if (d->line_len == CROW_LINE_MAX) {
+            line_finish(d);
+        }
+
+        bool event_end = line_advance(d, c);
+        d->line[d->line_len++] = c;
+        // input 1 clock edges are handled here rather than waiting on the lua thread
+        if (event_end && line_is_event(d, "change", "1,1")) {
+            clock_crow_handle_clock();
+        }
     }
 }
 
-void *dev_crow_start(void *self) {
+int dev_crow_input_fd(void *self) {
     struct dev_crow *di = (struct dev_crow *)self;
-    struct dev_common *base = (struct dev_common *)self;
+    return di->fd;
+}
 
-    uint8_t len;
-
-    while (1) {
-        len = read(di->fd, di->line, 255);
-        if (len > 0) {
-            di->line[len] = 0; // add null to end of string
-            if (len > 1) {
-                // fprintf(stderr,"crow> %s", di->line);
-                handle_event(self, base->id);
-            }
-            len = 0;
-        }
-        usleep(1000); // 1ms
+void dev_crow_handle_input(void *self, uint32_t events) {
+    struct dev_crow *di = (struct dev_crow *)self;
+    char buf[256];
+    ssize_t len;
+    (void)events;
+
+    len = read(di->fd, buf, sizeof(buf));
+    if (len > 0) {
+        // fprintf(stderr,"crow> %.*s", (int)len, buf);
+        line_parse(di, buf, len);
     }
-    return NULL;
 }
 
 void dev_crow_deinit(void *self) {
@@ -8,16 +8,36 @@
 #include <libevdev/libevdev.h>
 
 #define CROW_BAUDRATE B115200
+// longer lines are split into several events
+#define CROW_LINE_MAX 1024
+
+// where the event recogniser is within the current line.
+// "^^name(args)" is a crow event, wherever it appears in the line.
+typedef enum {
+    CROW_LINE_TEXT,
+    CROW_LINE_CARET,
+    CROW_LINE_EVENT_NAME,
+    CROW_LINE_EVENT_ARGS,
+} crow_line_state_t;
 
 struct dev_crow {
     struct dev_common base;
     int fd;
     struct termios oldtio, newtio;
-    char line[255];
+    // current line, carried across reads until its terminator arrives
+    char line[CROW_LINE_MAX];
+    size_t line_len;
+    crow_line_state_t line_state;
+    // span of the latest event's name and arguments within `line`
+    size_t event_name_start;
+    size_t event_name_len;
+    size_t event_args_start;
+    size_t event_args_len;
 };
 
 extern int dev_crow_init(void *self);
-extern void *dev_crow_start(void *self);
+extern int dev_crow_input_fd(void *self);
+extern void dev_crow_handle_input(void *self, uint32_t events);
 extern void dev_crow_deinit(void *self);
 
 extern void dev_crow_send(struct dev_crow *d, const char *line);
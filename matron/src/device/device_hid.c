@@ -9,7 +9,10 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <unistd.h>
+
 #include "device_hid.h"
+#include "device_loopback.h"
 #include "events.h"
 
 #define TEST_NULL_AND_FREE(p)                                    \
@@ -87,7 +90,7 @@ int dev_hid_init(void *self) {
     struct libevdev *dev = NULL;
     int ret = 1;
     guint16 raw_guid[16];
-    int fd = open(d->base.path, O_RDONLY);
+    int fd = open(d->base.path, O_RDONLY | O_NONBLOCK);
 
     if (fd < 0) {
         fprintf(stderr, "failed to open hid device: %s\n", d->base.path);
@@ -110,42 +113,191 @@ int dev_hid_init(void *self) {
     get_guid(dev, raw_guid);
     guid_to_string(raw_guid, d->guid);
 
-    base->start = &dev_hid_start;
+    base->input_fd = &dev_hid_input_fd;
+    base->handle_input = &dev_hid_handle_input;
     base->deinit = &dev_hid_deinit;
 
     return 0;
 }
 
-static void handle_event(struct dev_hid *dev, struct input_event *inev) {
-    union event_data *ev = event_data_new(EVENT_HID_EVENT);
-    ev->hid_event.id = dev->base.id;
-    ev->hid_event.type = inev->type;
-    ev->hid_event.code = inev->code;
-    ev->hid_event.value = inev->value;
+// a two-axis controller with two buttons: the axes sweep every frame, a button toggles every 16th
+static size_t loopback_generate(uint64_t step, uint8_t *buf) {
+    struct input_event *ev = (struct input_event *)buf;
+    int32_t pos = step % 256;
+    size_t n = 0;
+
+    memset(ev, 0, 4 * sizeof(struct input_event));
+    ev[n].type = EV_ABS;
+    ev[n].code = ABS_X;
+    ev[n++].value = pos;
+    ev[n].type = EV_ABS;
+    ev[n].code = ABS_Y;
+    ev[n++].value = 255 - pos;
+    if (step % 16 == 0) {
+        ev[n].type = EV_KEY;
+        ev[n].code = BTN_SOUTH;
+        ev[n++].value = (step / 16) % 2;
+    }
+    ev[n].type = EV_SYN;
+    ev[n++].code = SYN_REPORT;
+
+    return n * sizeof(struct input_event);
+}
+
+int dev_hid_loopback_init(void *self) {
+    struct dev_hid *d = (struct dev_hid *)self;
+    struct dev_common *base = (struct dev_common *)self;
+    static const uint8_t types[] = {EV_SYN, EV_KEY, EV_ABS};
+    static const dev_code_t syn_codes[] = {SYN_REPORT};
+    static const dev_code_t key_codes[] = {BTN_SOUTH, BTN_EAST};
+    static const dev_code_t abs_codes[] = {ABS_X, ABS_Y};
+    static const dev_code_t *codes[] = {syn_codes, key_codes, abs_codes};
+    static const int num_codes[] = {1, 2, 2};
+    guint16 raw_guid[8] = {0};
+
+    d->dev = NULL;
+    d->num_types = 3;
+    d->types = malloc(sizeof(types));
+    d->num_codes = malloc(sizeof(num_codes));
+    d->codes = calloc(d->num_types, sizeof(dev_code_t *));
+    if (d->types == NULL || d->num_codes == NULL || d->codes == NULL) {
+        goto err_alloc;
+    }
+    memcpy(d->types, types, sizeof(types));
+    memcpy(d->num_codes, num_codes, sizeof(num_codes));
+    for (int i = 0; i < d->num_types; i++) {
+        d->codes[i] = malloc(num_codes[i] * sizeof(dev_code_t));
+        if (d->codes[i] == NULL) {
+            goto err_alloc;
+        }
+        memcpy(d->codes[i], codes[i], num_codes[i] * sizeof(dev_code_t));
+    }
+    guid_to_string(raw_guid, d->guid);
+
+    base->loopback = dev_loopback_new(&loopback_generate);
+    if (base->loopback == NULL) {
+        goto err_alloc;
+    }
+
+    base->input_fd = &dev_hid_input_fd;
+    base->handle_input = &dev_hid_handle_input;
+    base->deinit = &dev_hid_deinit;
+
+    return 0;
+
+err_alloc:
+    if (d->codes != NULL) {
+        for (int i = 0; i < d->num_types; i++) {
+            free(d->codes[i]);
+        }
+    }
+    free(d->codes);
+    free(d->num_codes);
+    free(d->types);
+    return -1;
+}
+
+static inline bool is_subscribed(struct dev_hid *d, uint16_t type, uint16_t code) {
+    if (type >= EV_CNT || code >= KEY_CNT) {
+        return true;
+    }
+    size_t bit = (size_t)type * KEY_CNT + code;
+    return !(atomic_load_explicit(&d->unsubscribed[bit >> 3], memory_order_relaxed) & (1 << (bit & 7)));
+}
+
+static void post_frame(struct dev_hid *d) {
+    if (d->frame_len == 0) {
+        return;
+    }
+    union event_data *ev = event_data_new(EVENT_HID_FRAME);
+    ev->hid_frame.id = d->base.id;
+    ev->hid_frame.count = d->frame_len;
+    ev->hid_frame.entries = d->frame;
     event_post(ev);
+
+    d->frame = NULL;
+    d->frame_len = 0;
 }
 
-void *dev_hid_start(void *self) {
+// add a code to the current frame. absolute axes keep only their latest value and
+// relative axes are summed; keys and everything else are kept in order.
+static void frame_add(struct dev_hid *d, struct input_event *inev) {
+    if (inev->type == EV_ABS || inev->type == EV_REL) {
+        for (int i = 0; i < d->frame_len; i++) {
+            struct event_hid_frame_entry *e = &d->frame[i];
+            if (e->type == inev->type && e->code == inev->code) {
+                e->value = inev->type == EV_ABS ? inev->value : e->value + inev->value;
+                return;
+            }
+        }
+    }
+
+    if (d->frame_len == DEV_HID_FRAME_MAX) {
+        post_frame(d);
+    }
+    if (d->frame == NULL) {
+        d->frame = malloc(DEV_HID_FRAME_MAX * sizeof(struct event_hid_frame_entry));
+        if (d->frame == NULL) {
+            return;
+        }
+    }
+
+    struct event_hid_frame_entry *e = &d->frame[d->frame_len++];
+    e->type = inev->type;
+    e->code = inev->code;
+    e->value = inev->value;
+}
+
+static void handle_event(struct dev_hid *dev, struct input_event *inev) {
+    if (inev->type == EV_SYN) {
+        if (inev->code == SYN_REPORT) {
+            post_frame(dev);
+        }
+    } else if (inev->type != EV_MSC && is_subscribed(dev, inev->type, inev->code)) {
+        frame_add(dev, inev);
+    }
+}
+
+int dev_hid_input_fd(void *self) {
+    struct dev_hid *di = (struct dev_hid *)self;
+    if (di->base.loopback != NULL) {
+        return di->base.loopback->fds[0];
+    }
+    return libevdev_get_fd(di->dev);
+}
+
+static void loopback_handle_input(struct dev_hid *di) {
+    struct input_event evs[64];
+    ssize_t n = read(di->base.loopback->fds[0], evs, sizeof(evs));
+    for (ssize_t i = 0; i < n / (ssize_t)sizeof(struct input_event); i++) {
+        handle_event(di, &evs[i]);
+    }
+}
+
+void dev_hid_handle_input(void *self, uint32_t events) {
     struct dev_hid *di = (struct dev_hid *)self;
     int rc = 1;
+    (void)events;
+    if (di->base.loopback != NULL) {
+        loopback_handle_input(di);
+        return;
+    }
+    // the fd is non-blocking; drain what is available and return to the reactor
     do {
         struct input_event ev;
-        rc = libevdev_next_event(di->dev, LIBEVDEV_READ_FLAG_NORMAL | LIBEVDEV_READ_FLAG_BLOCKING, &ev);
+        rc = libevdev_next_event(di->dev, LIBEVDEV_READ_FLAG_NORMAL, &ev);
 
         if (rc == LIBEVDEV_READ_STATUS_SYNC) {
-            // dropped...
+            // dropped; the codes libevdev reports while re-syncing bring us back to the device state
             while (rc == LIBEVDEV_READ_STATUS_SYNC) {
+                handle_event(di, &ev);
                 rc = libevdev_next_event(di->dev, LIBEVDEV_READ_FLAG_SYNC, &ev);
             }
             // re-synced...
         } else if (rc == LIBEVDEV_READ_STATUS_SUCCESS) {
-            // filter out sync and msc events
-            if (!((ev.type == EV_SYN) || (ev.type == EV_MSC))) {
-                handle_event(di, &ev);
-            }
+            handle_event(di, &ev);
         }
-    } while (rc == LIBEVDEV_READ_STATUS_SYNC || rc == LIBEVDEV_READ_STATUS_SUCCESS || rc == -EAGAIN);
-    return NULL;
+    } while (rc == LIBEVDEV_READ_STATUS_SYNC || rc == LIBEVDEV_READ_STATUS_SUCCESS);
 }
 
 void dev_hid_deinit(void *self) {
@@ -156,4 +308,26 @@ void dev_hid_deinit(void *self) {
     TEST_NULL_AND_FREE(di->codes);
     TEST_NULL_AND_FREE(di->num_codes);
     TEST_NULL_AND_FREE(di->types);
+    // a partial frame without its SYN_REPORT is dropped
+    free(di->frame);
+    di->frame = NULL;
+}
+
+void dev_hid_subscribe(struct dev_hid *d, int type, int code, bool subscribed) {
+    for (int t = 0; t < EV_CNT; t++) {
+        if (type >= 0 && t != type) {
+            continue;
+        }
+        for (int c = 0; c < KEY_CNT; c++) {
+            if (code >= 0 && c != code) {
+                continue;
+            }
+            size_t bit = (size_t)t * KEY_CNT + c;
+            if (subscribed) {
+                atomic_fetch_and(&d->unsubscribed[bit >> 3], ~(1 << (bit & 7)));
+            } else {
+                atomic_fetch_or(&d->unsubscribed[bit >> 3], 1 << (bit & 7));
+            }
+        }
+    }
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <linux/input.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -7,6 +9,12 @@
 #include <libevdev/libevdev.h>
 
 #define DEV_GUID_LEN 33
+// codes collected between SYN_REPORTs; a longer frame is posted in parts
+#define DEV_HID_FRAME_MAX 64
+// one bit per (type, code); KEY_CNT is the largest code range of any type
+#define DEV_HID_MASK_BYTES ((EV_CNT * KEY_CNT) / 8)
+
+struct event_hid_frame_entry;
 
 typedef uint8_t dev_vid_t;
 typedef uint8_t dev_pid_t;
@@ -27,8 +35,19 @@ struct dev_hid {
     int *num_codes;
     // arrays of supported event codes per event type
     dev_code_t **codes;
+    // codes read since the last SYN_REPORT; handed to the event when the frame is posted
+    struct event_hid_frame_entry *frame;
+    int frame_len;
+    // set bits are codes the script has unsubscribed from; written from lua, read on the reactor thread
+    _Atomic uint8_t unsubscribed[DEV_HID_MASK_BYTES];
 };
 
 extern int dev_hid_init(void *self);
-extern void *dev_hid_start(void *self);
+// software controller fed by a generator (see device_loopback.h)
+extern int dev_hid_loopback_init(void *self);
+extern int dev_hid_input_fd(void *self);
+extern void dev_hid_handle_input(void *self, uint32_t events);
 extern void dev_hid_deinit(void *self);
+// deliver (or drop) input with the given type and code.
+// a negative code applies to every code of the type; a negative type applies to everything.
+extern void dev_hid_subscribe(struct dev_hid *d, int type, int code, bool subscribed);
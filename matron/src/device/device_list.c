@@ -1,55 +1,149 @@
-#include <search.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "device.h"
 #include "device_list.h"
+#include "device_loopback.h"
 #include "device_midi.h"
 #include "events.h"
 
+// devices are indexed twice: by node path, for hotplug add/remove, and by id, which is the
+// handle lua holds. both tables are chained hashes that double in size as devices are added.
+#define DEV_LIST_INITIAL_BUCKETS 32
+
 static int id = 0;
 
 struct dev_node {
-    struct dev_node *next;
-    struct dev_node *prev;
+    // chain within the path table; devices sharing a path (midi ports) share a bucket
+    struct dev_node *path_next;
+    // chain within the id table
+    struct dev_node *id_next;
+    uint32_t path_hash;
     union dev *d;
 };
 
-struct dev_q {
-    struct dev_node *head;
-    struct dev_node *tail;
+struct dev_table {
+    struct dev_node **by_path;
+    struct dev_node **by_id;
+    size_t num_buckets;
     size_t size;
+    pthread_mutex_t lock;
 };
 
-struct dev_q dq;
+static struct dev_table dt;
+
+static uint32_t dev_hash_path(const char *path) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    while (*path) {
+        h ^= (uint8_t)*path++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline size_t dev_path_bucket(uint32_t hash) {
+    return hash & (dt.num_buckets - 1);
+}
+
+static inline size_t dev_id_bucket(uint32_t dev_id) {
+    return dev_id & (dt.num_buckets - 1);
+}
 
-static struct dev_node *dev_lookup_path(const char *path, struct dev_node *node_head) {
-    const char *npath;
+static bool dev_path_matches(struct dev_node *dn, uint32_t hash, const char *path) {
+    const char *npath = dn->d->base.path;
+    return dn->path_hash == hash && npath != NULL && strcmp(path, npath) == 0;
+}
 
-    if (path == NULL) {
+// call with lock held
+static struct dev_node *dev_lookup_path(const char *path) {
+    if (path == NULL || dt.by_path == NULL) {
         return NULL;
     }
 
-    if (node_head == NULL) {
-        node_head = dq.head;
+    uint32_t hash = dev_hash_path(path);
+    for (struct dev_node *dn = dt.by_path[dev_path_bucket(hash)]; dn != NULL; dn = dn->path_next) {
+        if (dev_path_matches(dn, hash, path)) {
+            return dn;
+        }
     }
+    return NULL;
+}
+
+// call with lock held
+static void dev_table_link(struct dev_node *dn) {
+    size_t pb = dev_path_bucket(dn->path_hash);
+    size_t ib = dev_id_bucket(dn->d->base.id);
+    dn->path_next = dt.by_path[pb];
+    dt.by_path[pb] = dn;
+    dn->id_next = dt.by_id[ib];
+    dt.by_id[ib] = dn;
+}
 
-    while (node_head != NULL) {
-        npath = node_head->d->base.path;
-        if (npath != NULL && strcmp(path, npath) == 0) {
-            return node_head;
+// call with lock held
+static void dev_table_unlink(struct dev_node *dn) {
+    struct dev_node **pp = &dt.by_path[dev_path_bucket(dn->path_hash)];
+    while (*pp != dn) {
+        pp = &(*pp)->path_next;
+    }
+    *pp = dn->path_next;
+
+    pp = &dt.by_id[dev_id_bucket(dn->d->base.id)];
+    while (*pp != dn) {
+        pp = &(*pp)->id_next;
+    }
+    *pp = dn->id_next;
+
+    dt.size--;
+}
+
+// call with lock held
+static void dev_table_grow(void) {
+    struct dev_node **old_by_path = dt.by_path;
+    struct dev_node **old_by_id = dt.by_id;
+    size_t old_num_buckets = dt.num_buckets;
+    size_t num_buckets = old_num_buckets * 2;
+
+    struct dev_node **by_path = calloc(num_buckets, sizeof(struct dev_node *));
+    struct dev_node **by_id = calloc(num_buckets, sizeof(struct dev_node *));
+    if (by_path == NULL || by_id == NULL) {
+        // keep the current tables; lookups just get slower
+        free(by_path);
+        free(by_id);
+        return;
+    }
+
+    dt.by_path = by_path;
+    dt.by_id = by_id;
+    dt.num_buckets = num_buckets;
+
+    // every node is in exactly one path chain, so relinking from those covers both tables
+    for (size_t b = 0; b < old_num_buckets; b++) {
+        struct dev_node *dn = old_by_path[b];
+        while (dn != NULL) {
+            struct dev_node *next = dn->path_next;
+            dev_table_link(dn);
+            dn = next;
         }
-        node_head = node_head->next;
     }
-    return NULL;
+
+    free(old_by_path);
+    free(old_by_id);
 }
 
 void dev_list_init(void) {
-    dq.size = 0;
-    dq.head = NULL;
-    dq.tail = NULL;
+    pthread_mutex_init(&dt.lock, NULL);
+    dt.num_buckets = DEV_LIST_INITIAL_BUCKETS;
+    dt.by_path = calloc(dt.num_buckets, sizeof(struct dev_node *));
+    dt.by_id = calloc(dt.num_buckets, sizeof(struct dev_node *));
+    dt.size = 0;
+    if (dt.by_path == NULL || dt.by_id == NULL) {
+        fprintf(stderr, "dev_list_init: error allocating device table\n");
+    }
 }
 
 union event_data *post_add_event(union dev *d, event_t event_type) {
@@ -66,15 +160,17 @@ union event_data *post_add_event(union dev *d, event_t event_type) {
         return NULL;
     }
 
-    d->base.id = id++;
     dn->d = d;
+    dn->path_hash = d->base.path != NULL ? dev_hash_path(d->base.path) : 0;
 
-    insque(dn, dq.tail);
-    dq.tail = dn;
-    if (dq.size == 0) {
-        dq.head = dn;
+    pthread_mutex_lock(&dt.lock);
+    d->base.id = id++;
+    if (dt.size >= dt.num_buckets) {
+        dev_table_grow();
     }
-    dq.size++;
+    dev_table_link(dn);
+    dt.size++;
+    pthread_mutex_unlock(&dt.lock);
 
     union event_data *ev;
     ev = event_data_new(event_type);
@@ -92,7 +188,7 @@ void dev_list_add(device_t type, const char *path, const char *name) {
 
     switch (type) {
     case DEV_TYPE_MIDI:
-        midi_port_count = dev_midi_port_count(path);
+        midi_port_count = dev_loopback_path(path) ? 1 : dev_midi_port_count(path);
         for (unsigned int pidx = 0; pidx < midi_port_count; pidx++) {
             d = dev_new(type, path, name, midi_port_count > 1, pidx);
             ev = post_add_event(d, EVENT_MIDI_ADD);
@@ -132,24 +228,32 @@ void dev_list_add(device_t type, const char *path, const char *name) {
     }
 }
 
+// unlink a device found by path and take ownership of it; NULL if there is none
+static struct dev_node *dev_list_take_path(const char *path) {
+    pthread_mutex_lock(&dt.lock);
+    struct dev_node *dn = dev_lookup_path(path);
+    if (dn != NULL) {
+        dev_table_unlink(dn);
+    }
+    pthread_mutex_unlock(&dt.lock);
+    return dn;
+}
+
 static void dev_list_remove_node(struct dev_node *dn, union event_data *event_remove) {
     event_post(event_remove);
 
-    if (dq.head == dn) {
-        dq.head = dn->next;
-    }
-    if (dq.tail == dn) {
-        dq.tail = dn->prev;
-    }
-    remque(dn);
-    dq.size--;
-
+    // not under the table lock: stopping input waits for the reactor
     dev_delete(dn->d);
     free(dn);
 }
 
 void dev_list_remove(device_t type, const char *node) {
-    struct dev_node *dn = dev_lookup_path(node, NULL);
+    if (type != DEV_TYPE_MIDI && type != DEV_TYPE_MONOME && type != DEV_TYPE_HID && type != DEV_TYPE_CROW) {
+        fprintf(stderr, "dev_list_remove(): error posting event (unknown type)\n");
+        return;
+    }
+
+    struct dev_node *dn = dev_list_take_path(node);
     if (dn == NULL) {
         return;
     }
@@ -161,7 +265,7 @@ void dev_list_remove(device_t type, const char *node) {
             ev = event_data_new(EVENT_MIDI_REMOVE);
             ev->midi_remove.id = dn->d->base.id;
             dev_list_remove_node(dn, ev);
-            dn = dev_lookup_path(node, NULL);
+            dn = dev_list_take_path(node);
         }
         return;
     case DEV_TYPE_MONOME:
@@ -177,8 +281,34 @@ void dev_list_remove(device_t type, const char *node) {
         ev->crow_remove.id = dn->d->base.id;
         break;
     default:
-        fprintf(stderr, "dev_list_remove(): error posting event (unknown type)\n");
         return;
     }
     dev_list_remove_node(dn, ev);
 }
+
+union dev *dev_list_acquire(uint32_t dev_id) {
+    pthread_mutex_lock(&dt.lock);
+    if (dt.by_id != NULL) {
+        for (struct dev_node *dn = dt.by_id[dev_id_bucket(dev_id)]; dn != NULL; dn = dn->id_next) {
+            if (dn->d->base.id == dev_id) {
+                // removal unlinks under the lock before deleting, so it waits for dev_list_release()
+                return dn->d;
+            }
+        }
+    }
+    pthread_mutex_unlock(&dt.lock);
+
+    return NULL;
+}
+
+void dev_list_release(void) {
+    pthread_mutex_unlock(&dt.lock);
+}
+
+union dev *dev_list_lookup_path(const char *path) {
+    pthread_mutex_lock(&dt.lock);
+    struct dev_node *dn = dev_lookup_path(path);
+    pthread_mutex_unlock(&dt.lock);
+
+    return dn != NULL ? dn->d : NULL;
+}
@@ -1,7 +1,19 @@
 #pragma once
 
+#include <stdint.h>
+
 #include "device.h"
 
 extern void dev_list_init(void);
 extern void dev_list_add(device_t type, const char *node, const char *name);
-extern void dev_list_remove(device_t type, const char *node);
\ No newline at end of file
+extern void dev_list_remove(device_t type, const char *node);
+
+// find a device by id and hold the registry, so it can't be removed until dev_list_release().
+// NULL if there is none (it may have been unplugged); then there's nothing to release.
+// keep the hold short: hotplug waits on it.
+extern union dev *dev_list_acquire(uint32_t id);
+extern void dev_list_release(void);
+
+// find a device by node path; NULL if there is none.
+// for multi-port midi devices this returns one of the ports.
+extern union dev *dev_list_lookup_path(const char *path);
@@ -0,0 +1,159 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "device_loopback.h"
+
+// messages that fell due while the generator was descheduled are sent in bursts of at most this many;
+// beyond that the generator gives up on the backlog rather than flooding the pipe
+#define DEV_LOOPBACK_MAX_BURST 64
+
+static double dev_loopback_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void dev_loopback_timespec(struct timespec *ts, double seconds) {
+    ts->tv_sec = (time_t)seconds;
+    ts->tv_nsec = (long)((seconds - ts->tv_sec) * 1e9);
+}
+
+static void *dev_loopback_run(void *p) {
+    struct dev_loopback *lb = (struct dev_loopback *)p;
+    uint8_t buf[DEV_LOOPBACK_MSG_MAX];
+    struct timespec deadline;
+    uint64_t step = 0;
+    double next = dev_loopback_now();
+
+    pthread_mutex_lock(&lb->lock);
+
+    while (lb->running) {
+        if (lb->rate <= 0) {
+            pthread_cond_wait(&lb->cond, &lb->lock);
+            next = dev_loopback_now();
+            continue;
+        }
+
+        dev_loopback_timespec(&deadline, next);
+        if (pthread_cond_timedwait(&lb->cond, &lb->lock, &deadline) != ETIMEDOUT) {
+            // rate change or shutdown; look again
+            continue;
+        }
+
+        double period = 1.0 / lb->rate;
+        pthread_mutex_unlock(&lb->lock);
+
+        uint64_t generated = 0;
+        uint64_t dropped = 0;
+        double now = dev_loopback_now();
+        while (next <= now && generated + dropped < DEV_LOOPBACK_MAX_BURST) {
+            size_t n = lb->generate(step++, buf);
+            if (dev_loopback_write(lb, buf, n) == (ssize_t)n) {
+                generated++;
+            } else {
+                // the reader is behind and the pipe is full
+                dropped++;
+            }
+            next += period;
+        }
+        if (next <= now) {
+            next = now + period;
+        }
+
+        pthread_mutex_lock(&lb->lock);
+        lb->generated += generated;
+        lb->dropped += dropped;
+    }
+
+    pthread_mutex_unlock(&lb->lock);
+
+    return NULL;
+}
+
+//--------------------------------
+//---- extern function definitions
+
+bool dev_loopback_path(const char *path) {
+    return path != NULL && strncmp(path, DEV_LOOPBACK_PREFIX, strlen(DEV_LOOPBACK_PREFIX)) == 0;
+}
+
+struct dev_loopback *dev_loopback_new(dev_loopback_generate_t generate) {
+    pthread_condattr_t cond_attr;
+    pthread_attr_t attr;
+
+    struct dev_loopback *lb = calloc(1, sizeof(struct dev_loopback));
+    if (lb == NULL) {
+        return NULL;
+    }
+
+    if (pipe2(lb->fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+        fprintf(stderr, "dev_loopback: failed to create pipe (%s)\n", strerror(errno));
+        free(lb);
+        return NULL;
+    }
+
+    lb->generate = generate;
+
+    pthread_mutex_init(&lb->lock, NULL);
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&lb->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    lb->running = true;
+
+    pthread_attr_init(&attr);
+    if (pthread_create(&lb->tid, &attr, &dev_loopback_run, lb)) {
+        fprintf(stderr, "dev_loopback: error creating generator thread\n");
+        pthread_attr_destroy(&attr);
+        close(lb->fds[0]);
+        close(lb->fds[1]);
+        free(lb);
+        return NULL;
+    }
+    pthread_attr_destroy(&attr);
+
+    return lb;
+}
+
+void dev_loopback_free(struct dev_loopback *lb) {
+    if (lb == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&lb->lock);
+    lb->running = false;
+    pthread_cond_signal(&lb->cond);
+    pthread_mutex_unlock(&lb->lock);
+    pthread_join(lb->tid, NULL);
+
+    close(lb->fds[0]);
+    close(lb->fds[1]);
+    pthread_cond_destroy(&lb->cond);
+    pthread_mutex_destroy(&lb->lock);
+    free(lb);
+}
+
+void dev_loopback_set_rate(struct dev_loopback *lb, double rate) {
+    pthread_mutex_lock(&lb->lock);
+    lb->rate = rate;
+    pthread_cond_signal(&lb->cond);
+    pthread_mutex_unlock(&lb->lock);
+}
+
+void dev_loopback_stats(struct dev_loopback *lb, uint64_t *generated, uint64_t *dropped) {
+    pthread_mutex_lock(&lb->lock);
+    *generated = lb->generated;
+    *dropped = lb->dropped;
+    pthread_mutex_unlock(&lb->lock);
+}
+
+ssize_t dev_loopback_write(struct dev_loopback *lb, const void *data, size_t n) {
+    return write(lb->fds[1], data, n);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// software stand-ins for midi, monome and hid hardware, for load-testing the device layer.
+// a loopback device is added through dev_list_add() like any other, with a node path starting
+// with this prefix (e.g. "loopback:midi/1"). its input is a pipe, fed by a generator thread at
+// a configurable rate, and read by the same reactor and parsing code as the hardware.
+#define DEV_LOOPBACK_PREFIX "loopback:"
+// largest message a generator may produce per step
+#define DEV_LOOPBACK_MSG_MAX 128
+
+// write the message for generator step `step` into `buf`; returns its size in bytes
+typedef size_t (*dev_loopback_generate_t)(uint64_t step, uint8_t *buf);
+
+struct dev_loopback {
+    // [0] is watched by the reactor; [1] is written by the generator (and by looped-back output)
+    int fds[2];
+    dev_loopback_generate_t generate;
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool running;
+    // generated messages per second; 0 leaves the generator idle
+    double rate;
+    // statistics
+    uint64_t generated;
+    uint64_t dropped;
+};
+
+// true if `path` names a loopback device
+extern bool dev_loopback_path(const char *path);
+
+// create the pipe and start an idle generator; returns NULL on failure
+extern struct dev_loopback *dev_loopback_new(dev_loopback_generate_t generate);
+// stop the generator and close the pipe
+extern void dev_loopback_free(struct dev_loopback *lb);
+
+extern void dev_loopback_set_rate(struct dev_loopback *lb, double rate);
+extern void dev_loopback_stats(struct dev_loopback *lb, uint64_t *generated, uint64_t *dropped);
+// write bytes into the device's input, as if the device had sent them; never blocks.
+// writes of up to PIPE_BUF bytes are not interleaved with generated messages.
+extern ssize_t dev_loopback_write(struct dev_loopback *lb, const void *data, size_t n);
@@ -1,15 +1,21 @@
 #include <alsa/asoundlib.h>
+#include <errno.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "../events.h"
 
+#include "../clock.h"
 #include "../clocks/clock_midi.h"
 
 #include "device.h"
+#include "device_loopback.h"
 #include "device_midi.h"
 
-#define DEV_MIDI_INPUT_BUFFER_SIZE 128
+#define DEV_MIDI_INPUT_READS_PER_WAKE 8
 
 unsigned int dev_midi_port_count(const char *path) {
     int card;
@@ -107,14 +113,20 @@ int dev_midi_init(void *self, unsigned int port_index, bool multiport_device) {
     }
 
     if (midi->handle_in != NULL) {
-        base->start = &dev_midi_start;
+        base->input_fd = &dev_midi_input_fd;
+        base->handle_input = &dev_midi_handle_input;
     } else {
-        base->start = NULL;
+        base->input_fd = NULL;
+        base->handle_input = NULL;
     }
     base->deinit = &dev_midi_deinit;
 
     midi->clock_enabled = true;
 
+    if (midi->handle_out != NULL && midi_out_init(&midi->out, midi->handle_out) < 0) {
+        fprintf(stderr, "failed to start output scheduler for midi device: %s\n", base->name);
+    }
+
     return 0;
 }
 
@@ -134,12 +146,80 @@ int dev_midi_virtual_init(void *self) {
     // trigger reading
     snd_rawmidi_read(midi->handle_in, NULL, 0);
 
-    base->start = &dev_midi_start;
+    base->input_fd = &dev_midi_input_fd;
+    base->handle_input = &dev_midi_handle_input;
+    base->deinit = &dev_midi_deinit;
+
+    if (midi_out_init(&midi->out, midi->handle_out) < 0) {
+        fprintf(stderr, "failed to start output scheduler for virtual midi device\n");
+    }
+
+    return 0;
+}
+
+// a repeating phrase of channel voice messages: note on, controller, note off, pitch bend
+static size_t dev_midi_loopback_generate(uint64_t step, uint8_t *buf) {
+    uint8_t value = (step / 4) % 128;
+    switch (step % 4) {
+    case 0:
+        buf[0] = 0x90;
+        buf[1] = 48 + value % 24;
+        buf[2] = 100;
+        return 3;
+    case 1:
+        buf[0] = 0xb0;
+        buf[1] = 1;
+        buf[2] = value;
+        return 3;
+    case 2:
+        buf[0] = 0x80;
+        buf[1] = 48 + value % 24;
+        buf[2] = 0;
+        return 3;
+    default:
+        buf[0] = 0xe0;
+        buf[1] = 0;
+        buf[2] = value;
+        return 3;
+    }
+}
+
+int dev_midi_loopback_init(void *self) {
+    struct dev_midi *midi = (struct dev_midi *)self;
+    struct dev_common *base = (struct dev_common *)self;
+
+    base->loopback = dev_loopback_new(&dev_midi_loopback_generate);
+    if (base->loopback == NULL) {
+        return -1;
+    }
+
+    // output is written back into the input
+    if (midi_out_init_fd(&midi->out, base->loopback->fds[1]) < 0) {
+        fprintf(stderr, "failed to start output scheduler for loopback midi device\n");
+        dev_loopback_free(base->loopback);
+        base->loopback = NULL;
+        return -1;
+    }
+
+    base->input_fd = &dev_midi_input_fd;
+    base->handle_input = &dev_midi_handle_input;
     base->deinit = &dev_midi_deinit;
 
+    midi->clock_enabled = true;
+
     return 0;
 }
 
+// as snd_rawmidi_read(): bytes read, or a negative error code
+static ssize_t dev_midi_loopback_read(struct dev_loopback *lb, uint8_t *buf, size_t size) {
+    ssize_t n = read(lb->fds[0], buf, size);
+    return n < 0 ? -errno : n;
+}
+
+static inline bool dev_midi_has_output(struct dev_midi *midi) {
+    return midi->handle_out != NULL || midi->dev.loopback != NULL;
+}
+
 void dev_midi_deinit(void *self) {
     struct dev_midi *midi = (struct dev_midi *)self;
     // struct dev_common *base = (struct dev_common *)self;
@@ -150,6 +230,16 @@ void dev_midi_deinit(void *self) {
     if (midi->handle_in != NULL) {
         snd_rawmidi_close(midi->handle_in);
     }
+    if (midi->status_in != NULL) {
+        snd_rawmidi_status_free(midi->status_in);
+        midi->status_in = NULL;
+    }
+    free(midi->input.sysex.data);
+    midi->input.sysex.data = NULL;
+    if (dev_midi_has_output(midi)) {
+        // stop the writer thread before the handle goes away
+        midi_out_deinit(&midi->out);
+    }
     if (midi->handle_out != NULL) {
         snd_rawmidi_close(midi->handle_out);
     }
@@ -201,10 +291,8 @@ static inline uint8_t midi_msg_len(uint8_t status) {
         return 1;
     }
 
-    // system exclusive messages (variable length)
+    // system exclusive messages are reassembled separately (see midi_input_sysex_*)
     switch (status) {
-    case 0xf0:    // sysex start
-        return 3; // special case, deliver sysex to lua in 3 byte chunks
     case 0xf7:    // sysex stop
         return 1; // special case, allow single sysex stop as isolated event
     }
@@ -213,40 +301,53 @@ static inline uint8_t midi_msg_len(uint8_t status) {
     return 2;
 }
 
-typedef struct {
-    uint8_t buffer[DEV_MIDI_INPUT_BUFFER_SIZE];
+static inline int midi_filter_slot(uint8_t status) {
+    return status < 0xf0 ? (status >> 4) - 8 : 7 + (status & 0x0f);
+}
 
-    uint8_t prior_status;
-    uint8_t prior_len;
+// true if a message with this status should not reach lua; counts either way
+static inline bool midi_input_filtered(struct dev_midi *midi, uint8_t status) {
+    uint16_t mask = atomic_load_explicit(&midi->filter.masks[midi_filter_slot(status)], memory_order_relaxed);
+    bool drop = status < 0xf0 ? (mask >> (status & 0x0f)) & 1 : mask != 0;
 
-    uint8_t msg_buf[3];
-    uint8_t msg_pos;
-    uint8_t msg_len;
-    bool msg_started;
-    bool msg_sysex;
-} midi_input_state_t;
+    if (drop) {
+        atomic_fetch_add_explicit(&midi->filter.filtered, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&midi->filter.delivered, 1, memory_order_relaxed);
+    }
+    return drop;
+}
 
-static inline void midi_input_msg_post(midi_input_state_t *state, struct dev_midi *midi) {
+static inline void midi_input_post_bytes(struct dev_midi *midi, const uint8_t *data, uint8_t n) {
     union event_data *ev = event_data_new(EVENT_MIDI_EVENT);
     ev->midi_event.id = midi->dev.id;
-    ev->midi_event.nbytes = state->msg_len;
-    for (uint8_t n = 0; n < state->msg_len; n++) {
-        ev->midi_event.data[n] = state->msg_buf[n];
+    ev->midi_event.timestamp = midi->input.timestamp;
+    ev->midi_event.nbytes = n;
+    for (uint8_t i = 0; i < n; i++) {
+        ev->midi_event.data[i] = data[i];
     }
     event_post(ev);
 }
 
+static inline void midi_input_msg_post(midi_input_state_t *state, struct dev_midi *midi) {
+    if (!midi_input_filtered(midi, state->msg_buf[0])) {
+        midi_input_post_bytes(midi, state->msg_buf, state->msg_len);
+    }
+}
+
 static inline void midi_input_msg_start(midi_input_state_t *state, uint8_t status) {
     state->msg_pos = 0;
     state->msg_len = midi_msg_len(status);
     state->msg_started = true;
     state->msg_buf[state->msg_pos++] = status;
-    state->msg_sysex = status == 0xf0;
 
-    // save for running status
-    if (!is_status_real_time(status)) {
+    // save for running status (only channel messages may use it)
+    if (status < 0xf0) {
         state->prior_status = status;
         state->prior_len = state->msg_len;
+    } else {
+        state->prior_status = 0;
+        state->prior_len = 0;
     }
 }
 
@@ -257,47 +358,140 @@ static inline void midi_input_msg_end(midi_input_state_t *state) {
 
 static inline void midi_input_msg_acc(midi_input_state_t *state, uint8_t byte) {
     if (!state->msg_started) {
-        if (state->msg_sysex) {
-            // continue to pass sysex through in 3 byte chunks
-            state->msg_started = true;
-            state->msg_pos = 0;
-            state->msg_len = 3;
-        } else {
-            // running status, start a new message
-            state->msg_started = true;
-            state->msg_pos = 0;
-            state->msg_len = state->prior_len;
-            state->msg_buf[state->msg_pos++] = state->prior_status;
+        if (state->prior_status == 0) {
+            // stray data byte with no status to run on
+            return;
         }
+        // running status, start a new message
+        state->msg_started = true;
+        state->msg_pos = 0;
+        state->msg_len = state->prior_len;
+        state->msg_buf[state->msg_pos++] = state->prior_status;
     }
 
     state->msg_buf[state->msg_pos++] = byte;
-
-    // terminate sysex
-    if (byte == 0xf7) {
-        state->msg_sysex = false;
-        state->msg_len = state->msg_pos;
-    }
 }
 
 static inline bool midi_input_msg_is_complete(midi_input_state_t *state) {
     return state->msg_started && (state->msg_len == state->msg_pos);
 }
 
+//--- system exclusive reassembly
+// the per-device buffer grows as needed and is reused for every message;
+// each complete message is copied into its own event.
+
+static inline void midi_input_sysex_begin(midi_input_state_t *state, struct dev_midi *midi) {
+    state->msg_sysex = true;
+    state->sysex.len = 0;
+    state->sysex.overflow = false;
+    state->sysex.discard = midi_input_filtered(midi, 0xf0);
+    state->sysex.timestamp = state->timestamp;
+    // system exclusive cancels running status
+    state->prior_status = 0;
+    state->prior_len = 0;
+    midi_input_msg_end(state);
+}
+
+static inline void midi_input_sysex_acc(midi_input_state_t *state, uint8_t byte) {
+    midi_sysex_buf_t *sx = &state->sysex;
+
+    if (sx->overflow || sx->discard) {
+        return;
+    }
+
+    if (sx->len == sx->cap) {
+        size_t cap = sx->cap == 0 ? DEV_MIDI_SYSEX_INITIAL_SIZE : sx->cap * 2;
+        uint8_t *data = NULL;
+        if (cap <= DEV_MIDI_SYSEX_MAX_SIZE) {
+            data = realloc(sx->data, cap);
+        }
+        if (data == NULL) {
+            sx->overflow = true;
+            return;
+        }
+        sx->data = data;
+        sx->cap = cap;
+    }
+
+    sx->data[sx->len++] = byte;
+}
+
+static inline void midi_input_sysex_post(midi_input_state_t *state, struct dev_midi *midi) {
+    midi_sysex_buf_t *sx = &state->sysex;
+    uint8_t *data;
+
+    if (sx->discard) {
+        return;
+    }
+
+    if (sx->overflow) {
+        fprintf(stderr, "dropping sysex message over %d bytes from midi device: %s\n", DEV_MIDI_SYSEX_MAX_SIZE,
+                midi->dev.name);
+        return;
+    }
+
+    data = malloc(sx->len);
+    if (data == NULL) {
+        return;
+    }
+    memcpy(data, sx->data, sx->len);
+
+    union event_data *ev = event_data_new(EVENT_MIDI_SYSEX);
+    ev->midi_sysex.id = midi->dev.id;
+    ev->midi_sysex.data = data;
+    ev->midi_sysex.nbytes = sx->len;
+    ev->midi_sysex.timestamp = sx->timestamp;
+    event_post(ev);
+}
+
+static inline void midi_input_sysex_end(midi_input_state_t *state) {
+    state->msg_sysex = false;
+    state->sysex.len = 0;
+    state->sysex.overflow = false;
+    state->sysex.discard = false;
+}
+
 static inline ssize_t dev_midi_consume_buffer(midi_input_state_t *state, ssize_t size, struct dev_midi *midi) {
-    uint8_t i = 0;
+    ssize_t i = 0;
     uint8_t byte = 0;
 
     for (i = 0; i < size; i++) {
         byte = state->buffer[i];
 
-        if (byte >= 0xf8) {
+        if (is_status_real_time(byte)) {
+            // real-time messages may appear anywhere, including inside other messages.
+            // clock sync sees them regardless of the input filter.
             if (midi->clock_enabled) {
-                clock_midi_handle_message(byte);
+                clock_midi_handle_message(byte, state->timestamp);
+            }
+            if (!midi_input_filtered(midi, byte)) {
+                midi_input_post_bytes(midi, &byte, 1);
+            }
+            continue;
+        }
+
+        if (state->msg_sysex) {
+            if (!is_status_byte(byte)) {
+                midi_input_sysex_acc(state, byte);
+                continue;
+            }
+            if (byte == 0xf7) {
+                midi_input_sysex_acc(state, byte);
+                midi_input_sysex_post(state, midi);
+                midi_input_sysex_end(state);
+                continue;
             }
+            // any other status byte ends the sysex; drop the incomplete message
+            midi_input_sysex_end(state);
         }
 
-        if (is_status_byte(byte) && (byte != 0xf7)) {
+        if (byte == 0xf0) {
+            midi_input_sysex_begin(state, midi);
+            midi_input_sysex_acc(state, byte);
+            continue;
+        }
+
+        if (is_status_byte(byte)) {
             midi_input_msg_start(state, byte);
         } else {
             midi_input_msg_acc(state, byte);
@@ -312,56 +506,124 @@ static inline ssize_t dev_midi_consume_buffer(midi_input_state_t *state, ssize_t
     return i;
 }
 
-void *dev_midi_start(void *self) {
+int dev_midi_input_fd(void *self) {
     struct dev_midi *midi = (struct dev_midi *)self;
     struct dev_common *base = (struct dev_common *)self;
+    struct pollfd pfd;
 
-    snd_rawmidi_status_t *status = NULL;
-
-    midi_input_state_t state;
-    ssize_t read = 0;
-    ssize_t xruns;
+    if (base->loopback != NULL) {
+        return base->loopback->fds[0];
+    }
 
     if (midi->handle_in == NULL) {
-        fprintf(stderr, "starting a reader thread for a non-input MIDI device; shouldn't get here!\n");
-        return NULL;
+        fprintf(stderr, "watching input of a non-input MIDI device; shouldn't get here!\n");
+        return -1;
     }
 
-    // fprintf(stderr, "starting input thread for midi device: %s (%p)\n", base->name, midi->handle_in);
-
-    if (snd_rawmidi_status_malloc(&status) != 0) {
+    if (snd_rawmidi_status_malloc(&midi->status_in) != 0) {
         fprintf(stderr, "failed allocating rawmidi status, stopping device: %s\n", base->name);
-        return NULL;
+        return -1;
+    }
+
+    // reads happen from the device reactor and must never block it
+    snd_rawmidi_nonblock(midi->handle_in, 1);
+
+    if (snd_rawmidi_poll_descriptors(midi->handle_in, &pfd, 1) != 1) {
+        fprintf(stderr, "no poll descriptor for midi device: %s\n", base->name);
+        return -1;
     }
+    return pfd.fd;
+}
 
-    do {
-        read = snd_rawmidi_read(midi->handle_in, state.buffer, DEV_MIDI_INPUT_BUFFER_SIZE);
-        if (dev_midi_consume_buffer(&state, read, midi) != read) {
+void dev_midi_handle_input(void *self, uint32_t events) {
+    struct dev_midi *midi = (struct dev_midi *)self;
+    struct dev_common *base = (struct dev_common *)self;
+    midi_input_state_t *state = &midi->input;
+    ssize_t read = 0;
+    ssize_t xruns;
+    (void)events;
+
+    // bounded, so a busy device can't starve the others; epoll will report it again
+    for (int i = 0; i < DEV_MIDI_INPUT_READS_PER_WAKE; i++) {
+        // stamp at read time, so latency in the lua event loop does not skew it.
+        // all bytes of a read share the stamp; they arrived within one driver period.
+        state->timestamp = clock_get_system_time();
+        if (base->loopback != NULL) {
+            read = dev_midi_loopback_read(base->loopback, state->buffer, DEV_MIDI_INPUT_BUFFER_SIZE);
+        } else {
+            read = snd_rawmidi_read(midi->handle_in, state->buffer, DEV_MIDI_INPUT_BUFFER_SIZE);
+        }
+        if (read <= 0) {
+            break;
+        }
+        if (dev_midi_consume_buffer(state, read, midi) != read) {
             fprintf(stderr, "midi inconsistency for device: %s\n", base->name);
         }
+    }
 
-        if (snd_rawmidi_status(midi->handle_in, status) == 0) {
-            xruns = snd_rawmidi_status_get_xruns(status);
-            if (xruns > 0) {
-                fprintf(stderr, "xruns (%d) for midi device: %s\n", (int)xruns, base->name);
-                snd_rawmidi_drop(midi->handle_in);
-            }
+    if (read < 0 && read != -EAGAIN) {
+        fprintf(stderr, "midi read error (%s) for device: %s\n", snd_strerror(read), base->name);
+    }
+
+    if (base->loopback == NULL && snd_rawmidi_status(midi->handle_in, midi->status_in) == 0) {
+        xruns = snd_rawmidi_status_get_xruns(midi->status_in);
+        if (xruns > 0) {
+            fprintf(stderr, "xruns (%d) for midi device: %s\n", (int)xruns, base->name);
+            snd_rawmidi_drop(midi->handle_in);
         }
+    }
+}
+
+ssize_t dev_midi_send(void *self, uint8_t *data, size_t n) {
+    struct dev_midi *midi = (struct dev_midi *)self;
+    if (!dev_midi_has_output(midi)) {
+        return -1;
+    }
+    if (!midi_out_started(&midi->out)) {
+        // no output thread; write directly, as before there was one
+        return midi->handle_out != NULL ? snd_rawmidi_write(midi->handle_out, data, n) : -1;
+    }
+    if (midi_out_send(&midi->out, data, n) < 0) {
+        return -1;
+    }
+    return n;
+}
 
-    } while (read > 0);
+ssize_t dev_midi_send_at(void *self, midi_out_stamp_t type, double stamp, uint8_t *data, size_t n) {
+    struct dev_midi *midi = (struct dev_midi *)self;
+    if (!dev_midi_has_output(midi)) {
+        return -1;
+    }
+    if (midi_out_schedule(&midi->out, type, stamp, data, n) < 0) {
+        return -1;
+    }
+    return n;
+}
 
-    if (status) {
-        snd_rawmidi_status_free(status);
+void dev_midi_clear_scheduled(void *self) {
+    struct dev_midi *midi = (struct dev_midi *)self;
+    if (dev_midi_has_output(midi)) {
+        midi_out_clear(&midi->out);
     }
+}
 
-    return NULL;
+void dev_midi_set_filter(void *self, uint8_t status, uint16_t channel_mask) {
+    struct dev_midi *midi = (struct dev_midi *)self;
+    if (status < 0x80) {
+        return;
+    }
+    atomic_store_explicit(&midi->filter.masks[midi_filter_slot(status)], channel_mask, memory_order_relaxed);
 }
 
-ssize_t dev_midi_send(void *self, uint8_t *data, size_t n) {
+void dev_midi_clear_filters(void *self) {
     struct dev_midi *midi = (struct dev_midi *)self;
-    if (midi->handle_out == NULL) {
-        return -1;
-    } else {
-        return snd_rawmidi_write(midi->handle_out, data, n);
+    for (int i = 0; i < DEV_MIDI_FILTER_SLOTS; i++) {
+        atomic_store_explicit(&midi->filter.masks[i], 0, memory_order_relaxed);
     }
 }
+
+void dev_midi_filter_stats(void *self, uint64_t *delivered, uint64_t *filtered) {
+    struct dev_midi *midi = (struct dev_midi *)self;
+    *delivered = atomic_load_explicit(&midi->filter.delivered, memory_order_relaxed);
+    *filtered = atomic_load_explicit(&midi->filter.filtered, memory_order_relaxed);
+}
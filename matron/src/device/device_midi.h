@@ -1,21 +1,85 @@
 #pragma once
 
 #include <alsa/asoundlib.h>
+#include <stdatomic.h>
 
 #include "device_common.h"
+#include "midi_out.h"
+
+#define DEV_MIDI_INPUT_BUFFER_SIZE 128
+// system exclusive messages are reassembled up to this size; larger messages are dropped
+#define DEV_MIDI_SYSEX_INITIAL_SIZE 256
+#define DEV_MIDI_SYSEX_MAX_SIZE 65536
+// one filter slot per channel message type (0x80-0xe0) and per system status (0xf0-0xff)
+#define DEV_MIDI_FILTER_SLOTS 23
+
+// growable buffer for reassembling system exclusive messages
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    // arrival time of the opening 0xf0
+    double timestamp;
+    bool overflow;
+    // message is being skipped by the input filter
+    bool discard;
+} midi_sysex_buf_t;
+
+// input filter, set from lua and applied on the reactor thread before events are posted
+typedef struct {
+    // for channel message types, a mask of channels to drop (bit 0 = channel 1);
+    // for system statuses, any non-zero value drops the message
+    _Atomic uint16_t masks[DEV_MIDI_FILTER_SLOTS];
+    _Atomic uint64_t delivered;
+    _Atomic uint64_t filtered;
+} midi_input_filter_t;
+
+// input parser state, carried between reads
+typedef struct {
+    uint8_t buffer[DEV_MIDI_INPUT_BUFFER_SIZE];
+    // system time at which `buffer` was read
+    double timestamp;
+
+    uint8_t prior_status;
+    uint8_t prior_len;
+
+    uint8_t msg_buf[3];
+    uint8_t msg_pos;
+    uint8_t msg_len;
+    bool msg_started;
+    bool msg_sysex;
+    midi_sysex_buf_t sysex;
+} midi_input_state_t;
 
 struct dev_midi {
     struct dev_common dev;
     bool clock_enabled;
     snd_rawmidi_t *handle_in;
     snd_rawmidi_t *handle_out;
+    snd_rawmidi_status_t *status_in;
+    midi_input_state_t input;
+    midi_input_filter_t filter;
+    struct midi_out out;
 };
 
 extern unsigned int dev_midi_port_count(const char *path);
 
 extern int dev_midi_init(void *self, unsigned int port_index, bool multiport_device);
 extern int dev_midi_virtual_init(void *self);
+// software device fed by a generator; output loops back into its input (see device_loopback.h)
+extern int dev_midi_loopback_init(void *self);
 
 extern void dev_midi_deinit(void *self);
-extern void *dev_midi_start(void *self);
+extern int dev_midi_input_fd(void *self);
+extern void dev_midi_handle_input(void *self, uint32_t events);
+// queue bytes for immediate output; never blocks on the device
 extern ssize_t dev_midi_send(void *self, uint8_t *data, size_t n);
+// queue bytes for output at a future clock time (seconds) or beat
+extern ssize_t dev_midi_send_at(void *self, midi_out_stamp_t type, double stamp, uint8_t *data, size_t n);
+// discard all scheduled output
+extern void dev_midi_clear_scheduled(void *self);
+// drop input with the given status; for channel messages, on the channels set in channel_mask.
+// a zero mask lets the status through again. clock messages still drive clock sync when dropped.
+extern void dev_midi_set_filter(void *self, uint8_t status, uint16_t channel_mask);
+extern void dev_midi_clear_filters(void *self);
+extern void dev_midi_filter_stats(void *self, uint64_t *delivered, uint64_t *filtered);
@@ -8,9 +8,8 @@
 #include <fnmatch.h>
 #include <libudev.h>
 #include <locale.h>
-#include <poll.h>
-#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,12 +19,12 @@
 #include "device_hid.h"
 #include "device_list.h"
 #include "device_monome.h"
+#include "device_reactor.h"
 
 #include "events.h"
 
 #define SUB_NAME_SIZE 32
 #define NODE_NAME_SIZE 128
-#define WATCH_TIMEOUT_MS 100
 
 // enumerate unix files to watch
 enum {
@@ -43,10 +42,8 @@ static const char *dev_file_name[] = {"tty", "input", "sound", "none"};
 //-------------------------
 //----- static variables
 
-// file descriptors to watch/poll
-struct pollfd pfds[DEV_FILE_COUNT];
-// thread for polling all the watched file descriptors
-pthread_t watch_tid;
+// udev monitor watches, serviced by the device reactor
+static struct dev_reactor_source *watch_sources[DEV_FILE_COUNT];
 
 //--------------------------------
 //--- static function declarations
@@ -61,7 +58,7 @@ static void add_dev_sound(struct udev_device *dev);
 static int is_dev_monome_grid(struct udev_device *dev);
 static int is_dev_crow(struct udev_device *dev);
 
-static void *watch_loop(void *data);
+static void handle_watch(void *ctx, uint32_t events);
 
 // try to get MIDI device name from ALSA
 // returns a newly-allocated string (may be NULL)
@@ -79,14 +76,13 @@ static inline void print_watch_error(const char *msg, int file_idx) {
 //---- extern function definitions
 void dev_monitor_init(void) {
     struct udev *udev = NULL;
-    pthread_attr_t attr;
-    int s;
 
     udev = udev_new();
     assert(udev);
 
     for (int fidx = 0; fidx < DEV_FILE_COUNT; ++fidx) {
         mon[fidx] = NULL;
+        watch_sources[fidx] = NULL;
         struct udev_monitor *m = udev_monitor_new_from_netlink(udev, "udev");
         if (m == NULL) {
             print_watch_error("couldn't create udev monitor", fidx);
@@ -100,24 +96,19 @@ void dev_monitor_init(void) {
             print_watch_error("failed to enable monitor", fidx);
             continue;
         }
-        pfds[fidx].fd = udev_monitor_get_fd(m);
-        pfds[fidx].events = POLLIN;
         mon[fidx] = m;
+        watch_sources[fidx] = dev_reactor_add(udev_monitor_get_fd(m), &handle_watch, (void *)(intptr_t)fidx);
+        if (watch_sources[fidx] == NULL) {
+            print_watch_error("failed to watch monitor", fidx);
+        }
     }
-
-    s = pthread_attr_init(&attr);
-    if (s) {
-        fprintf(stderr, "error initializing thread attributes\n");
-    }
-    s = pthread_create(&watch_tid, &attr, watch_loop, NULL);
-    if (s) {
-        fprintf(stderr, "error creating thread\n");
-    }
-    pthread_attr_destroy(&attr);
 }
 
 void dev_monitor_deinit(void) {
-    pthread_cancel(watch_tid);
+    for (int fidx = 0; fidx < DEV_FILE_COUNT; ++fidx) {
+        dev_reactor_remove(watch_sources[fidx]);
+        watch_sources[fidx] = NULL;
+    }
     for (int fidx = 0; fidx < DEV_FILE_COUNT; ++fidx) {
         if (mon[fidx] != NULL) {
             free(mon[fidx]);
@@ -166,42 +157,26 @@ int dev_monitor_scan(void) {
 //-------------------------------
 //--- static function definitions
 
-void *watch_loop(void *p) {
-    (void)p;
+void handle_watch(void *ctx, uint32_t events) {
+    (void)events;
+    int fidx = (int)(intptr_t)ctx;
     struct udev_device *dev;
 
-    while (1) {
-        if (poll(pfds, DEV_FILE_COUNT, WATCH_TIMEOUT_MS) < 0) {
-            switch (errno) {
-            case EINVAL:
-                perror("error in poll()");
-                exit(1);
-            case EINTR:
-            case EAGAIN:
-                continue;
-            }
-        }
-
-        for (int fidx = 0; fidx < DEV_FILE_COUNT; ++fidx) {
-            if (pfds[fidx].revents & POLLIN) {
-                dev = udev_monitor_receive_device(mon[fidx]);
-                if (dev) {
-                    const char *action = udev_device_get_action(dev);
-                    if (action != NULL) {
-                        if (strcmp(action, "remove") == 0) {
-                            rm_dev(dev, fidx);
-                        } else {
-                            add_dev(dev, fidx);
-                        }
-                    } else {
-                        fprintf(stderr, "dev_monitor error: unknown device action\n");
-                    }
-                    udev_device_unref(dev);
-                } else {
-                    fprintf(stderr, "dev_monitor error: no device data\n");
-                }
+    dev = udev_monitor_receive_device(mon[fidx]);
+    if (dev) {
+        const char *action = udev_device_get_action(dev);
+        if (action != NULL) {
+            if (strcmp(action, "remove") == 0) {
+                rm_dev(dev, fidx);
+            } else {
+                add_dev(dev, fidx);
             }
+        } else {
+            fprintf(stderr, "dev_monitor error: unknown device action\n");
         }
+        udev_device_unref(dev);
+    } else {
+        fprintf(stderr, "dev_monitor error: no device data\n");
     }
 }
 
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <errno.h>
 #include <monome.h>
 #include <pthread.h>
 #include <search.h>
@@ -7,11 +8,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "../args.h"
 #include "../events.h"
 
 #include "device.h"
+#include "device_loopback.h"
 #include "device_monome.h"
 
 // quad offset defaults
@@ -26,6 +30,8 @@ static void dev_monome_handle_encoder_delta(const monome_event_t *e, void *p);
 static void dev_monome_handle_encoder_press(const monome_event_t *e, void *p);
 static void dev_monome_handle_encoder_lift(const monome_event_t *e, void *p);
 static void dev_monome_handle_tilt(const monome_event_t *e, void *p);
+static int dev_monome_refresher_start(struct dev_monome *md);
+static void dev_monome_refresher_stop(struct dev_monome *md);
 
 //-------------------------
 //--- monome device class
@@ -83,12 +89,118 @@ int dev_monome_init(void *self) {
     serial = monome_get_serial(m);
     base->serial = strdup(serial);
 
-    base->start = &dev_monome_start;
+    base->input_fd = &dev_monome_input_fd;
+    base->handle_input = &dev_monome_handle_input;
     base->deinit = &dev_monome_deinit;
 
+    if (dev_monome_refresher_start(md) < 0) {
+        monome_close(m);
+        md->m = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+// record written into a loopback device's input pipe
+struct dev_monome_loopback_msg {
+    uint8_t type; // monome_event_type_t
+    uint8_t a;    // grid x, or encoder number
+    uint8_t b;    // grid y
+    int8_t delta; // encoder delta
+};
+
+// press and lift every key of a 16x16 grid in turn
+static size_t dev_monome_loopback_generate_grid(uint64_t step, uint8_t *buf) {
+    struct dev_monome_loopback_msg *msg = (struct dev_monome_loopback_msg *)buf;
+    uint8_t key = (step / 2) % 256;
+    msg->type = step % 2 ? MONOME_BUTTON_UP : MONOME_BUTTON_DOWN;
+    msg->a = key % 16;
+    msg->b = key / 16;
+    msg->delta = 0;
+    return sizeof(struct dev_monome_loopback_msg);
+}
+
+// turn each of four encoders back and forth
+static size_t dev_monome_loopback_generate_arc(uint64_t step, uint8_t *buf) {
+    struct dev_monome_loopback_msg *msg = (struct dev_monome_loopback_msg *)buf;
+    msg->type = MONOME_ENCODER_DELTA;
+    msg->a = step % 4;
+    msg->b = 0;
+    msg->delta = (step / 256) % 2 ? -1 : 1;
+    return sizeof(struct dev_monome_loopback_msg);
+}
+
+// a 16x16 grid, or an arc if the path says so; leds are diffed and discarded
+int dev_monome_loopback_init(void *self) {
+    struct dev_monome *md = (struct dev_monome *)self;
+    struct dev_common *base = (struct dev_common *)self;
+    bool arc = strstr(base->path, "arc") != NULL;
+
+    md->m = NULL;
+    memset(md->data, 0, sizeof(md->data));
+    memset(md->dirty, 0, sizeof(md->dirty));
+
+    md->type = arc ? DEVICE_MONOME_TYPE_ARC : DEVICE_MONOME_TYPE_GRID;
+    md->rows = arc ? 0 : 16;
+    md->cols = arc ? 0 : 16;
+    md->quads = 4;
+    memcpy(md->quad_xoff, quad_xoff, sizeof(quad_xoff));
+    memcpy(md->quad_yoff, quad_yoff, sizeof(quad_yoff));
+
+    base->loopback = dev_loopback_new(arc ? &dev_monome_loopback_generate_arc : &dev_monome_loopback_generate_grid);
+    if (base->loopback == NULL) {
+        return -1;
+    }
+    base->serial = strdup("loopback");
+
+    base->input_fd = &dev_monome_input_fd;
+    base->handle_input = &dev_monome_handle_input;
+    base->deinit = &dev_monome_deinit;
+
+    if (dev_monome_refresher_start(md) < 0) {
+        dev_loopback_free(base->loopback);
+        base->loopback = NULL;
+        return -1;
+    }
+
     return 0;
 }
 
+static void dev_monome_loopback_handle_input(struct dev_monome *md) {
+    struct dev_monome_loopback_msg msgs[64];
+    monome_event_t e;
+
+    ssize_t n = read(md->dev.loopback->fds[0], msgs, sizeof(msgs));
+    if (n <= 0) {
+        return;
+    }
+
+    memset(&e, 0, sizeof(e));
+    for (size_t i = 0; i < n / sizeof(struct dev_monome_loopback_msg); i++) {
+        e.event_type = msgs[i].type;
+        switch (msgs[i].type) {
+        case MONOME_BUTTON_DOWN:
+            e.grid.x = msgs[i].a;
+            e.grid.y = msgs[i].b;
+            dev_monome_handle_press(&e, md);
+            break;
+        case MONOME_BUTTON_UP:
+            e.grid.x = msgs[i].a;
+            e.grid.y = msgs[i].b;
+            dev_monome_handle_lift(&e, md);
+            break;
+        case MONOME_ENCODER_DELTA:
+            e.encoder.number = msgs[i].a;
+            e.encoder.delta = msgs[i].delta;
+            dev_monome_handle_encoder_delta(&e, md);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
 // calculate quadrant number given x/y
 static inline uint8_t dev_monome_quad_idx(uint8_t x, uint8_t y) {
     return ((y > 7) << 1) | (x > 7);
@@ -100,6 +212,10 @@ static inline uint8_t dev_monome_quad_offset(uint8_t x, uint8_t y) {
 
 // set grid rotation
 void dev_monome_set_rotation(struct dev_monome *md, uint8_t rotation) {
+    struct dev_monome_refresher *r = &md->refresher;
+
+    pthread_mutex_lock(&r->write_lock);
+    pthread_mutex_lock(&r->lock);
     // for 16x8 grid, only update relevant quads which must change with rotation
     if (md->quads == 2) {
         if (rotation == 0 || rotation == 2) {
@@ -110,15 +226,31 @@ void dev_monome_set_rotation(struct dev_monome *md, uint8_t rotation) {
             md->quad_yoff[1] = 8;
         }
     }
-    monome_set_rotation(md->m, rotation);
+    // what the device shows no longer matches what was sent
+    r->resend = true;
+    pthread_mutex_unlock(&r->lock);
+    if (md->m != NULL) {
+        monome_set_rotation(md->m, rotation);
+    }
+    pthread_mutex_unlock(&r->write_lock);
 }
 
 // enable/disable grid tilt
 void dev_monome_tilt_enable(struct dev_monome *md, uint8_t sensor) {
+    if (md->m == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&md->refresher.write_lock);
     monome_tilt_enable(md->m, sensor);
+    pthread_mutex_unlock(&md->refresher.write_lock);
 }
 void dev_monome_tilt_disable(struct dev_monome *md, uint8_t sensor) {
+    if (md->m == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&md->refresher.write_lock);
     monome_tilt_disable(md->m, sensor);
+    pthread_mutex_unlock(&md->refresher.write_lock);
 }
 
 // set a given LED value
@@ -134,6 +266,59 @@ void dev_monome_arc_set_led(struct dev_monome *md, uint8_t n, uint8_t x, uint8_t
     md->dirty[n & 3] = true;
 }
 
+void dev_monome_grid_set_region(struct dev_monome *md, int x, int y, int w, int h, const uint8_t *levels,
+                                size_t stride) {
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x + w > md->cols ? md->cols : x + w;
+    int y1 = y + h > md->rows ? md->rows : y + h;
+
+    // quads are 8x8 and at most 16x16 leds are addressable
+    if (x1 > 16) {
+        x1 = 16;
+    }
+    if (y1 > 16) {
+        y1 = 16;
+    }
+
+    for (int j = y0; j < y1; j++) {
+        const uint8_t *row = levels + (size_t)(j - y) * stride;
+        for (int i = x0; i < x1; i++) {
+            uint8_t level = row[i - x];
+            uint8_t q = dev_monome_quad_idx(i, j);
+            md->data[q][dev_monome_quad_offset(i, j)] = level > 15 ? 15 : level;
+            md->dirty[q] = true;
+        }
+    }
+}
+
+void dev_monome_arc_set_ring(struct dev_monome *md, uint8_t n, const uint8_t *levels, size_t count) {
+    uint8_t *ring = md->data[n & 3];
+    if (count > 64) {
+        count = 64;
+    }
+    for (size_t i = 0; i < count; i++) {
+        ring[i] = levels[i] > 15 ? 15 : levels[i];
+    }
+    md->dirty[n & 3] = true;
+}
+
+void dev_monome_arc_ring_range(struct dev_monome *md, uint8_t n, uint8_t x1, uint8_t x2, uint8_t val) {
+    uint8_t *ring = md->data[n & 3];
+    uint8_t x = x1 & 63;
+    if (val > 15) {
+        val = 15;
+    }
+    while (true) {
+        ring[x] = val;
+        if (x == (x2 & 63)) {
+            break;
+        }
+        x = (x + 1) & 63;
+    }
+    md->dirty[n & 3] = true;
+}
+
 // set all LEDs to value
 void dev_monome_all_led(struct dev_monome *md, uint8_t val) {
     for (uint8_t q = 0; q < md->quads; q++) {
@@ -144,29 +329,241 @@ void dev_monome_all_led(struct dev_monome *md, uint8_t val) {
     }
 }
 
-// transmit all dirty quads
+// hand all dirty quads to the refresh thread
 void dev_monome_refresh(struct dev_monome *md) {
-    if (md->m == NULL) {
+    struct dev_monome_refresher *r = &md->refresher;
+    bool any = false;
+
+    if (md->m == NULL && md->dev.loopback == NULL) {
         return;
     }
 
+    pthread_mutex_lock(&r->lock);
     for (int quad = 0; quad < md->quads; quad++) {
         if (md->dirty[quad]) {
-            if (md->type == DEVICE_MONOME_TYPE_ARC) {
-                monome_led_ring_map(md->m, quad, md->data[quad]);
-            } else {
-                monome_led_level_map(md->m, md->quad_xoff[quad], md->quad_yoff[quad], md->data[quad]);
-            }
+            memcpy(r->pending[quad], md->data[quad], 64);
             md->dirty[quad] = false;
+            any = true;
         }
     }
+    if (any) {
+        r->pending_any = true;
+        pthread_cond_signal(&r->cond);
+    }
+    pthread_mutex_unlock(&r->lock);
+}
+
+void dev_monome_set_refresh_rate(struct dev_monome *md, double fps) {
+    pthread_mutex_lock(&md->refresher.lock);
+    md->refresher.interval = fps > 0 ? 1.0 / fps : 0;
+    pthread_cond_signal(&md->refresher.cond);
+    pthread_mutex_unlock(&md->refresher.lock);
 }
 
 // intensity
 void dev_monome_intensity(struct dev_monome *md, uint8_t i) {
     if (i > 15)
         i = 15;
+    if (md->m == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&md->refresher.write_lock);
     monome_led_intensity(md->m, i);
+    pthread_mutex_unlock(&md->refresher.write_lock);
+}
+
+//--------------------
+//--- led refresh thread
+
+// sizes on the wire, used to pick the cheapest way to send a changed quad
+#define DEV_MONOME_MAP_MSG_BYTES 34
+#define DEV_MONOME_ROW_MSG_BYTES 8
+#define DEV_MONOME_RING_SET_MSG_BYTES 4
+
+static void dev_monome_deadline(struct timespec *ts, double seconds) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    long nsec = ts->tv_nsec + (long)(seconds * 1000000000);
+    ts->tv_sec += nsec / 1000000000;
+    ts->tv_nsec = nsec % 1000000000;
+}
+
+// send the LEDs of a grid quad that differ from `sent`, as a level map
+// or as individual rows or columns, whichever is fewer bytes
+static void dev_monome_send_grid_quad(struct dev_monome *md, int xoff, int yoff, const uint8_t *data,
+                                      uint8_t *sent, bool force) {
+    uint8_t rows = 0;
+    uint8_t cols = 0;
+
+    for (int i = 0; i < 64; i++) {
+        if (force || data[i] != sent[i]) {
+            rows |= 1 << (i >> 3);
+            cols |= 1 << (i & 7);
+        }
+    }
+    if (rows == 0) {
+        return;
+    }
+    if (md->m == NULL) {
+        // loopback; nothing to send to
+        memcpy(sent, data, 64);
+        return;
+    }
+
+    int nrows = __builtin_popcount(rows);
+    int ncols = __builtin_popcount(cols);
+
+    if (nrows <= ncols && nrows * DEV_MONOME_ROW_MSG_BYTES < DEV_MONOME_MAP_MSG_BYTES) {
+        for (int y = 0; y < 8; y++) {
+            if (rows & (1 << y)) {
+                monome_led_level_row(md->m, xoff, yoff + y, 8, data + y * 8);
+            }
+        }
+    } else if (ncols < nrows && ncols * DEV_MONOME_ROW_MSG_BYTES < DEV_MONOME_MAP_MSG_BYTES) {
+        uint8_t col[8];
+        for (int x = 0; x < 8; x++) {
+            if (cols & (1 << x)) {
+                for (int y = 0; y < 8; y++) {
+                    col[y] = data[y * 8 + x];
+                }
+                monome_led_level_col(md->m, xoff + x, yoff, 8, col);
+            }
+        }
+    } else {
+        monome_led_level_map(md->m, xoff, yoff, data);
+    }
+
+    memcpy(sent, data, 64);
+}
+
+// send the LEDs of an arc ring that differ from `sent`
+static void dev_monome_send_ring(struct dev_monome *md, int ring, const uint8_t *data, uint8_t *sent, bool force) {
+    int changed = 0;
+
+    for (int i = 0; i < 64; i++) {
+        changed += force || data[i] != sent[i];
+    }
+    if (changed == 0) {
+        return;
+    }
+    if (md->m == NULL) {
+        memcpy(sent, data, 64);
+        return;
+    }
+
+    if (changed * DEV_MONOME_RING_SET_MSG_BYTES < DEV_MONOME_MAP_MSG_BYTES) {
+        for (int i = 0; i < 64; i++) {
+            if (data[i] != sent[i]) {
+                monome_led_ring_set(md->m, ring, i, data[i]);
+            }
+        }
+    } else {
+        monome_led_ring_map(md->m, ring, data);
+    }
+
+    memcpy(sent, data, 64);
+}
+
+static void *dev_monome_refresh_run(void *p) {
+    struct dev_monome *md = (struct dev_monome *)p;
+    struct dev_monome_refresher *r = &md->refresher;
+    uint8_t frame[4][64];
+    uint8_t sent[4][64];
+    int xoff[4];
+    int yoff[4];
+    struct timespec next;
+
+    memset(sent, 0, sizeof(sent));
+
+    pthread_mutex_lock(&r->lock);
+
+    while (true) {
+        while (r->running && !r->pending_any) {
+            pthread_cond_wait(&r->cond, &r->lock);
+        }
+        if (!r->running) {
+            break;
+        }
+
+        // take the latest frame; anything refreshed while it is being sent is coalesced into the next one
+        memcpy(frame, r->pending, sizeof(frame));
+        memcpy(xoff, md->quad_xoff, sizeof(xoff));
+        memcpy(yoff, md->quad_yoff, sizeof(yoff));
+        bool force = r->resend;
+        r->pending_any = false;
+        r->resend = false;
+        double interval = r->interval;
+        pthread_mutex_unlock(&r->lock);
+
+        dev_monome_deadline(&next, interval);
+
+        pthread_mutex_lock(&r->write_lock);
+        for (int quad = 0; quad < md->quads; quad++) {
+            if (md->type == DEVICE_MONOME_TYPE_ARC) {
+                dev_monome_send_ring(md, quad, frame[quad], sent[quad], force);
+            } else {
+                dev_monome_send_grid_quad(md, xoff[quad], yoff[quad], frame[quad], sent[quad], force);
+            }
+        }
+        pthread_mutex_unlock(&r->write_lock);
+
+        pthread_mutex_lock(&r->lock);
+
+        // rate limit: hold further frames until the next slot
+        while (r->running) {
+            if (pthread_cond_timedwait(&r->cond, &r->lock, &next) == ETIMEDOUT) {
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&r->lock);
+
+    return NULL;
+}
+
+static int dev_monome_refresher_start(struct dev_monome *md) {
+    struct dev_monome_refresher *r = &md->refresher;
+    pthread_condattr_t cond_attr;
+    pthread_attr_t attr;
+
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_mutex_init(&r->write_lock, NULL);
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&r->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    memset(r->pending, 0, sizeof(r->pending));
+    r->pending_any = false;
+    r->resend = true;
+    r->interval = 1.0 / DEV_MONOME_DEFAULT_REFRESH_RATE;
+    r->running = true;
+
+    pthread_attr_init(&attr);
+    if (pthread_create(&r->tid, &attr, &dev_monome_refresh_run, md)) {
+        fprintf(stderr, "dev_monome: error creating refresh thread\n");
+        pthread_attr_destroy(&attr);
+        r->running = false;
+        return -1;
+    }
+    pthread_attr_destroy(&attr);
+
+    return 0;
+}
+
+static void dev_monome_refresher_stop(struct dev_monome *md) {
+    struct dev_monome_refresher *r = &md->refresher;
+
+    pthread_mutex_lock(&r->lock);
+    if (!r->running) {
+        pthread_mutex_unlock(&r->lock);
+        return;
+    }
+    r->running = false;
+    pthread_cond_signal(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+
+    pthread_join(r->tid, NULL);
 }
 
 //--------------------
@@ -229,20 +626,36 @@ void dev_monome_handle_encoder_lift(const monome_event_t *e, void *p) {
 }
 
 int dev_monome_grid_rows(struct dev_monome *md) {
-    return monome_get_rows(md->m);
+    return md->m != NULL ? monome_get_rows(md->m) : md->rows;
 }
 
 int dev_monome_grid_cols(struct dev_monome *md) {
-    return monome_get_cols(md->m);
+    return md->m != NULL ? monome_get_cols(md->m) : md->cols;
 }
 
-void *dev_monome_start(void *md) {
-    monome_event_loop(((struct dev_monome *)md)->m);
-    return NULL;
+int dev_monome_input_fd(void *md) {
+    struct dev_common *base = (struct dev_common *)md;
+    if (base->loopback != NULL) {
+        return base->loopback->fds[0];
+    }
+    return monome_get_fd(((struct dev_monome *)md)->m);
+}
+
+void dev_monome_handle_input(void *md, uint32_t events) {
+    (void)events;
+    if (((struct dev_common *)md)->loopback != NULL) {
+        dev_monome_loopback_handle_input(md);
+        return;
+    }
+    // same as one iteration of monome_event_loop(): dispatches to the registered handlers
+    monome_event_handle_next(((struct dev_monome *)md)->m);
 }
 
 void dev_monome_deinit(void *self) {
     struct dev_monome *md = (struct dev_monome *)self;
-    monome_close(md->m); // libmonome frees the monome_t pointer
+    dev_monome_refresher_stop(md);
+    if (md->m != NULL) {
+        monome_close(md->m); // libmonome frees the monome_t pointer
+    }
     md->m = NULL;
 }
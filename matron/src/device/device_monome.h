@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -12,6 +13,27 @@ typedef enum {
     DEVICE_MONOME_TYPE_ARC,
 } device_monome_type_t;
 
+// default limit on led updates sent to the device per second
+#define DEV_MONOME_DEFAULT_REFRESH_RATE 60
+
+// led frames handed from the lua thread to the device's refresh thread
+struct dev_monome_refresher {
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    // serializes writes to the device between the refresh thread and lua
+    pthread_mutex_t write_lock;
+    bool running;
+    // led state as of the latest dev_monome_refresh()
+    uint8_t pending[4][64];
+    // `pending` has changed since the refresh thread last took it
+    bool pending_any;
+    // device contents are unknown (on startup or after rotation); send every quad
+    bool resend;
+    // minimum time between frames, in seconds
+    double interval;
+};
+
 // monome device data structure.
 struct dev_monome {
     struct dev_common dev;
@@ -24,18 +46,29 @@ struct dev_monome {
     int quads;
     int quad_xoff[4];
     int quad_yoff[4];
+    struct dev_monome_refresher refresher;
 };
 
 // set a single grid led
 extern void dev_monome_grid_set_led(struct dev_monome *md, uint8_t x, uint8_t y, uint8_t val);
 // set a single arc led
 extern void dev_monome_arc_set_led(struct dev_monome *md, uint8_t n, uint8_t x, uint8_t val);
+// set a rectangle of grid leds from `levels`, one byte per led, rows `stride` bytes apart.
+// leds outside the grid are ignored.
+extern void dev_monome_grid_set_region(struct dev_monome *md, int x, int y, int w, int h, const uint8_t *levels,
+                                       size_t stride);
+// set leds of arc ring `n` from `levels`, starting at led 0
+extern void dev_monome_arc_set_ring(struct dev_monome *md, uint8_t n, const uint8_t *levels, size_t count);
+// set arc ring `n` leds from `x1` to `x2` inclusive, wrapping past led 63
+extern void dev_monome_arc_ring_range(struct dev_monome *md, uint8_t n, uint8_t x1, uint8_t x2, uint8_t val);
 // set all led
 extern void dev_monome_all_led(struct dev_monome *md, uint8_t val);
 // set all data for a quad
 extern void dev_monome_set_quad(struct dev_monome *md, uint8_t quad, uint8_t *data);
-// transmit data for all dirty quads
+// hand data for all dirty quads to the refresh thread; does not block on the device
 extern void dev_monome_refresh(struct dev_monome *md);
+// limit led updates to `fps` frames per second
+extern void dev_monome_set_refresh_rate(struct dev_monome *md, double fps);
 extern int dev_monome_grid_rows(struct dev_monome *md);
 extern int dev_monome_grid_cols(struct dev_monome *md);
 // intensity
@@ -50,6 +83,9 @@ extern void dev_monome_tilt_disable(struct dev_monome *md, uint8_t val);
 
 // device management
 extern int dev_monome_init(void *self);
+// software grid or arc fed by a generator (see device_loopback.h)
+extern int dev_monome_loopback_init(void *self);
 extern void dev_monome_deinit(void *self);
 
-extern void *dev_monome_start(void *self);
+extern int dev_monome_input_fd(void *self);
+extern void dev_monome_handle_input(void *self, uint32_t events);
@@ -0,0 +1,230 @@
+/*
+ * device_reactor.c
+ *
+ * single epoll loop servicing input from all devices and the device monitor.
+ *
+ * handlers run on the reactor thread with the reactor lock held, so removing
+ * a source from another thread waits for any handler in progress. sources are
+ * freed only after the epoll batch that might still refer to them is done.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "device_reactor.h"
+
+#define DEV_REACTOR_MAX_EVENTS 32
+
+struct dev_reactor_source {
+    int fd;
+    // still registered with epoll
+    bool watched;
+    // removed by the owner; pending release
+    bool removed;
+    dev_reactor_handler_t handler;
+    void *ctx;
+    struct dev_reactor_source *next_garbage;
+};
+
+static int reactor_epfd = -1;
+// wakes the reactor for shutdown
+static int reactor_wakefd = -1;
+static pthread_t reactor_tid;
+static pthread_mutex_t reactor_lock;
+static bool reactor_running = false;
+static struct dev_reactor_source *reactor_garbage = NULL;
+
+static void dev_reactor_unwatch(struct dev_reactor_source *src) {
+    if (src->watched) {
+        epoll_ctl(reactor_epfd, EPOLL_CTL_DEL, src->fd, NULL);
+        src->watched = false;
+    }
+}
+
+static void dev_reactor_collect_garbage(void) {
+    while (reactor_garbage != NULL) {
+        struct dev_reactor_source *src = reactor_garbage;
+        reactor_garbage = src->next_garbage;
+        free(src);
+    }
+}
+
+static void *dev_reactor_run(void *p) {
+    (void)p;
+    struct epoll_event events[DEV_REACTOR_MAX_EVENTS];
+
+    while (true) {
+        int n = epoll_wait(reactor_epfd, events, DEV_REACTOR_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("dev_reactor: epoll_wait");
+            break;
+        }
+
+        pthread_mutex_lock(&reactor_lock);
+
+        if (!reactor_running) {
+            pthread_mutex_unlock(&reactor_lock);
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            struct dev_reactor_source *src = events[i].data.ptr;
+            if (src == NULL || src->removed) {
+                continue;
+            }
+
+            src->handler(src->ctx, events[i].events);
+
+            if (!src->removed && (events[i].events & (EPOLLHUP | EPOLLERR))) {
+                // device is gone; stop polling it until its owner removes it
+                dev_reactor_unwatch(src);
+            }
+        }
+
+        dev_reactor_collect_garbage();
+
+        pthread_mutex_unlock(&reactor_lock);
+    }
+
+    return NULL;
+}
+
+//--------------------------------
+//---- extern function definitions
+
+int dev_reactor_init(void) {
+    pthread_mutexattr_t mutex_attr;
+    pthread_attr_t attr;
+    struct epoll_event ev;
+
+    // handlers may add or remove sources (e.g. the device monitor)
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&reactor_lock, &mutex_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+
+    reactor_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor_epfd < 0) {
+        fprintf(stderr, "dev_reactor: failed to create epoll instance (%s)\n", strerror(errno));
+        return -1;
+    }
+
+    reactor_wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (reactor_wakefd < 0) {
+        fprintf(stderr, "dev_reactor: failed to create eventfd (%s)\n", strerror(errno));
+        goto err_wakefd;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(reactor_epfd, EPOLL_CTL_ADD, reactor_wakefd, &ev) < 0) {
+        fprintf(stderr, "dev_reactor: failed to watch eventfd (%s)\n", strerror(errno));
+        goto err_thread;
+    }
+
+    reactor_running = true;
+
+    pthread_attr_init(&attr);
+    if (pthread_create(&reactor_tid, &attr, &dev_reactor_run, NULL)) {
+        fprintf(stderr, "dev_reactor: error creating thread\n");
+        pthread_attr_destroy(&attr);
+        reactor_running = false;
+        goto err_thread;
+    }
+    pthread_attr_destroy(&attr);
+
+    return 0;
+
+err_thread:
+    close(reactor_wakefd);
+    reactor_wakefd = -1;
+err_wakefd:
+    close(reactor_epfd);
+    reactor_epfd = -1;
+    return -1;
+}
+
+void dev_reactor_deinit(void) {
+    uint64_t one = 1;
+
+    if (!reactor_running) {
+        return;
+    }
+
+    pthread_mutex_lock(&reactor_lock);
+    reactor_running = false;
+    pthread_mutex_unlock(&reactor_lock);
+
+    if (write(reactor_wakefd, &one, sizeof(one)) < 0) {
+        fprintf(stderr, "dev_reactor: failed to wake reactor thread\n");
+    }
+    pthread_join(reactor_tid, NULL);
+
+    dev_reactor_collect_garbage();
+    close(reactor_wakefd);
+    close(reactor_epfd);
+    reactor_wakefd = -1;
+    reactor_epfd = -1;
+}
+
+struct dev_reactor_source *dev_reactor_add(int fd, dev_reactor_handler_t handler, void *ctx) {
+    struct epoll_event ev;
+    struct dev_reactor_source *src;
+
+    if (reactor_epfd < 0 || fd < 0) {
+        return NULL;
+    }
+
+    src = calloc(1, sizeof(struct dev_reactor_source));
+    if (src == NULL) {
+        return NULL;
+    }
+    src->fd = fd;
+    src->handler = handler;
+    src->ctx = ctx;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = src;
+
+    pthread_mutex_lock(&reactor_lock);
+    if (epoll_ctl(reactor_epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        pthread_mutex_unlock(&reactor_lock);
+        fprintf(stderr, "dev_reactor: failed to watch fd %d (%s)\n", fd, strerror(errno));
+        free(src);
+        return NULL;
+    }
+    src->watched = true;
+    pthread_mutex_unlock(&reactor_lock);
+
+    return src;
+}
+
+void dev_reactor_remove(struct dev_reactor_source *src) {
+    if (src == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&reactor_lock);
+    dev_reactor_unwatch(src);
+    src->removed = true;
+    if (reactor_running) {
+        // an epoll batch already in flight may still hold this pointer
+        src->next_garbage = reactor_garbage;
+        reactor_garbage = src;
+    } else {
+        free(src);
+    }
+    pthread_mutex_unlock(&reactor_lock);
+}
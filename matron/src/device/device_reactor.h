@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// called from the reactor thread when a watched file descriptor is ready.
+// `events` is the epoll event mask.
+typedef void (*dev_reactor_handler_t)(void *ctx, uint32_t events);
+
+struct dev_reactor_source;
+
+// start the reactor thread
+extern int dev_reactor_init(void);
+// stop the reactor thread; sources must already have been removed
+extern void dev_reactor_deinit(void);
+
+// watch `fd` for input and call `handler` with `ctx` whenever it is readable.
+// if the descriptor hangs up or errors, the handler is called once more and the fd is no longer watched.
+// returns NULL on failure.
+extern struct dev_reactor_source *dev_reactor_add(int fd, dev_reactor_handler_t handler, void *ctx);
+// stop watching a source. once this returns, its handler is not running and will not be called again.
+// safe to call from within a handler.
+extern void dev_reactor_remove(struct dev_reactor_source *src);
@@ -0,0 +1,380 @@
+/*
+ * midi_out.c
+ *
+ * timestamped MIDI output queue.
+ *
+ * each output-capable MIDI device owns a writer thread and two pending
+ * queues: one stamped in clock system time (seconds), one stamped in beats.
+ * beat-stamped messages are resolved against the current clock source when
+ * they come due, so tempo changes within the lookahead window are honored.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../clock.h"
+
+#include "midi_out.h"
+
+// number of due messages popped per lock acquisition
+#define MIDI_OUT_BATCH_SIZE 32
+// while beat-stamped messages are pending, re-evaluate tempo at least this often
+#define MIDI_OUT_BEAT_RECHECK_SEC 0.002
+
+//--------------------
+//--- message helpers
+
+static inline const uint8_t *midi_out_msg_data(const struct midi_out_msg *msg) {
+    return msg->ext != NULL ? msg->ext : msg->bytes;
+}
+
+static inline void midi_out_msg_free(struct midi_out_msg *msg) {
+    if (msg->ext != NULL) {
+        free(msg->ext);
+        msg->ext = NULL;
+    }
+}
+
+//-----------------
+//--- binary heap
+
+static inline bool midi_out_msg_before(const struct midi_out_msg *a, const struct midi_out_msg *b) {
+    if (a->stamp != b->stamp) {
+        return a->stamp < b->stamp;
+    }
+    return a->seq < b->seq;
+}
+
+static inline void midi_out_heap_swap(struct midi_out_heap *h, size_t i, size_t j) {
+    struct midi_out_msg tmp = h->msgs[i];
+    h->msgs[i] = h->msgs[j];
+    h->msgs[j] = tmp;
+}
+
+static bool midi_out_heap_push(struct midi_out_heap *h, const struct midi_out_msg *msg) {
+    if (h->size >= MIDI_OUT_QUEUE_SIZE) {
+        return false;
+    }
+
+    size_t i = h->size++;
+    h->msgs[i] = *msg;
+
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!midi_out_msg_before(&h->msgs[i], &h->msgs[parent])) {
+            break;
+        }
+        midi_out_heap_swap(h, i, parent);
+        i = parent;
+    }
+    return true;
+}
+
+static void midi_out_heap_pop(struct midi_out_heap *h, struct midi_out_msg *msg) {
+    *msg = h->msgs[0];
+    h->msgs[0] = h->msgs[--h->size];
+
+    size_t i = 0;
+    while (true) {
+        size_t l = 2 * i + 1;
+        size_t r = l + 1;
+        size_t min = i;
+        if (l < h->size && midi_out_msg_before(&h->msgs[l], &h->msgs[min])) {
+            min = l;
+        }
+        if (r < h->size && midi_out_msg_before(&h->msgs[r], &h->msgs[min])) {
+            min = r;
+        }
+        if (min == i) {
+            break;
+        }
+        midi_out_heap_swap(h, i, min);
+        i = min;
+    }
+}
+
+static void midi_out_heap_clear(struct midi_out_heap *h) {
+    for (size_t i = 0; i < h->size; i++) {
+        midi_out_msg_free(&h->msgs[i]);
+    }
+    h->size = 0;
+}
+
+//------------------
+//--- writer thread
+
+static void midi_out_write(struct midi_out *out, const struct midi_out_msg *msg) {
+    ssize_t res;
+    if (out->handle != NULL) {
+        res = snd_rawmidi_write(out->handle, midi_out_msg_data(msg), msg->nbytes);
+    } else {
+        res = write(out->fd, midi_out_msg_data(msg), msg->nbytes);
+        res = res < 0 ? -errno : res;
+    }
+    if (res < 0) {
+        fprintf(stderr, "midi_out: write failed (%s)\n", strerror(-res));
+    }
+}
+
+// absolute monotonic deadline `seconds` from now, for a timed wait
+static void midi_out_abstime(struct timespec *ts, double seconds) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    if (seconds <= 0) {
+        return;
+    }
+    long nsec = ts->tv_nsec + (long)((seconds - (time_t)seconds) * 1000000000);
+    ts->tv_sec += (time_t)seconds + nsec / 1000000000;
+    ts->tv_nsec = nsec % 1000000000;
+}
+
+// pop due messages into batch, returns count. call with lock held.
+// if nothing is due, *wait is set to the number of seconds until the next message (or -1 if idle)
+static size_t midi_out_collect(struct midi_out *out, struct midi_out_msg *batch, double *wait) {
+    struct midi_out_heap *tq = &out->time_queue;
+    struct midi_out_heap *bq = &out->beat_queue;
+    double now = clock_get_system_time();
+    double beat = 0;
+    double beat_sec = 0;
+    size_t n = 0;
+
+    if (bq->size > 0) {
+        beat = clock_get_beats();
+        double tempo = clock_get_tempo();
+        beat_sec = tempo > 0 ? 60.0 / tempo : 0;
+    }
+
+    while (n < MIDI_OUT_BATCH_SIZE) {
+        bool time_due = tq->size > 0 && tq->msgs[0].stamp <= now;
+        bool beat_due = bq->size > 0 && bq->msgs[0].stamp <= beat;
+
+        if (time_due && beat_due) {
+            // interleave by equivalent clock time
+            double beat_time = now - (beat - bq->msgs[0].stamp) * beat_sec;
+            if (tq->msgs[0].stamp <= beat_time) {
+                beat_due = false;
+            } else {
+                time_due = false;
+            }
+        }
+
+        if (time_due) {
+            midi_out_heap_pop(tq, &batch[n++]);
+        } else if (beat_due) {
+            midi_out_heap_pop(bq, &batch[n++]);
+        } else {
+            break;
+        }
+    }
+
+    if (n == 0) {
+        *wait = -1;
+        if (tq->size > 0) {
+            *wait = tq->msgs[0].stamp - now;
+        }
+        if (bq->size > 0) {
+            double beat_wait = MIDI_OUT_BEAT_RECHECK_SEC;
+            if (beat_sec > 0) {
+                beat_wait = (bq->msgs[0].stamp - beat) * beat_sec;
+                if (beat_wait > MIDI_OUT_BEAT_RECHECK_SEC) {
+                    beat_wait = MIDI_OUT_BEAT_RECHECK_SEC;
+                }
+            }
+            if (*wait < 0 || beat_wait < *wait) {
+                *wait = beat_wait;
+            }
+        }
+    }
+
+    return n;
+}
+
+static void *midi_out_thread_run(void *p) {
+    struct midi_out *out = (struct midi_out *)p;
+    struct midi_out_msg batch[MIDI_OUT_BATCH_SIZE];
+    struct timespec ts;
+    double wait;
+
+    pthread_mutex_lock(&out->lock);
+    while (out->running) {
+        size_t n = midi_out_collect(out, batch, &wait);
+
+        if (n > 0) {
+            // never hold the lock while the device is being written
+            pthread_mutex_unlock(&out->lock);
+            for (size_t i = 0; i < n; i++) {
+                midi_out_write(out, &batch[i]);
+                midi_out_msg_free(&batch[i]);
+            }
+            pthread_mutex_lock(&out->lock);
+            out->sent += n;
+        } else if (wait < 0) {
+            pthread_cond_wait(&out->cond, &out->lock);
+        } else {
+            midi_out_abstime(&ts, wait);
+            pthread_cond_timedwait(&out->cond, &out->lock, &ts);
+        }
+    }
+    pthread_mutex_unlock(&out->lock);
+
+    return NULL;
+}
+
+//-----------------------------
+//--- extern function definitions
+
+static int midi_out_start(struct midi_out *out) {
+    pthread_condattr_t cond_attr;
+    pthread_attr_t attr;
+    struct sched_param param;
+    int res;
+
+    out->seq = 0;
+    out->sent = 0;
+    out->dropped = 0;
+    out->time_queue.size = 0;
+    out->beat_queue.size = 0;
+    out->time_queue.msgs = calloc(MIDI_OUT_QUEUE_SIZE, sizeof(struct midi_out_msg));
+    out->beat_queue.msgs = calloc(MIDI_OUT_QUEUE_SIZE, sizeof(struct midi_out_msg));
+    if (out->time_queue.msgs == NULL || out->beat_queue.msgs == NULL) {
+        fprintf(stderr, "midi_out: failed to allocate output queues\n");
+        goto err_alloc;
+    }
+
+    pthread_mutex_init(&out->lock, NULL);
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&out->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    out->running = true;
+
+    // output timing is the point of this thread; ask for realtime priority,
+    // but carry on with default scheduling if that isn't permitted
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+    pthread_attr_setschedparam(&attr, &param);
+    res = pthread_create(&out->tid, &attr, &midi_out_thread_run, out);
+    pthread_attr_destroy(&attr);
+
+    if (res == EPERM) {
+        res = pthread_create(&out->tid, NULL, &midi_out_thread_run, out);
+    }
+    if (res != 0) {
+        fprintf(stderr, "midi_out: failed to create output thread (%s)\n", strerror(res));
+        pthread_cond_destroy(&out->cond);
+        pthread_mutex_destroy(&out->lock);
+        out->running = false;
+        goto err_alloc;
+    }
+
+    return 0;
+
+err_alloc:
+    free(out->time_queue.msgs);
+    free(out->beat_queue.msgs);
+    out->time_queue.msgs = NULL;
+    out->beat_queue.msgs = NULL;
+    return -1;
+}
+
+int midi_out_init(struct midi_out *out, snd_rawmidi_t *handle) {
+    out->handle = handle;
+    out->fd = -1;
+    return midi_out_start(out);
+}
+
+int midi_out_init_fd(struct midi_out *out, int fd) {
+    out->handle = NULL;
+    out->fd = fd;
+    return midi_out_start(out);
+}
+
+bool midi_out_started(const struct midi_out *out) {
+    return out->time_queue.msgs != NULL;
+}
+
+void midi_out_deinit(struct midi_out *out) {
+    if (!midi_out_started(out)) {
+        // never started
+        return;
+    }
+
+    pthread_mutex_lock(&out->lock);
+    out->running = false;
+    pthread_cond_signal(&out->cond);
+    pthread_mutex_unlock(&out->lock);
+    pthread_join(out->tid, NULL);
+
+    midi_out_heap_clear(&out->time_queue);
+    midi_out_heap_clear(&out->beat_queue);
+    free(out->time_queue.msgs);
+    free(out->beat_queue.msgs);
+    out->time_queue.msgs = NULL;
+    out->beat_queue.msgs = NULL;
+
+    pthread_cond_destroy(&out->cond);
+    pthread_mutex_destroy(&out->lock);
+}
+
+int midi_out_schedule(struct midi_out *out, midi_out_stamp_t type, double stamp, const uint8_t *data,
+                      size_t n) {
+    struct midi_out_msg msg;
+    bool ok;
+
+    if (out->time_queue.msgs == NULL || n == 0) {
+        return -1;
+    }
+
+    msg.stamp = stamp;
+    msg.nbytes = n;
+    msg.ext = NULL;
+    if (n > MIDI_OUT_INLINE_BYTES) {
+        msg.ext = malloc(n);
+        if (msg.ext == NULL) {
+            return -1;
+        }
+        memcpy(msg.ext, data, n);
+    } else {
+        memcpy(msg.bytes, data, n);
+    }
+
+    pthread_mutex_lock(&out->lock);
+    msg.seq = out->seq++;
+    if (type == MIDI_OUT_STAMP_BEAT) {
+        ok = midi_out_heap_push(&out->beat_queue, &msg);
+    } else {
+        ok = midi_out_heap_push(&out->time_queue, &msg);
+    }
+    if (ok) {
+        pthread_cond_signal(&out->cond);
+    } else {
+        out->dropped++;
+    }
+    pthread_mutex_unlock(&out->lock);
+
+    if (!ok) {
+        midi_out_msg_free(&msg);
+        return -1;
+    }
+    return 0;
+}
+
+int midi_out_send(struct midi_out *out, const uint8_t *data, size_t n) {
+    return midi_out_schedule(out, MIDI_OUT_STAMP_TIME, clock_get_system_time(), data, n);
+}
+
+void midi_out_clear(struct midi_out *out) {
+    if (out->time_queue.msgs == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&out->lock);
+    midi_out_heap_clear(&out->time_queue);
+    midi_out_heap_clear(&out->beat_queue);
+    pthread_mutex_unlock(&out->lock);
+}
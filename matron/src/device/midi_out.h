@@ -0,0 +1,73 @@
+#pragma once
+
+#include <alsa/asoundlib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// maximum number of pending messages per timestamp domain
+#define MIDI_OUT_QUEUE_SIZE 512
+// messages up to this size are stored without allocation
+#define MIDI_OUT_INLINE_BYTES 4
+
+// how a scheduled message timestamp is interpreted
+typedef enum {
+    // seconds, in the clock system time base (see clock_get_system_time())
+    MIDI_OUT_STAMP_TIME = 0,
+    // beats, in the current clock source
+    MIDI_OUT_STAMP_BEAT = 1,
+} midi_out_stamp_t;
+
+struct midi_out_msg {
+    double stamp;
+    uint64_t seq;
+    size_t nbytes;
+    // heap storage for messages larger than MIDI_OUT_INLINE_BYTES, else NULL
+    uint8_t *ext;
+    uint8_t bytes[MIDI_OUT_INLINE_BYTES];
+};
+
+// binary min-heap ordered by (stamp, seq)
+struct midi_out_heap {
+    struct midi_out_msg *msgs;
+    size_t size;
+};
+
+// per-device output scheduler.
+// messages are written to the device by a dedicated thread,
+// so callers never block on the rawmidi handle.
+struct midi_out {
+    snd_rawmidi_t *handle;
+    // written instead of `handle` when that is NULL (loopback devices)
+    int fd;
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool running;
+    uint64_t seq;
+    struct midi_out_heap time_queue;
+    struct midi_out_heap beat_queue;
+    // statistics
+    uint64_t sent;
+    uint64_t dropped;
+};
+
+// initialize the scheduler and start its output thread
+// returns 0 on success
+extern int midi_out_init(struct midi_out *out, snd_rawmidi_t *handle);
+// as above, writing to a file descriptor instead of a rawmidi handle
+extern int midi_out_init_fd(struct midi_out *out, int fd);
+// stop the output thread and release pending messages
+extern void midi_out_deinit(struct midi_out *out);
+// whether init succeeded, so messages can be queued
+extern bool midi_out_started(const struct midi_out *out);
+
+// queue a message for immediate transmission
+// returns 0 on success, -1 if the queue is full
+extern int midi_out_send(struct midi_out *out, const uint8_t *data, size_t n);
+// queue a message for transmission at a future time or beat
+// returns 0 on success, -1 if the queue is full
+extern int midi_out_schedule(struct midi_out *out, midi_out_stamp_t type, double stamp, const uint8_t *data,
+                             size_t n);
+// discard all pending messages
+extern void midi_out_clear(struct midi_out *out);
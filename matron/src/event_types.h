@@ -94,6 +94,12 @@ typedef enum {
     EVENT_GRID_TILT,
     // screen asynchronous results callbacks
     EVENT_SCREEN_REFRESH,
+    // clock lattice sprocket fired
+    EVENT_CLOCK_LATTICE,
+    // complete midi system exclusive message
+    EVENT_MIDI_SYSEX,
+    // hid input codes reported together, up to a SYN_REPORT
+    EVENT_HID_FRAME,
 } event_t;
 
 // a packed data structure for four volume levels
@@ -175,6 +181,19 @@ struct event_hid_event {
     int32_t value;
 }; // +8
 
+struct event_hid_frame_entry {
+    uint16_t type;
+    uint16_t code;
+    int32_t value;
+};
+
+struct event_hid_frame {
+    struct event_common common;
+    uint32_t id;
+    uint32_t count;
+    struct event_hid_frame_entry *entries;
+}; // +16
+
 struct event_midi_add {
     struct event_common common;
     void *dev;
@@ -190,15 +209,24 @@ struct event_midi_event {
     uint32_t id;
     uint8_t data[3];
     size_t nbytes;
-}; // +11
+    // system time at which the message was read from the device
+    double timestamp;
+}; // +19
+
+struct event_midi_sysex {
+    struct event_common common;
+    uint32_t id;
+    uint8_t *data;
+    size_t nbytes;
+    // system time at which the start of the message was read
+    double timestamp;
+}; // +20
 
 struct event_osc {
     struct event_common common;
-    char *path;
-    char *from_host;
-    char *from_port;
-    lo_message msg;
-}; // +16?
+    // owned; returned to the pool by event_data_free
+    struct osc_packet *packet;
+}; // +4
 
 struct event_metro {
     struct event_common common;
@@ -220,6 +248,15 @@ struct event_clock_stop {
     struct event_common common;
 }; // + 0
 
+struct event_clock_lattice {
+    struct event_common common;
+    uint32_t lattice;
+    uint32_t sprocket;
+    uint32_t transport;
+    // sprocket phase after firing, in pulses
+    double phase;
+}; // + 24
+
 struct event_key {
     struct event_common common;
     uint8_t n;
@@ -251,6 +288,7 @@ struct event_stat {
 struct event_enc {
     struct event_common common;
     uint8_t n;
+    // unused; the delta is collected from the encoder's accumulator (see encoders.h)
     int8_t delta;
 }; // +2
 
@@ -308,7 +346,9 @@ struct event_crow_event {
     struct event_common common;
     void *dev;
     uint8_t id;
-}; // +5
+    // one complete line, without its terminator
+    char *line;
+}; // +13
 
 struct event_system_cmd {
     struct event_common common;
@@ -352,9 +392,11 @@ union event_data {
     struct event_hid_add hid_add;
     struct event_hid_remove hid_remove;
     struct event_hid_event hid_event;
+    struct event_hid_frame hid_frame;
     struct event_midi_add midi_add;
     struct event_midi_remove midi_remove;
     struct event_midi_event midi_event;
+    struct event_midi_sysex midi_sysex;
     struct event_osc osc_event;
     struct event_key key;
     struct event_enc enc;
@@ -363,6 +405,7 @@ union event_data {
     struct event_stat stat;
     struct event_metro metro;
     struct event_clock_resume clock_resume;
+    struct event_clock_lattice clock_lattice;
     struct event_poll_value poll_value;
     struct event_poll_data poll_data;
     struct event_poll_io_levels poll_io_levels;
@@ -10,8 +10,10 @@
 
 #include "battery.h"
 #include "device_monome.h"
+#include "encoders.h"
 #include "events.h"
 #include "oracle.h"
+#include "osc_packet.h"
 #include "stat.h"
 #include "weaver.h"
 
@@ -117,10 +119,7 @@ MATRON_API void event_data_free(union event_data *ev) {
         free(ev->exec_code_line.line);
         break;
     case EVENT_OSC:
-        free(ev->osc_event.path);
-        free(ev->osc_event.from_host);
-        free(ev->osc_event.from_port);
-        lo_message_free(ev->osc_event.msg);
+        osc_packet_free(ev->osc_event.packet);
         break;
     case EVENT_POLL_DATA:
         free(ev->poll_data.data);
@@ -134,6 +133,15 @@ MATRON_API void event_data_free(union event_data *ev) {
     case EVENT_SOFTCUT_RENDER:
         free(ev->softcut_render.data);
         break;
+    case EVENT_MIDI_SYSEX:
+        free(ev->midi_sysex.data);
+        break;
+    case EVENT_CROW_EVENT:
+        free(ev->crow_event.line);
+        break;
+    case EVENT_HID_FRAME:
+        free(ev->hid_frame.entries);
+        break;
     case EVENT_CUSTOM:
         if (ev->custom.ops->free) {
             ev->custom.ops->free(ev->custom.value, ev->custom.context);
@@ -200,12 +208,21 @@ static void handle_event(union event_data *ev) {
     case EVENT_CLOCK_STOP:
         w_handle_clock_stop();
         break;
+    case EVENT_CLOCK_LATTICE:
+        w_handle_clock_lattice(ev->clock_lattice.lattice, ev->clock_lattice.sprocket, ev->clock_lattice.transport,
+                               ev->clock_lattice.phase);
+        break;
     case EVENT_KEY:
         w_handle_key(ev->key.n, ev->key.val);
         break;
-    case EVENT_ENC:
-        w_handle_enc(ev->enc.n, ev->enc.delta);
+    case EVENT_ENC: {
+        // everything accumulated since the event was posted; may be zero if an earlier event took it
+        int delta = encoders_collect(ev->enc.n);
+        if (delta != 0) {
+            w_handle_enc(ev->enc.n, delta);
+        }
         break;
+    }
     case EVENT_BATTERY:
         w_handle_battery(ev->battery.percent, ev->battery.current);
         break;
@@ -243,6 +260,9 @@ static void handle_event(union event_data *ev) {
     case EVENT_HID_EVENT:
         w_handle_hid_event(ev->hid_event.id, ev->hid_event.type, ev->hid_event.code, ev->hid_event.value);
         break;
+    case EVENT_HID_FRAME:
+        w_handle_hid_frame(ev->hid_frame.id, ev->hid_frame.entries, ev->hid_frame.count);
+        break;
     case EVENT_MIDI_ADD:
         w_handle_midi_add(ev->midi_add.dev);
         break;
@@ -250,10 +270,14 @@ static void handle_event(union event_data *ev) {
         w_handle_midi_remove(ev->midi_remove.id);
         break;
     case EVENT_MIDI_EVENT:
-        w_handle_midi_event(ev->midi_event.id, ev->midi_event.data, ev->midi_event.nbytes);
+        w_handle_midi_event(ev->midi_event.id, ev->midi_event.data, ev->midi_event.nbytes, ev->midi_event.timestamp);
+        break;
+    case EVENT_MIDI_SYSEX:
+        w_handle_midi_sysex(ev->midi_sysex.id, ev->midi_sysex.data, ev->midi_sysex.nbytes,
+                            ev->midi_sysex.timestamp);
         break;
     case EVENT_OSC:
-        w_handle_osc_event(ev->osc_event.from_host, ev->osc_event.from_port, ev->osc_event.path, ev->osc_event.msg);
+        w_handle_osc_event(ev->osc_event.packet);
         break;
     case EVENT_ENGINE_REPORT:
         handle_engine_report();
@@ -292,7 +316,7 @@ static void handle_event(union event_data *ev) {
         w_handle_crow_remove(ev->crow_remove.id);
         break;
     case EVENT_CROW_EVENT:
-        w_handle_crow_event(ev->crow_event.dev, ev->crow_event.id);
+        w_handle_crow_event(ev->crow_event.dev, ev->crow_event.id, ev->crow_event.line);
         break;
     case EVENT_SOFTCUT_RENDER:
         w_handle_softcut_render(ev->softcut_render.idx, ev->softcut_render.sec_per_sample, ev->softcut_render.start,
@@ -310,6 +334,10 @@ static void handle_event(union event_data *ev) {
     } /* switch */
 
     event_data_free(ev);
+    // engine commands issued while handling the event go out together
+    o_flush_commands();
+    // nothing on this thread refers to engine command descriptors now
+    o_release_command_tables();
 }
 
 //---------------------------------
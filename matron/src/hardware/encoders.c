@@ -0,0 +1,91 @@
+/*
+ * encoders.c
+ *
+ * per-encoder delta accumulation and acceleration, shared by the input drivers
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "encoders.h"
+#include "events.h"
+
+struct encoder {
+    // detents not yet collected by the event loop
+    _Atomic int delta;
+    // an EVENT_ENC for this encoder is queued and has not been collected
+    atomic_bool pending;
+    // acceleration is on unless a script turns it off
+    atomic_bool no_accel;
+    // time of the previous detent; only touched by the encoder's own driver thread
+    int64_t last_usec;
+};
+
+static struct encoder encoders[ENCODERS_MAX];
+
+static inline bool encoders_valid(int n) {
+    return n >= 0 && n < ENCODERS_MAX;
+}
+
+void encoders_post(int n, int delta) {
+    if (!encoders_valid(n) || delta == 0) {
+        return;
+    }
+    struct encoder *enc = &encoders[n];
+
+    atomic_fetch_add(&enc->delta, delta);
+    // one event in the queue per encoder is enough; it collects whatever has accumulated by then
+    if (!atomic_exchange(&enc->pending, true)) {
+        union event_data *ev = event_data_new(EVENT_ENC);
+        ev->enc.n = n;
+        event_post(ev);
+    }
+}
+
+int encoders_collect(int n) {
+    if (!encoders_valid(n)) {
+        return 0;
+    }
+    struct encoder *enc = &encoders[n];
+
+    // clear the flag first: a detent landing after this posts a fresh event, so none is lost
+    atomic_store(&enc->pending, false);
+    return atomic_exchange(&enc->delta, 0);
+}
+
+int encoders_accelerate(int n, int delta, int64_t usec) {
+    if (!encoders_valid(n)) {
+        return delta;
+    }
+    struct encoder *enc = &encoders[n];
+
+    int64_t diff = usec - enc->last_usec;
+    enc->last_usec = usec;
+    if (atomic_load(&enc->no_accel) || diff < 0) {
+        return delta;
+    }
+
+    if (diff < 5000) {
+        return delta * 6;
+    } else if (diff < 10000) {
+        return delta * 4;
+    } else if (diff < 20000) {
+        return delta * 3;
+    } else if (diff < 30000) {
+        return delta * 2;
+    }
+    return delta;
+}
+
+void encoders_set_accel(int n, bool enabled) {
+    if (n == 0) {
+        for (int i = 0; i < ENCODERS_MAX; i++) {
+            atomic_store(&encoders[i].no_accel, !enabled);
+        }
+    } else if (encoders_valid(n)) {
+        atomic_store(&encoders[n].no_accel, !enabled);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// encoder deltas are accumulated per encoder by the input drivers and collected by the
+// event loop, so a burst of detents reaches lua as one EVENT_ENC with the summed delta.
+// encoder numbers are those used by the drivers (1-3 on norns); 0 is valid for other inputs.
+#define ENCODERS_MAX 8
+
+// add `delta` to encoder `n`; posts an EVENT_ENC unless one is already pending.
+// safe to call from any thread.
+extern void encoders_post(int n, int delta);
+// take the delta accumulated on encoder `n` since the last collect; called from the event loop
+extern int encoders_collect(int n);
+
+// velocity-based acceleration, applied by drivers that report discrete detents.
+// `usec` is the time of the detent; returns the scaled delta. on by default.
+extern int encoders_accelerate(int n, int delta, int64_t usec);
+// n == 0 sets all encoders
+extern void encoders_set_accel(int n, bool enabled);
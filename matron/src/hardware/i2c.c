@@ -18,6 +18,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "encoders.h"
 #include "events.h"
 #include "i2c.h"
 #include "platform.h"
@@ -35,8 +36,12 @@ static pthread_t p;
 
 static int pos[3] = {0, 0, 0};
 #define DIV 64
-#define ADC_RATE 75000
+// poll interval (us) while any encoder is turning, and while all are still.
 // adc rate ~12 * 6ch
+#define ADC_RATE_ACTIVE 25000
+#define ADC_RATE_IDLE 75000
+// polls without movement before dropping back to the idle rate
+#define ADC_IDLE_POLLS 20
 
 // adc revision
 // 0 = none
@@ -201,6 +206,8 @@ void *adc_read(void *x) {
         pos[i] = (int)4096 * angle_360((float)now[i * 2] / 4096, (float)now[i * 2 + 1] / 4096);
     }
 
+    int quiet = ADC_IDLE_POLLS;
+
     while (1) {
         if (ioctl(file, I2C_SLAVE, ADDR_ADC) < 0) {
             fprintf(stderr, "(i2c) ADC connect fail\n");
@@ -229,15 +236,24 @@ void *adc_read(void *x) {
             }
 
             if (abs(d) > DIV) {
-                pos[i] = n;
-                d = (int)(d / DIV);
-                // fprintf(stderr, "%d\t%d\t%d%\n",reorder[i],n,d);
-                union event_data *ev = event_data_new(EVENT_ENC);
-                ev->enc.n = reorder[i];
-                ev->enc.delta = d;
-                event_post(ev);
+                // keep the remainder, so slow turns at the fast rate aren't lost to rounding
+                int steps = d / DIV;
+                pos[i] -= steps * DIV;
+                if (pos[i] < 0) {
+                    pos[i] += 4096;
+                } else if (pos[i] >= 4096) {
+                    pos[i] -= 4096;
+                }
+                // fprintf(stderr, "%d\t%d\t%d%\n",reorder[i],n,steps);
+                encoders_post(reorder[i], steps);
+                quiet = 0;
             }
         }
-        usleep(ADC_RATE);
+        if (quiet < ADC_IDLE_POLLS) {
+            quiet++;
+            usleep(ADC_RATE_ACTIVE);
+        } else {
+            usleep(ADC_RATE_IDLE);
+        }
     }
 }
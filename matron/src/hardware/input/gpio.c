@@ -7,6 +7,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "encoders.h"
 #include "events.h"
 #include "hardware/input.h"
 #include "hardware/io.h"
@@ -140,10 +141,9 @@ void *enc_gpio_poll(void *data) {
                         diff > 500) { // only reverse direction if there is reasonable settling time
                         dir[i] = event[i].value;
                     }
-                    union event_data *ev = event_data_new(EVENT_ENC);
-                    ev->enc.n = priv->index;
-                    ev->enc.delta = event[i].value;
-                    event_post(ev);
+                    // use the kernel's timestamp: detents read in one batch keep their own spacing
+                    int64_t usec = (int64_t)event[i].time.tv_sec * 1000000 + event[i].time.tv_usec;
+                    encoders_post(priv->index, encoders_accelerate(priv->index, event[i].value, usec));
                 }
             }
         }
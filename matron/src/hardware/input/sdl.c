@@ -1,5 +1,6 @@
 #include <SDL2/SDL.h>
 
+#include "encoders.h"
 #include "event_types.h"
 #include "events.h"
 #include "hardware/input.h"
@@ -74,40 +75,22 @@ static void *input_sdl_poll(void *data) {
                         event_post(ev);
                         break;
                     case SDL_SCANCODE_W:
-                        ev = event_data_new(EVENT_ENC);
-                        ev->enc.n = 0;
-                        ev->enc.delta = -1;
-                        event_post(ev);
+                        encoders_post(0, -1);
                         break;
                     case SDL_SCANCODE_E:
-                        ev = event_data_new(EVENT_ENC);
-                        ev->enc.n = 0;
-                        ev->enc.delta = 1;
-                        event_post(ev);
+                        encoders_post(0, 1);
                         break;
                     case SDL_SCANCODE_S:
-                        ev = event_data_new(EVENT_ENC);
-                        ev->enc.n = 1;
-                        ev->enc.delta = -1;
-                        event_post(ev);
+                        encoders_post(1, -1);
                         break;
                     case SDL_SCANCODE_D:
-                        ev = event_data_new(EVENT_ENC);
-                        ev->enc.n = 1;
-                        ev->enc.delta = 1;
-                        event_post(ev);
+                        encoders_post(1, 1);
                         break;
                     case SDL_SCANCODE_X:
-                        ev = event_data_new(EVENT_ENC);
-                        ev->enc.n = 2;
-                        ev->enc.delta = -1;
-                        event_post(ev);
+                        encoders_post(2, -1);
                         break;
                     case SDL_SCANCODE_C:
-                        ev = event_data_new(EVENT_ENC);
-                        ev->enc.n = 2;
-                        ev->enc.delta = 1;
-                        event_post(ev);
+                        encoders_post(2, 1);
                         break;
                     default:
                         break;
@@ -20,6 +20,7 @@
 #include "device_midi.h"
 #include "device_monitor.h"
 #include "device_monome.h"
+#include "device_reactor.h"
 #include "events.h"
 #include "hardware/screen/ssd1322.h"
 #include "hello.h"
@@ -41,6 +42,7 @@ void print_version(void);
 
 void cleanup(void) {
     dev_monitor_deinit();
+    dev_reactor_deinit();
     osc_deinit();
     o_deinit();
     w_deinit();
@@ -90,6 +92,7 @@ int main(int argc, char **argv) {
     fprintf(stderr, "init weaver...\n");
     w_init(); // weaver (scripting)
 
+    dev_reactor_init();
     dev_list_init();
     dev_list_add(DEV_TYPE_MIDI_VIRTUAL, NULL, "virtual");
 
@@ -5,30 +5,69 @@
  *
  * user should not care about the method (IPC or otherwise.)
  *
- * for now, we will use OSC with liblo.
+ * for now, we will use OSC with liblo. packets to and from crone go through shared memory
+ * when it's available (see crone_shm.c), and over UDP otherwise.
  *
  */
 
+#include <arpa/inet.h>
 #include <assert.h>
+#include <errno.h>
+#include <netdb.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include <lo/lo.h>
 
 #include "args.h"
+#include "crone_shm.h"
 #include "events.h"
 #include "hello.h"
 #include "oracle.h"
 
 // address of external DSP environment (e.g. supercollider)
 static lo_address ext_addr;
+// send to the external environment with lo_send-style arguments, from the engine command socket
+#define ext_send(path, ...)                                                                                            \
+    do {                                                                                                               \
+        lo_message ext_msg = lo_message_new();                                                                         \
+        lo_message_add(ext_msg, __VA_ARGS__);                                                                          \
+        ext_send_message(path, ext_msg);                                                                               \
+        lo_message_free(ext_msg);                                                                                      \
+    } while (0)
+static void ext_send_message(const char *path, lo_message msg);
 // address of crone process
 static lo_address crone_addr;
 
+// send to crone with lo_send-style arguments, over the shared-memory link if it's up
+#define crone_send(path, ...)                                                                                          \
+    do {                                                                                                               \
+        lo_message crone_msg = lo_message_new();                                                                       \
+        lo_message_add(crone_msg, __VA_ARGS__);                                                                        \
+        crone_send_message(path, crone_msg);                                                                           \
+        lo_message_free(crone_msg);                                                                                    \
+    } while (0)
+
+static void crone_send_message(const char *path, lo_message msg) {
+    if (!crone_shm_send(path, msg)) {
+        lo_send_message(crone_addr, path, msg);
+    }
+}
+
 static lo_server_thread st;
 
+// the OSC server thread and the shared-memory link thread both dispatch to the handlers below;
+// they take turns. recursive, since the link holds it across a whole packet.
+static pthread_mutex_t dispatch_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+#define O_MAX_METHODS 32
+static lo_method_handler methods[O_MAX_METHODS];
+static int num_methods = 0;
+
 //-------------------
 //--- audio engine descriptor management
 
@@ -59,6 +98,32 @@ struct engine_poll polls[MAX_NUM_DESC];
 // mutex for desctiptor data
 pthread_mutex_t desc_lock;
 
+//-------------------
+//--- engine commands
+
+// keep bundles well under the UDP payload limit
+#define COMMAND_BUNDLE_MAX_BYTES 8192
+
+// descriptors built from the last command report, read by the lua thread without locking.
+// a replaced table is retired, and freed once the lua thread is next between events.
+static _Atomic(struct engine_command_table *) command_table = NULL;
+static _Atomic(struct engine_command_table *) retired_tables = NULL;
+
+// commands are encoded here and sent from our own socket, without building an lo_message.
+// everything else for the external environment goes out on the same socket, so it all arrives in order.
+static int command_sock = -1;
+static uint8_t command_buf[COMMAND_BUNDLE_MAX_BYTES];
+
+static bool bundle_enabled = false;
+// seconds ahead of now to timestamp bundles; 0 sends them for immediate dispatch
+static double bundle_latency = 0;
+// bundle being accumulated; empty if bundle_len is 0
+static uint8_t bundle_buf[COMMAND_BUNDLE_MAX_BYTES];
+static size_t bundle_len = 0;
+
+static uint64_t stat_commands = 0;
+static uint64_t stat_packets = 0;
+
 //---------------------------------
 //--- static functions
 
@@ -74,6 +139,10 @@ static void o_set_engine_name(int idx, const char *name);
 static void o_set_command(int idx, const char *name, const char *format);
 // set a given descriptor count variable
 static void o_set_num_desc(int *dst, int num);
+// open the socket engine commands are sent from
+static void o_init_command_socket(const char *port);
+static void command_table_free(struct engine_command_table *table);
+static void o_publish_commands(void);
 
 //--- OSC handlers
 static int handle_crone_ready(const char *path, const char *types, lo_arg **argv, int argc, lo_message data,
@@ -120,6 +189,8 @@ static int handle_tape_play_state(const char *path, const char *types, lo_arg **
                                   void *user_data);
 
 static void lo_error_handler(int num, const char *m, const char *path);
+static void o_add_method(const char *path, const char *types, lo_method_handler handler);
+static void o_dispatch_shm(void *data, size_t size);
 
 static void set_need_reports() {
     needCommandReport = true;
@@ -138,7 +209,7 @@ static void test_engine_load_done();
 
 void o_query_startup(void) {
     // fprintf(stderr, "sending /ready: %d", rem_port);
-    lo_send(ext_addr, "/ready", "");
+    ext_send("/ready", "");
 }
 
 //--- init
@@ -154,50 +225,65 @@ void o_init(void) {
 
     ext_addr = lo_address_new("127.0.0.1", ext_port);
     crone_addr = lo_address_new("127.0.0.1", crone_port);
+    o_init_command_socket(ext_port);
     st = lo_server_thread_new(local_port, lo_error_handler);
 
     // crone ready
-    lo_server_thread_add_method(st, "/crone/ready", "", handle_crone_ready, NULL);
+    o_add_method("/crone/ready", "", handle_crone_ready);
     // engine report sequence
-    lo_server_thread_add_method(st, "/report/engines/start", "i", handle_engine_report_start, NULL);
-    lo_server_thread_add_method(st, "/report/engines/entry", "is", handle_engine_report_entry, NULL);
-    lo_server_thread_add_method(st, "/report/engines/end", "", handle_engine_report_end, NULL);
+    o_add_method("/report/engines/start", "i", handle_engine_report_start);
+    o_add_method("/report/engines/entry", "is", handle_engine_report_entry);
+    o_add_method("/report/engines/end", "", handle_engine_report_end);
 
     // command report sequence
-    lo_server_thread_add_method(st, "/report/commands/start", "i", handle_command_report_start, NULL);
-    lo_server_thread_add_method(st, "/report/commands/entry", "iss", handle_command_report_entry, NULL);
-    lo_server_thread_add_method(st, "/report/commands/end", "", handle_command_report_end, NULL);
+    o_add_method("/report/commands/start", "i", handle_command_report_start);
+    o_add_method("/report/commands/entry", "iss", handle_command_report_entry);
+    o_add_method("/report/commands/end", "", handle_command_report_end);
 
     // poll report sequence
-    lo_server_thread_add_method(st, "/report/polls/start", "i", handle_poll_report_start, NULL);
-    lo_server_thread_add_method(st, "/report/polls/entry", "isi", handle_poll_report_entry, NULL);
-    lo_server_thread_add_method(st, "/report/polls/end", "", handle_poll_report_end, NULL);
+    o_add_method("/report/polls/start", "i", handle_poll_report_start);
+    o_add_method("/report/polls/entry", "isi", handle_poll_report_entry);
+    o_add_method("/report/polls/end", "", handle_poll_report_end);
     //// poll results
     // generic single value
-    lo_server_thread_add_method(st, "/poll/value", "if", handle_poll_value, NULL);
+    o_add_method("/poll/value", "if", handle_poll_value);
     // generic data blob
-    lo_server_thread_add_method(st, "/poll/data", "ib", handle_poll_data, NULL);
+    o_add_method("/poll/data", "ib", handle_poll_data);
     // dedicated path for audio I/O levels
-    lo_server_thread_add_method(st, "/poll/vu", "b", handle_poll_io_levels, NULL);
+    o_add_method("/poll/vu", "b", handle_poll_io_levels);
     // softcut polls
-    lo_server_thread_add_method(st, "/poll/softcut/phase", "if", handle_poll_softcut_phase, NULL);
+    o_add_method("/poll/softcut/phase", "if", handle_poll_softcut_phase);
     // tape reports
-    lo_server_thread_add_method(st, "/tape/play/state", "s", handle_tape_play_state, NULL);
+    o_add_method("/tape/play/state", "s", handle_tape_play_state);
 
     // softcut buffer content
-    lo_server_thread_add_method(st, "/softcut/buffer/render_callback", "iffb", handle_softcut_render, NULL);
-    lo_server_thread_add_method(st, "/poll/softcut/position", "if", handle_softcut_position, NULL);
+    o_add_method("/softcut/buffer/render_callback", "iffb", handle_softcut_render);
+    o_add_method("/poll/softcut/position", "if", handle_softcut_position);
 
     lo_server_thread_start(st);
+
+    if (args_crone_shm()) {
+        crone_shm_init(crone_port, o_dispatch_shm);
+    }
 }
 
 void o_deinit(void) {
     fprintf(stderr, "killing audio engine\n");
-    lo_send(ext_addr, "/engine/kill", "");
+    ext_send("/engine/kill", "");
     fprintf(stderr, "stopping OSC server\n");
+    crone_shm_deinit();
     lo_server_thread_free(st);
     lo_address_free(ext_addr);
     lo_address_free(crone_addr);
+    if (command_sock >= 0) {
+        close(command_sock);
+        command_sock = -1;
+    }
+    struct engine_command_table *table = atomic_exchange(&command_table, NULL);
+    if (table != NULL) {
+        command_table_free(table);
+    }
+    o_release_command_tables();
 }
 
 //--- descriptor access
@@ -244,16 +330,166 @@ void o_unlock_descriptors() {
 
 void o_request_engine_report(void) {
     // fprintf(stderr, "requesting engine report... \n");
-    lo_send(ext_addr, "/report/engines", "");
+    ext_send("/report/engines", "");
 }
 
 void o_load_engine(const char *name) {
     set_need_reports();
-    lo_send(ext_addr, "/engine/load/name", "s", name);
+    ext_send("/engine/load/name", "s", name);
 }
 
 void o_free_engine() {
-    lo_send(ext_addr, "/engine/free", "");
+    ext_send("/engine/free", "");
+}
+
+// size of an OSC string with its terminator and padding
+static inline size_t osc_string_size(size_t len) {
+    return (len + 4) & ~(size_t)3;
+}
+
+static inline void put_u32(uint8_t *dst, uint32_t v) {
+    v = htonl(v);
+    memcpy(dst, &v, 4);
+}
+
+static size_t put_string(uint8_t *dst, const char *str, size_t len) {
+    size_t size = osc_string_size(len);
+    memcpy(dst, str, len);
+    memset(dst + len, 0, size - len);
+    return size;
+}
+
+static lo_timetag bundle_timetag(void) {
+    if (bundle_latency <= 0) {
+        return LO_TT_IMMEDIATE;
+    }
+    lo_timetag tt;
+    lo_timetag_now(&tt);
+    double frac = tt.frac / 4294967296.0 + bundle_latency;
+    uint32_t sec = (uint32_t)frac;
+    tt.sec += sec;
+    tt.frac = (uint32_t)((frac - sec) * 4294967296.0);
+    return tt;
+}
+
+static void ext_send_message(const char *path, lo_message msg) {
+    if (command_sock < 0) {
+        lo_send_message(ext_addr, path, msg);
+        return;
+    }
+    // may be called from the hello thread, so don't use command_buf
+    uint8_t buf[512];
+    size_t size = lo_message_length(msg, path);
+    uint8_t *data = size <= sizeof(buf) ? buf : malloc(size);
+    if (data == NULL) {
+        return;
+    }
+    lo_message_serialise(msg, path, data, &size);
+    if (send(command_sock, data, size, 0) < 0) {
+        fprintf(stderr, "failed to send %s (%s)\n", path, strerror(errno));
+    }
+    if (data != buf) {
+        free(data);
+    }
+}
+
+static void command_send_raw(const uint8_t *data, size_t size) {
+    if (send(command_sock, data, size, 0) < 0) {
+        fprintf(stderr, "failed to send engine command (%s)\n", strerror(errno));
+    }
+    stat_packets++;
+}
+
+// reserve space for a message of `size` bytes in the bundle, flushing it first if full.
+// returns where to write the message, or NULL if it can't fit in any bundle.
+static uint8_t *bundle_reserve(size_t size) {
+    if (16 + 4 + size > COMMAND_BUNDLE_MAX_BYTES) {
+        return NULL;
+    }
+    if (bundle_len > 0 && bundle_len + 4 + size > COMMAND_BUNDLE_MAX_BYTES) {
+        o_flush_commands();
+    }
+    if (bundle_len == 0) {
+        lo_timetag tt = bundle_timetag();
+        memcpy(bundle_buf, "#bundle", 8);
+        put_u32(bundle_buf + 8, tt.sec);
+        put_u32(bundle_buf + 12, tt.frac);
+        bundle_len = 16;
+    }
+    put_u32(bundle_buf + bundle_len, (uint32_t)size);
+    uint8_t *dst = bundle_buf + bundle_len + 4;
+    bundle_len += 4 + size;
+    return dst;
+}
+
+// encode a command message into dst, which has room for command_encoded_size() bytes
+static void command_encode(uint8_t *dst, const struct engine_command_desc *cmd, const struct engine_command_arg *args,
+                           int argc) {
+    if (argc == cmd->argc) {
+        // all arguments given: path and typetag come straight from the template
+        memcpy(dst, cmd->header, cmd->header_size);
+        dst += cmd->header_size;
+    } else {
+        memcpy(dst, cmd->header, cmd->path_size);
+        dst += cmd->path_size;
+        char tag[ENGINE_COMMAND_MAX_ARGS + 1];
+        tag[0] = ',';
+        for (int i = 0; i < argc; i++) {
+            tag[i + 1] = args[i].type;
+        }
+        dst += put_string(dst, tag, argc + 1);
+    }
+
+    for (int i = 0; i < argc; i++) {
+        switch (args[i].type) {
+        case 'i':
+            put_u32(dst, (uint32_t)args[i].i);
+            dst += 4;
+            break;
+        case 'f': {
+            uint32_t bits;
+            memcpy(&bits, &args[i].f, 4);
+            put_u32(dst, bits);
+            dst += 4;
+            break;
+        }
+        case 's':
+            dst += put_string(dst, args[i].s, strlen(args[i].s));
+            break;
+        }
+    }
+}
+
+static size_t command_encoded_size(const struct engine_command_desc *cmd, const struct engine_command_arg *args,
+                                   int argc) {
+    size_t size = argc == cmd->argc ? cmd->header_size : cmd->path_size + osc_string_size(argc + 1);
+    for (int i = 0; i < argc; i++) {
+        size += args[i].type == 's' ? osc_string_size(strlen(args[i].s)) : 4;
+    }
+    return size;
+}
+
+void o_send_command_args(const struct engine_command_desc *cmd, const struct engine_command_arg *args, int argc) {
+    assert(argc <= cmd->argc);
+    size_t size = command_encoded_size(cmd, args, argc);
+    stat_commands++;
+
+    if (bundle_enabled) {
+        uint8_t *dst = bundle_reserve(size);
+        if (dst == NULL) {
+            fprintf(stderr, "engine command %s too large to send (%zu bytes)\n", cmd->name, size);
+            return;
+        }
+        command_encode(dst, cmd, args, argc);
+        return;
+    }
+
+    if (size > sizeof(command_buf)) {
+        fprintf(stderr, "engine command %s too large to send (%zu bytes)\n", cmd->name, size);
+        return;
+    }
+    command_encode(command_buf, cmd, args, argc);
+    command_send_raw(command_buf, size);
 }
 
 void o_send_command(const char *name, lo_message msg) {
@@ -262,20 +498,139 @@ void o_send_command(const char *name, lo_message msg) {
     size_t len = sizeof(char) * (strlen(name) + 10);
     path = malloc(len);
     sprintf(path, "/command/%s", name);
-    lo_send_message(ext_addr, path, msg);
+    stat_commands++;
+
+    if (!bundle_enabled) {
+        ext_send_message(path, msg);
+        stat_packets++;
+        free(path);
+        return;
+    }
+
+    size_t size = lo_message_length(msg, path);
+    uint8_t *dst = bundle_reserve(size);
+    if (dst == NULL) {
+        fprintf(stderr, "engine command %s too large to send (%zu bytes)\n", name, size);
+    } else {
+        lo_message_serialise(msg, path, dst, &size);
+    }
     free(path);
 }
 
+void o_flush_commands(void) {
+    if (bundle_len == 0) {
+        return;
+    }
+    command_send_raw(bundle_buf, bundle_len);
+    bundle_len = 0;
+}
+
+void o_set_command_bundling(bool enabled, double latency) {
+    o_flush_commands();
+    bundle_enabled = enabled;
+    bundle_latency = latency;
+}
+
+void o_command_stats(uint64_t *commands, uint64_t *packets) {
+    *commands = stat_commands;
+    *packets = stat_packets;
+}
+
+const struct engine_command_table *o_get_command_table(void) {
+    return atomic_load_explicit(&command_table, memory_order_acquire);
+}
+
+static void command_table_free(struct engine_command_table *table) {
+    for (int i = 0; i < table->count; i++) {
+        free(table->commands[i].name);
+        free(table->commands[i].format);
+        free(table->commands[i].header);
+    }
+    free(table);
+}
+
+void o_release_command_tables(void) {
+    struct engine_command_table *table = atomic_exchange(&retired_tables, NULL);
+    while (table != NULL) {
+        struct engine_command_table *next = table->retired_next;
+        command_table_free(table);
+        table = next;
+    }
+}
+
+// build the descriptor for one command; false if memory ran out
+static bool command_desc_init(struct engine_command_desc *cmd, const char *name, const char *format) {
+    char tag[ENGINE_COMMAND_MAX_ARGS + 2];
+    size_t path_len = strlen("/command/") + strlen(name);
+
+    // format characters other than s, i and f are skipped when sending, as they always were
+    cmd->argc = 0;
+    tag[0] = ',';
+    for (const char *c = format; *c != '\0' && cmd->argc < ENGINE_COMMAND_MAX_ARGS; c++) {
+        if (*c == 's' || *c == 'i' || *c == 'f') {
+            tag[++cmd->argc] = *c;
+        }
+    }
+    tag[cmd->argc + 1] = '\0';
+
+    cmd->name = strdup(name);
+    cmd->format = strdup(format);
+    cmd->path_size = osc_string_size(path_len);
+    cmd->header_size = cmd->path_size + osc_string_size(cmd->argc + 1);
+    cmd->header = malloc(cmd->header_size);
+    if (cmd->name == NULL || cmd->format == NULL || cmd->header == NULL) {
+        return false;
+    }
+
+    char path[path_len + 1];
+    snprintf(path, sizeof(path), "/command/%s", name);
+    put_string(cmd->header, path, path_len);
+    put_string(cmd->header + cmd->path_size, tag, cmd->argc + 1);
+    return true;
+}
+
+// build a descriptor table from the command report, and swap it in for the lua thread
+static void o_publish_commands(void) {
+    o_lock_descriptors();
+    int count = num_commands;
+    struct engine_command_table *table =
+        calloc(1, sizeof(struct engine_command_table) + count * sizeof(struct engine_command_desc));
+    if (table == NULL) {
+        o_unlock_descriptors();
+        fprintf(stderr, "failure to malloc engine command table\n");
+        return;
+    }
+    table->count = count;
+    for (int i = 0; i < count; i++) {
+        if (commands[i].name == NULL || commands[i].format == NULL ||
+            !command_desc_init(&table->commands[i], commands[i].name, commands[i].format)) {
+            o_unlock_descriptors();
+            fprintf(stderr, "failure to build engine command table (entry %d)\n", i);
+            command_table_free(table);
+            return;
+        }
+    }
+    o_unlock_descriptors();
+
+    struct engine_command_table *old = atomic_exchange_explicit(&command_table, table, memory_order_acq_rel);
+    if (old != NULL) {
+        // the lua thread may be using it right now
+        old->retired_next = atomic_load(&retired_tables);
+        while (!atomic_compare_exchange_weak(&retired_tables, &old->retired_next, old)) {
+        }
+    }
+}
+
 void o_send(const char *name, lo_message msg) {
-    lo_send_message(ext_addr, name, msg);
+    ext_send_message(name, msg);
     free(msg);
 }
 
 void o_set_poll_state(int idx, bool state) {
     if (state) {
-        lo_send(ext_addr, "/poll/start", "i", idx);
+        ext_send("/poll/start", "i", idx);
     } else {
-        lo_send(ext_addr, "/poll/stop", "i", idx);
+        ext_send("/poll/stop", "i", idx);
     }
 }
 
@@ -389,6 +744,29 @@ void o_set_poll(int idx, const char *name, poll_type_t type) {
     o_unlock_descriptors();
 }
 
+void o_init_command_socket(const char *port) {
+    struct addrinfo hints;
+    struct addrinfo *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    int err = getaddrinfo("127.0.0.1", port, &hints, &res);
+    if (err) {
+        fprintf(stderr, "failed to resolve engine command address (%s)\n", gai_strerror(err));
+        return;
+    }
+    command_sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (command_sock < 0 || connect(command_sock, res->ai_addr, res->ai_addrlen) < 0) {
+        fprintf(stderr, "failed to open engine command socket (%s)\n", strerror(errno));
+        if (command_sock >= 0) {
+            close(command_sock);
+            command_sock = -1;
+        }
+    }
+    freeaddrinfo(res);
+}
+
 // set a given descriptor count variable
 void o_set_num_desc(int *dst, int num) {
     o_lock_descriptors();
@@ -398,272 +776,270 @@ void o_set_num_desc(int *dst, int num) {
 
 // set poll period
 void o_set_poll_time(int idx, float dt) {
-    lo_send(ext_addr, "/poll/time", "if", idx, dt);
+    ext_send("/poll/time", "if", idx, dt);
 }
 
 // request current value of poll
 void o_request_poll_value(int idx) {
-    lo_send(ext_addr, "/poll/request/value", "i", idx);
+    ext_send("/poll/request/value", "i", idx);
 }
 
 //---- audio context control
 
 void o_poll_start_vu() {
-    lo_send(crone_addr, "/poll/start/vu", NULL);
+    crone_send("/poll/start/vu", "");
 }
 
 void o_poll_stop_vu() {
-    lo_send(crone_addr, "/poll/stop/vu", NULL);
+    crone_send("/poll/stop/vu", "");
 }
 
 void o_poll_start_cut_phase() {
-    lo_send(crone_addr, "/poll/start/cut/phase", NULL);
+    crone_send("/poll/start/cut/phase", "");
 }
 
 void o_poll_stop_cut_phase() {
-    lo_send(crone_addr, "/poll/stop/cut/phase", NULL);
+    crone_send("/poll/stop/cut/phase", "");
 }
 
 void o_set_level_adc(float level) {
-    lo_send(crone_addr, "/set/level/adc", "f", level);
+    crone_send("/set/level/adc", "f", level);
 }
 
 void o_set_level_dac(float level) {
-    lo_send(crone_addr, "/set/level/dac", "f", level);
+    crone_send("/set/level/dac", "f", level);
 }
 
 void o_set_level_ext(float level) {
-    lo_send(crone_addr, "/set/level/ext", "f", level);
+    crone_send("/set/level/ext", "f", level);
 }
 
 void o_set_level_monitor(float level) {
-    lo_send(crone_addr, "/set/level/monitor", "f", level);
+    crone_send("/set/level/monitor", "f", level);
 }
 
 void o_set_monitor_mix_mono() {
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 0, 0.5);
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 1, 0.5);
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 2, 0.5);
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 3, 0.5);
+    crone_send("/set/level/monitor_mix", "if", 0, 0.5);
+    crone_send("/set/level/monitor_mix", "if", 1, 0.5);
+    crone_send("/set/level/monitor_mix", "if", 2, 0.5);
+    crone_send("/set/level/monitor_mix", "if", 3, 0.5);
 }
 
 void o_set_monitor_mix_stereo() {
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 0, 1.0);
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 1, 0.0);
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 2, 0.0);
-    lo_send(crone_addr, "/set/level/monitor_mix", "if", 3, 1.0);
+    crone_send("/set/level/monitor_mix", "if", 0, 1.0);
+    crone_send("/set/level/monitor_mix", "if", 1, 0.0);
+    crone_send("/set/level/monitor_mix", "if", 2, 0.0);
+    crone_send("/set/level/monitor_mix", "if", 3, 1.0);
 }
 
 void o_set_audio_pitch_on() {
-    lo_send(ext_addr, "/audio/pitch/on", NULL);
+    ext_send("/audio/pitch/on", "");
 }
 
 void o_set_audio_pitch_off() {
-    lo_send(ext_addr, "/audio/pitch/off", NULL);
+    ext_send("/audio/pitch/off", "");
 }
 
 void o_restart_audio() {
-    lo_send(ext_addr, "/recompile", NULL);
+    ext_send("/recompile", "");
 }
 
 //---- tape controls
 void o_set_level_tape(float level) {
-    lo_send(crone_addr, "/set/level/tape", "f", level);
+    crone_send("/set/level/tape", "f", level);
 }
 
 void o_set_level_tape_rev(float level) {
-    lo_send(crone_addr, "/set/level/tape_rev", "f", level);
+    crone_send("/set/level/tape_rev", "f", level);
 }
 
 void o_tape_rec_open(char *file) {
-    lo_send(crone_addr, "/tape/record/open", "s", file);
+    crone_send("/tape/record/open", "s", file);
 }
 
 void o_tape_rec_start() {
-    lo_send(crone_addr, "/tape/record/start", NULL);
+    crone_send("/tape/record/start", "");
 }
 
 void o_tape_rec_stop() {
-    lo_send(crone_addr, "/tape/record/stop", NULL);
+    crone_send("/tape/record/stop", "");
 }
 
 void o_tape_play_open(char *file) {
-    lo_send(crone_addr, "/tape/play/open", "s", file);
+    crone_send("/tape/play/open", "s", file);
 }
 
 void o_tape_play_start() {
-    lo_send(crone_addr, "/tape/play/start", NULL);
+    crone_send("/tape/play/start", "");
 }
 
 void o_tape_play_stop() {
-    lo_send(crone_addr, "/tape/play/stop", NULL);
+    crone_send("/tape/play/stop", "");
 }
 
 //--- cut
 void o_cut_enable(int i, float value) {
-    lo_send(crone_addr, "/set/enabled/cut", "if", i, value);
+    crone_send("/set/enabled/cut", "if", i, value);
 }
 
 void o_set_level_adc_cut(float value) {
-    lo_send(crone_addr, "/set/level/adc_cut", "f", value);
+    crone_send("/set/level/adc_cut", "f", value);
 }
 
 void o_set_level_ext_cut(float value) {
-    lo_send(crone_addr, "/set/level/ext_cut", "f", value);
+    crone_send("/set/level/ext_cut", "f", value);
 }
 
 void o_set_level_tape_cut(float value) {
-    lo_send(crone_addr, "/set/level/tape_cut", "f", value);
+    crone_send("/set/level/tape_cut", "f", value);
 }
 
 void o_set_level_cut_rev(float value) {
-    lo_send(crone_addr, "/set/level/cut_rev", "f", value);
+    crone_send("/set/level/cut_rev", "f", value);
 }
 
 void o_set_level_cut_master(float value) {
-    lo_send(crone_addr, "/set/level/cut_master", "f", value);
+    crone_send("/set/level/cut_master", "f", value);
 }
 
 void o_set_level_cut(int index, float value) {
-    lo_send(crone_addr, "/set/level/cut", "if", index, value);
+    crone_send("/set/level/cut", "if", index, value);
 }
 
 void o_set_level_cut_cut(int src, int dest, float value) {
-    lo_send(crone_addr, "/set/level/cut_cut", "iif", src, dest, value);
+    crone_send("/set/level/cut_cut", "iif", src, dest, value);
 }
 
 void o_set_pan_cut(int index, float value) {
-    lo_send(crone_addr, "/set/pan/cut", "if", index, value);
+    crone_send("/set/pan/cut", "if", index, value);
 }
 
 void o_set_cut_param(const char *name, int voice, float value) {
     static char buf[128];
     sprintf(buf, "/set/param/cut/%s", name);
-    lo_send(crone_addr, buf, "if", voice, value);
+    crone_send(buf, "if", voice, value);
 }
 
 void o_set_cut_param_ii(const char *name, int voice, int value) {
     static char buf[128];
     sprintf(buf, "/set/param/cut/%s", name);
-    lo_send(crone_addr, buf, "ii", voice, value);
+    crone_send(buf, "ii", voice, value);
 }
 
 void o_set_cut_param_iif(const char *name, int a, int b, float v) {
     static char buf[128];
     sprintf(buf, "/set/param/cut/%s", name);
-    lo_send(crone_addr, buf, "iif", a, b, v);
+    crone_send(buf, "iif", a, b, v);
 }
 
 void o_set_level_input_cut(int src, int dst, float level) {
-    lo_send(crone_addr, "/set/level/in_cut", "iif", src, dst, level);
+    crone_send("/set/level/in_cut", "iif", src, dst, level);
 }
 
 void o_cut_buffer_clear() {
-    lo_send(crone_addr, "/softcut/buffer/clear", "");
+    crone_send("/softcut/buffer/clear", "");
 }
 
 void o_cut_buffer_clear_channel(int ch) {
-    lo_send(crone_addr, "/softcut/buffer/clear_channel", "i", ch);
+    crone_send("/softcut/buffer/clear_channel", "i", ch);
 }
 
 void o_cut_buffer_clear_region(float start, float dur, float fade_time, float preserve) {
-    lo_send(crone_addr, "/softcut/buffer/clear_fade_region", "ffff", start, dur, fade_time, preserve);
+    crone_send("/softcut/buffer/clear_fade_region", "ffff", start, dur, fade_time, preserve);
 }
 
 void o_cut_buffer_clear_region_channel(int ch, float start, float dur, float fade_time, float preserve) {
-    lo_send(crone_addr, "/softcut/buffer/clear_fade_region_channel", "iffff", ch, start, dur, fade_time, preserve);
+    crone_send("/softcut/buffer/clear_fade_region_channel", "iffff", ch, start, dur, fade_time, preserve);
 }
 
 void o_cut_buffer_copy_mono(int src_ch, int dst_ch, float src_start, float dst_start, float dur, float fade_time,
                             float preserve, int reverse) {
-    lo_send(crone_addr, "/softcut/buffer/copy_mono", "iifffffi", src_ch, dst_ch, src_start, dst_start, dur, fade_time,
-            preserve, reverse);
+    crone_send("/softcut/buffer/copy_mono", "iifffffi", src_ch, dst_ch, src_start, dst_start, dur, fade_time, preserve,
+               reverse);
 }
 
 void o_cut_buffer_copy_stereo(float src_start, float dst_start, float dur, float fade_time, float preserve,
                               int reverse) {
-    lo_send(crone_addr, "/softcut/buffer/copy_stereo", "fffffi", src_start, dst_start, dur, fade_time, preserve,
-            reverse);
+    crone_send("/softcut/buffer/copy_stereo", "fffffi", src_start, dst_start, dur, fade_time, preserve, reverse);
 }
 
 void o_cut_buffer_read_mono(char *file, float start_src, float start_dst, float dur, int ch_src, int ch_dst,
                             float preserve, float mix) {
-    lo_send(crone_addr, "/softcut/buffer/read_mono", "sfffiiff", file, start_src, start_dst, dur, ch_src, ch_dst,
-            preserve, mix);
+    crone_send("/softcut/buffer/read_mono", "sfffiiff", file, start_src, start_dst, dur, ch_src, ch_dst, preserve, mix);
 }
 
 void o_cut_buffer_read_stereo(char *file, float start_src, float start_dst, float dur, float preserve, float mix) {
-    lo_send(crone_addr, "/softcut/buffer/read_stereo", "sfffff", file, start_src, start_dst, dur, preserve, mix);
+    crone_send("/softcut/buffer/read_stereo", "sfffff", file, start_src, start_dst, dur, preserve, mix);
 }
 
 void o_cut_buffer_write_mono(char *file, float start, float dur, int ch) {
-    lo_send(crone_addr, "/softcut/buffer/write_mono", "sffi", file, start, dur, ch);
+    crone_send("/softcut/buffer/write_mono", "sffi", file, start, dur, ch);
 }
 
 void o_cut_buffer_write_stereo(char *file, float start, float dur) {
-    lo_send(crone_addr, "/softcut/buffer/write_stereo", "sff", file, start, dur);
+    crone_send("/softcut/buffer/write_stereo", "sff", file, start, dur);
 }
 
 void o_cut_buffer_render(int ch, float start, float dur, int samples) {
-    lo_send(crone_addr, "/softcut/buffer/render", "iffi", ch, start, dur, samples);
+    crone_send("/softcut/buffer/render", "iffi", ch, start, dur, samples);
 }
 
 void o_cut_query_position(int i) {
-    lo_send(crone_addr, "/softcut/query/position", "i", i);
+    crone_send("/softcut/query/position", "i", i);
 }
 
 void o_cut_reset() {
-    lo_send(crone_addr, "/softcut/reset", "");
+    crone_send("/softcut/reset", "");
 }
 
 //--- rev effects controls
 // enable / disable rev fx processing
 void o_set_rev_on() {
-    lo_send(crone_addr, "/set/enabled/reverb", "f", 1.0);
+    crone_send("/set/enabled/reverb", "f", 1.0);
 }
 
 void o_set_rev_off() {
-    lo_send(crone_addr, "/set/enabled/reverb", "f", 0.0);
+    crone_send("/set/enabled/reverb", "f", 0.0);
 }
 
 //--- comp effects controls
 void o_set_comp_on() {
-    lo_send(crone_addr, "/set/enabled/compressor", "f", 1.0);
+    crone_send("/set/enabled/compressor", "f", 1.0);
 }
 
 void o_set_comp_off() {
-    lo_send(crone_addr, "/set/enabled/compressor", "f", 0.0);
+    crone_send("/set/enabled/compressor", "f", 0.0);
 }
 
 void o_set_comp_mix(float value) {
-    lo_send(crone_addr, "/set/level/compressor_mix", "f", value);
+    crone_send("/set/level/compressor_mix", "f", value);
 }
 
 // stereo output -> rev
 void o_set_level_ext_rev(float value) {
-    lo_send(crone_addr, "/set/level/ext_rev", "f", value);
+    crone_send("/set/level/ext_rev", "f", value);
 }
 
 // rev return -> dac
 void o_set_level_rev_dac(float value) {
-    lo_send(crone_addr, "/set/level/rev_dac", "f", value);
+    crone_send("/set/level/rev_dac", "f", value);
 }
 
 // monitor mix -> rev level
 void o_set_level_monitor_rev(float value) {
-    lo_send(crone_addr, "/set/level/monitor_rev", "f", value);
+    crone_send("/set/level/monitor_rev", "f", value);
 }
 
 void o_set_rev_param(const char *name, float value) {
     static char buf[128];
     sprintf(buf, "/set/param/reverb/%s", name);
-    lo_send(crone_addr, buf, "f", value);
+    crone_send(buf, "f", value);
 }
 
 void o_set_comp_param(const char *name, float value) {
     static char buf[128];
     sprintf(buf, "/set/param/compressor/%s", name);
-    lo_send(crone_addr, buf, "f", value);
+    crone_send(buf, "f", value);
 }
 
 /////////////////////
@@ -727,6 +1103,7 @@ int handle_command_report_entry(const char *path, const char *types, lo_arg **ar
 
 int handle_command_report_end(const char *path, const char *types, lo_arg **argv, int argc, lo_message data,
                               void *user_data) {
+    o_publish_commands();
     needCommandReport = false;
     test_engine_load_done();
     return 0;
@@ -856,6 +1233,30 @@ void lo_error_handler(int num, const char *m, const char *path) {
     fprintf(stderr, "liblo error %d in path %s: %s\n", num, path, m);
 }
 
+static int o_dispatch(const char *path, const char *types, lo_arg **argv, int argc, lo_message data,
+                      void *user_data) {
+    lo_method_handler handler = *(lo_method_handler *)user_data;
+    pthread_mutex_lock(&dispatch_lock);
+    int res = handler(path, types, argv, argc, data, NULL);
+    pthread_mutex_unlock(&dispatch_lock);
+    return res;
+}
+
+// every handler runs under the dispatch lock, whichever thread received its packet
+void o_add_method(const char *path, const char *types, lo_method_handler handler) {
+    assert(num_methods < O_MAX_METHODS);
+    methods[num_methods] = handler;
+    lo_server_thread_add_method(st, path, types, o_dispatch, &methods[num_methods]);
+    num_methods++;
+}
+
+// packets from crone's shared-memory link are dispatched as if they'd arrived by UDP
+void o_dispatch_shm(void *data, size_t size) {
+    pthread_mutex_lock(&dispatch_lock);
+    lo_server_dispatch_data(lo_server_thread_get_server(st), data, size);
+    pthread_mutex_unlock(&dispatch_lock);
+}
+
 void test_engine_load_done() {
     if (!get_need_reports()) {
         union event_data *ev = event_data_new(EVENT_ENGINE_LOADED);
@@ -2,6 +2,8 @@
 #include <lo/lo.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 /*
  * oracle.h
  *
@@ -25,6 +27,38 @@ struct engine_command {
     char *format; // format string
 };
 
+// most arguments a single engine command can take
+#define ENGINE_COMMAND_MAX_ARGS 64
+
+// engine command precompiled for sending, built when the command report arrives
+struct engine_command_desc {
+    char *name;
+    char *format;
+    // "/command/<name>" and the typetag for all arguments, padded as in an OSC message
+    uint8_t *header;
+    size_t header_size;
+    // size of the path alone at the start of the header
+    size_t path_size;
+    // arguments in the typetag; format characters other than s, i and f take none
+    int argc;
+};
+
+struct engine_command_table {
+    struct engine_command_table *retired_next;
+    int count;
+    struct engine_command_desc commands[];
+};
+
+// an argument, already checked against the command's typetag ('i', 'f' or 's')
+struct engine_command_arg {
+    char type;
+    union {
+        int32_t i;
+        float f;
+        const char *s;
+    };
+};
+
 // data structure for engine poll descriptor/headerx
 struct engine_poll {
     char *name;       // name string
@@ -86,6 +120,21 @@ extern void o_request_poll_report(void);
 // issue a command to the engine, adds /command/ pattern
 // caller is responsible for freeing memory
 extern void o_send_command(const char *name, lo_message msg);
+// commands from the last command report, or NULL. lock-free; only for the lua thread, and a
+// table is only valid until that thread returns to the event loop.
+extern const struct engine_command_table *o_get_command_table(void);
+// free tables replaced since the last call; the event loop calls this between events
+extern void o_release_command_tables(void);
+// encode a command with the given arguments (at most cmd->argc) and send or bundle it
+extern void o_send_command_args(const struct engine_command_desc *cmd, const struct engine_command_arg *args,
+                                int argc);
+// when enabled, commands are held and sent as one OSC bundle per event loop dispatch,
+// timestamped `latency` seconds ahead (0 for immediate). call from the lua thread.
+extern void o_set_command_bundling(bool enabled, double latency);
+// send any held commands; called by the event loop after each event
+extern void o_flush_commands(void);
+// commands issued, and UDP packets they were sent in
+extern void o_command_stats(uint64_t *commands, uint64_t *packets);
 
 // start or stop a poll
 // extern void o_set_poll_state(const char *name, bool state);
@@ -17,11 +17,26 @@
 #include "args.h"
 #include "events.h"
 #include "oracle.h"
+#include "osc_packet.h"
 
 #define OSC_CRONE_HOST "127.0.0.1"
 #define OSC_CRONE_PORT "57120"
 static lo_address crone_addr;
 
+// resolved destinations for osc_send, most recently used kept
+struct osc_address_entry {
+    char *host;
+    char *port;
+    lo_address addr;
+    // value of the use counter at the last send; 0 for an empty entry
+    uint64_t used;
+};
+
+static struct osc_address_entry address_cache[OSC_ADDRESS_CACHE_SIZE];
+static uint64_t address_use_counter = 0;
+static struct osc_send_stats send_stats;
+static pthread_mutex_t address_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static lo_server_thread st;
 static DNSServiceRef dnssd_ref;
 
@@ -30,6 +45,7 @@ static void lo_error_handler(int num, const char *m, const char *path);
 
 void osc_init(void) {
     // receive
+    osc_packet_pool_init();
     st = lo_server_thread_new(args_remote_port(), lo_error_handler);
     lo_server_thread_add_method(st, NULL, NULL, osc_receive, NULL);
     lo_server_thread_start(st);
@@ -44,16 +60,99 @@ void osc_deinit(void) {
     DNSServiceRefDeallocate(dnssd_ref);
     lo_server_thread_free(st);
     lo_address_free(crone_addr);
+    osc_invalidate(NULL, NULL);
+}
+
+// call with address_lock held
+static void address_entry_clear(struct osc_address_entry *e) {
+    if (e->used == 0) {
+        return;
+    }
+    lo_address_free(e->addr);
+    free(e->host);
+    free(e->port);
+    memset(e, 0, sizeof(struct osc_address_entry));
+}
+
+// find or create the cached address for host:port; call with address_lock held
+static struct osc_address_entry *address_lookup(const char *host, const char *port) {
+    struct osc_address_entry *lru = &address_cache[0];
+
+    for (int i = 0; i < OSC_ADDRESS_CACHE_SIZE; i++) {
+        struct osc_address_entry *e = &address_cache[i];
+        if (e->used != 0 && strcmp(e->host, host) == 0 && strcmp(e->port, port) == 0) {
+            send_stats.hits++;
+            e->used = ++address_use_counter;
+            return e;
+        }
+        if (e->used < lru->used) {
+            lru = e;
+        }
+    }
+
+    // resolving the host and opening the socket happen here, once per destination
+    send_stats.misses++;
+    lo_address addr = lo_address_new(host, port);
+    if (addr == NULL) {
+        return NULL;
+    }
+    char *h = strdup(host);
+    char *p = strdup(port);
+    if (h == NULL || p == NULL) {
+        free(h);
+        free(p);
+        lo_address_free(addr);
+        return NULL;
+    }
+
+    if (lru->used != 0) {
+        send_stats.evictions++;
+        address_entry_clear(lru);
+    }
+    lru->host = h;
+    lru->port = p;
+    lru->addr = addr;
+    lru->used = ++address_use_counter;
+    return lru;
 }
 
 void osc_send(const char *host, const char *port, const char *path, lo_message msg) {
-    lo_address address = lo_address_new(host, port);
-    if (!address) {
+    pthread_mutex_lock(&address_lock);
+    struct osc_address_entry *e = address_lookup(host, port);
+    if (e == NULL) {
+        send_stats.errors++;
+        pthread_mutex_unlock(&address_lock);
         fprintf(stderr, "failed to create lo_address\n");
         return;
     }
-    lo_send_message(address, path, msg);
-    lo_address_free(address);
+    if (lo_send_message(e->addr, path, msg) < 0) {
+        send_stats.errors++;
+        // the destination may have moved; resolve it again next time
+        address_entry_clear(e);
+    } else {
+        send_stats.sent++;
+    }
+    pthread_mutex_unlock(&address_lock);
+}
+
+void osc_invalidate(const char *host, const char *port) {
+    pthread_mutex_lock(&address_lock);
+    for (int i = 0; i < OSC_ADDRESS_CACHE_SIZE; i++) {
+        struct osc_address_entry *e = &address_cache[i];
+        if (e->used == 0) {
+            continue;
+        }
+        if ((host == NULL || strcmp(e->host, host) == 0) && (port == NULL || strcmp(e->port, port) == 0)) {
+            address_entry_clear(e);
+        }
+    }
+    pthread_mutex_unlock(&address_lock);
+}
+
+void osc_get_send_stats(struct osc_send_stats *stats) {
+    pthread_mutex_lock(&address_lock);
+    *stats = send_stats;
+    pthread_mutex_unlock(&address_lock);
 }
 
 void osc_send_crone(const char *path, lo_message msg) {
@@ -61,23 +160,20 @@ void osc_send_crone(const char *path, lo_message msg) {
 }
 
 int osc_receive(const char *path, const char *types, lo_arg **argv, int argc, lo_message msg, void *user_data) {
-    (void)types;
-    (void)argv;
-    (void)argc;
     (void)user_data;
 
-    union event_data *ev = event_data_new(EVENT_OSC);
-
-    ev->osc_event.path = strdup(path);
-    ev->osc_event.msg = lo_message_clone(msg);
-
     lo_address source = lo_message_get_source(msg);
     const char *host = lo_address_get_hostname(source);
     const char *port = lo_address_get_port(source);
 
-    ev->osc_event.from_host = strdup(host);
-    ev->osc_event.from_port = strdup(port);
+    // decoded into a pooled slot; the message itself is freed by liblo when we return
+    struct osc_packet *pkt = osc_packet_new(path, types, argv, argc, host, port);
+    if (pkt == NULL) {
+        return 0;
+    }
 
+    union event_data *ev = event_data_new(EVENT_OSC);
+    ev->osc_event.packet = pkt;
     event_post(ev);
 
     return 0;
@@ -6,10 +6,30 @@
  */
 
 #pragma once
+#include <stdint.h>
+
 #include "lo/lo.h"
 
+// destinations kept resolved for osc_send; the least recently used is dropped first
+#define OSC_ADDRESS_CACHE_SIZE 16
+
+struct osc_send_stats {
+    uint64_t sent;
+    // failed to resolve or to send
+    uint64_t errors;
+    // destination found in the address cache
+    uint64_t hits;
+    // destination resolved anew
+    uint64_t misses;
+    uint64_t evictions;
+};
+
 extern void osc_init();
 extern void osc_deinit();
 
 extern void osc_send(const char *, const char *, const char *, lo_message);
 extern void osc_send_crone(const char *, lo_message);
+
+// forget cached destinations matching host and port; NULL matches any
+extern void osc_invalidate(const char *host, const char *port);
+extern void osc_get_send_stats(struct osc_send_stats *stats);
@@ -0,0 +1,207 @@
+/*
+ * osc_packet.c
+ *
+ * pooled storage for incoming OSC messages
+ *
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osc_packet.h"
+
+#define OSC_PACKET_STRIDE (sizeof(struct osc_packet) + OSC_PACKET_SLOT_SIZE)
+
+struct osc_source {
+    char *host;
+    char *port;
+};
+
+static _Alignas(8) uint8_t pool_mem[OSC_PACKET_POOL_SIZE][OSC_PACKET_STRIDE];
+static struct osc_packet *pool_free = NULL;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// only touched by the receiving thread; entries are never changed or freed once added,
+// so packets can refer to them after they're handed to the event loop
+static struct osc_source sources[OSC_PACKET_SOURCES_MAX];
+static int num_sources = 0;
+
+static _Atomic uint64_t stat_pooled = 0;
+static _Atomic uint64_t stat_heap = 0;
+
+static struct osc_packet *pool_take(void) {
+    pthread_mutex_lock(&pool_lock);
+    struct osc_packet *pkt = pool_free;
+    if (pkt != NULL) {
+        pool_free = pkt->next;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return pkt;
+}
+
+static const struct osc_source *source_intern(const char *host, const char *port) {
+    for (int i = 0; i < num_sources; i++) {
+        if (strcmp(sources[i].host, host) == 0 && strcmp(sources[i].port, port) == 0) {
+            return &sources[i];
+        }
+    }
+    if (num_sources == OSC_PACKET_SOURCES_MAX) {
+        return NULL;
+    }
+
+    char *h = strdup(host);
+    char *p = strdup(port);
+    if (h == NULL || p == NULL) {
+        free(h);
+        free(p);
+        return NULL;
+    }
+    sources[num_sources].host = h;
+    sources[num_sources].port = p;
+    return &sources[num_sources++];
+}
+
+// bytes of storage needed for an argument's data
+static size_t arg_size(char type, lo_arg *arg) {
+    switch (type) {
+    case LO_STRING:
+        return strlen(&arg->s) + 1;
+    case LO_SYMBOL:
+        return strlen(&arg->S) + 1;
+    case LO_BLOB:
+        return lo_blob_datasize((lo_blob)arg);
+    case LO_CHAR:
+        return 1;
+    case LO_MIDI:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static char *store(uint8_t **cursor, const void *src, size_t n) {
+    char *dst = (char *)*cursor;
+    memcpy(dst, src, n);
+    *cursor += n;
+    return dst;
+}
+
+static void decode_arg(struct osc_packet_arg *dst, char type, lo_arg *arg, uint8_t **cursor) {
+    dst->type = type;
+    dst->len = 0;
+    switch (type) {
+    case LO_INT32:
+        dst->v.i = arg->i;
+        break;
+    case LO_INT64:
+        dst->v.i = arg->h;
+        break;
+    case LO_FLOAT:
+        dst->v.f = arg->f;
+        break;
+    case LO_DOUBLE:
+        dst->v.f = arg->d;
+        break;
+    case LO_STRING:
+    case LO_SYMBOL:
+        dst->len = strlen(&arg->s);
+        dst->v.s = store(cursor, &arg->s, dst->len + 1);
+        break;
+    case LO_BLOB:
+        dst->len = lo_blob_datasize((lo_blob)arg);
+        dst->v.s = store(cursor, lo_blob_dataptr((lo_blob)arg), dst->len);
+        break;
+    case LO_CHAR:
+        dst->len = 1;
+        dst->v.s = store(cursor, &arg->c, 1);
+        break;
+    case LO_MIDI:
+        dst->len = 4;
+        dst->v.s = store(cursor, arg->m, 4);
+        break;
+    default:
+        // booleans, nil and infinitum are carried by the type alone
+        break;
+    }
+}
+
+void osc_packet_pool_init(void) {
+    pthread_mutex_lock(&pool_lock);
+    pool_free = NULL;
+    for (int i = OSC_PACKET_POOL_SIZE - 1; i >= 0; i--) {
+        struct osc_packet *pkt = (struct osc_packet *)pool_mem[i];
+        pkt->pooled = true;
+        pkt->next = pool_free;
+        pool_free = pkt;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+struct osc_packet *osc_packet_new(const char *path, const char *types, lo_arg **argv, int argc,
+                                  const char *host, const char *port) {
+    const struct osc_source *source = source_intern(host, port);
+
+    size_t path_len = strlen(path) + 1;
+    size_t size = argc * sizeof(struct osc_packet_arg) + path_len;
+    if (source == NULL) {
+        size += strlen(host) + strlen(port) + 2;
+    }
+    for (int i = 0; i < argc; i++) {
+        size += arg_size(types[i], argv[i]);
+    }
+
+    struct osc_packet *pkt = size <= OSC_PACKET_SLOT_SIZE ? pool_take() : NULL;
+    if (pkt != NULL) {
+        atomic_fetch_add_explicit(&stat_pooled, 1, memory_order_relaxed);
+    } else {
+        pkt = malloc(sizeof(struct osc_packet) + size);
+        if (pkt == NULL) {
+            fprintf(stderr, "osc: no memory for incoming message %s\n", path);
+            return NULL;
+        }
+        pkt->pooled = false;
+        atomic_fetch_add_explicit(&stat_heap, 1, memory_order_relaxed);
+    }
+    pkt->next = NULL;
+
+    // the argument array goes first, where it stays aligned
+    pkt->argc = argc;
+    pkt->args = (struct osc_packet_arg *)pkt->data;
+    uint8_t *cursor = pkt->data + argc * sizeof(struct osc_packet_arg);
+
+    pkt->path = store(&cursor, path, path_len);
+    if (source != NULL) {
+        pkt->host = source->host;
+        pkt->port = source->port;
+    } else {
+        pkt->host = store(&cursor, host, strlen(host) + 1);
+        pkt->port = store(&cursor, port, strlen(port) + 1);
+    }
+    for (int i = 0; i < argc; i++) {
+        decode_arg(&pkt->args[i], types[i], argv[i], &cursor);
+    }
+
+    return pkt;
+}
+
+void osc_packet_free(struct osc_packet *pkt) {
+    if (pkt == NULL) {
+        return;
+    }
+    if (!pkt->pooled) {
+        free(pkt);
+        return;
+    }
+    pthread_mutex_lock(&pool_lock);
+    pkt->next = pool_free;
+    pool_free = pkt;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void osc_packet_stats(uint64_t *pooled, uint64_t *heap) {
+    *pooled = atomic_load_explicit(&stat_pooled, memory_order_relaxed);
+    *heap = atomic_load_explicit(&stat_heap, memory_order_relaxed);
+}
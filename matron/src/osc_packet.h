@@ -0,0 +1,62 @@
+/*
+ * osc_packet.h
+ *
+ * incoming OSC messages, decoded for delivery to lua
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lo/lo.h>
+
+// packets are decoded on the liblo server thread into fixed-size slots from a pool allocated
+// once at startup, so the receive path doesn't touch the heap. a message too big for a slot,
+// or one arriving while every slot is in use, gets a heap allocation of its own.
+#define OSC_PACKET_POOL_SIZE 256
+// storage per slot for the argument array, path and string/blob data
+#define OSC_PACKET_SLOT_SIZE 1024
+// distinct senders whose host and port are kept for the life of the process
+#define OSC_PACKET_SOURCES_MAX 64
+
+struct osc_packet_arg {
+    // liblo typetag
+    char type;
+    // size of string, symbol, blob, char and midi data
+    uint32_t len;
+    union {
+        int64_t i;
+        double f;
+        // points into the packet's storage
+        const char *s;
+    } v;
+};
+
+struct osc_packet {
+    // free list link
+    struct osc_packet *next;
+    bool pooled;
+    const char *path;
+    // interned, or in the packet's storage if the source table is full
+    const char *host;
+    const char *port;
+    int argc;
+    struct osc_packet_arg *args;
+    _Alignas(8) uint8_t data[];
+};
+
+// build the slot free list; call before the first osc_packet_new
+extern void osc_packet_pool_init(void);
+
+// decode a message from liblo. not thread safe: call only from the receiving thread.
+// returns NULL if memory runs out.
+extern struct osc_packet *osc_packet_new(const char *path, const char *types, lo_arg **argv, int argc,
+                                         const char *host, const char *port);
+// return a packet to the pool; safe from any thread
+extern void osc_packet_free(struct osc_packet *pkt);
+
+// packets decoded into pool slots and into heap fallbacks
+extern void osc_packet_stats(uint64_t *pooled, uint64_t *heap);
@@ -0,0 +1,101 @@
+/*
+ * shm_ring.c
+ *
+ * single-producer, single-consumer byte ring for passing OSC packets through shared memory
+ *
+ * the two sides are separate processes, so only the gcc atomic builtins are used on the
+ * shared indices; crone does the same from c++.
+ *
+ * a producer that finds the ring empty after publishing wakes the consumer, and a consumer
+ * that finds it empty after releasing goes to sleep. both checks store one index and then
+ * load the other with sequential consistency, so at least one side always sees the other:
+ * either the producer wakes the consumer, or the consumer sees the new packet and keeps going.
+ */
+
+#include <string.h>
+
+#include "shm_ring.h"
+
+#define SHM_RING_MASK (SHM_RING_SIZE - 1)
+
+static inline uint32_t record_size(size_t len) {
+    return (uint32_t)((sizeof(uint32_t) + len + 7) & ~(size_t)7);
+}
+
+// bytes left unused at the end of the ring if a record doesn't fit before it
+static inline uint32_t wrap_skip(uint32_t head, uint32_t rec) {
+    uint32_t room = SHM_RING_SIZE - (head & SHM_RING_MASK);
+    return room < rec ? room : 0;
+}
+
+void shm_ring_init(struct shm_ring *ring) {
+    ring->size = SHM_RING_SIZE;
+    ring->version = SHM_RING_VERSION;
+    ring->reserved = 0;
+    ring->head = 0;
+    ring->tail = 0;
+    __atomic_store_n(&ring->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+}
+
+bool shm_ring_valid(const struct shm_ring *ring) {
+    return __atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) == SHM_RING_MAGIC && ring->version == SHM_RING_VERSION &&
+           ring->size == SHM_RING_SIZE;
+}
+
+void *shm_ring_reserve(struct shm_ring *ring, size_t len) {
+    if (len > SHM_RING_RECORD_MAX) {
+        return NULL;
+    }
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t rec = record_size(len);
+    uint32_t skip = wrap_skip(head, rec);
+
+    if (skip + rec > SHM_RING_SIZE - (head - tail)) {
+        return NULL;
+    }
+    if (skip > 0) {
+        uint32_t wrap = SHM_RING_WRAP;
+        memcpy(&ring->data[head & SHM_RING_MASK], &wrap, sizeof(wrap));
+        head += skip;
+    }
+    uint8_t *rp = &ring->data[head & SHM_RING_MASK];
+    uint32_t n = (uint32_t)len;
+    memcpy(rp, &n, sizeof(n));
+    return rp + sizeof(n);
+}
+
+bool shm_ring_commit(struct shm_ring *ring, size_t len) {
+    uint32_t head = ring->head;
+    uint32_t rec = record_size(len);
+    uint32_t next = head + wrap_skip(head, rec) + rec;
+
+    __atomic_store_n(&ring->head, next, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == head;
+}
+
+const void *shm_ring_peek(struct shm_ring *ring, size_t *len) {
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    while (tail != head) {
+        const uint8_t *rp = &ring->data[tail & SHM_RING_MASK];
+        uint32_t n;
+        memcpy(&n, rp, sizeof(n));
+        if (n != SHM_RING_WRAP) {
+            *len = n;
+            return rp + sizeof(n);
+        }
+        // the producer skipped the end of the ring; hand the space back and go to the start
+        tail += SHM_RING_SIZE - (tail & SHM_RING_MASK);
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+bool shm_ring_release(struct shm_ring *ring, size_t len) {
+    uint32_t tail = ring->tail + record_size(len);
+
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == tail;
+}
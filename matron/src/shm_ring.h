@@ -0,0 +1,60 @@
+/*
+ * shm_ring.h
+ *
+ * single-producer, single-consumer byte ring for passing OSC packets through shared memory
+ *
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// the layout is shared with crone (crone/src/ShmRing.h); bump the version with any change.
+#define SHM_RING_MAGIC 0x676e726e
+#define SHM_RING_VERSION 1
+// data bytes per ring; a power of two
+#define SHM_RING_SIZE (1 << 16)
+// largest record; bigger packets are dropped
+#define SHM_RING_RECORD_MAX (SHM_RING_SIZE / 4)
+
+// head and tail are free-running byte counts, wrapping at 2^32.
+// each record is a 32-bit length followed by the packet, padded to 8 bytes.
+// a length of SHM_RING_WRAP means the rest of the ring is unused and the next record is at the start.
+#define SHM_RING_WRAP 0xffffffffu
+
+struct shm_ring {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t reserved;
+    // written by the producer only
+    _Alignas(64) uint32_t head;
+    // written by the consumer only
+    _Alignas(64) uint32_t tail;
+    _Alignas(64) uint8_t data[SHM_RING_SIZE];
+};
+
+_Static_assert(offsetof(struct shm_ring, head) == 64 && offsetof(struct shm_ring, tail) == 128 &&
+                   offsetof(struct shm_ring, data) == 192,
+               "shm_ring layout is shared with crone");
+
+// set up an empty ring in freshly mapped memory
+extern void shm_ring_init(struct shm_ring *ring);
+// check a ring mapped from the other process
+extern bool shm_ring_valid(const struct shm_ring *ring);
+
+//--- producer
+// space for a packet of `len` bytes, or NULL if the ring is too full
+extern void *shm_ring_reserve(struct shm_ring *ring, size_t len);
+// publish the packet written to the reserved space.
+// returns true if the ring was empty, so the consumer may be asleep and needs a wakeup.
+extern bool shm_ring_commit(struct shm_ring *ring, size_t len);
+
+//--- consumer
+// next packet, or NULL if the ring is empty
+extern const void *shm_ring_peek(struct shm_ring *ring, size_t *len);
+// done with the packet returned by peek.
+// returns true if the ring is now empty, so it's safe to wait for a wakeup.
+extern bool shm_ring_release(struct shm_ring *ring, size_t len);
@@ -26,12 +26,16 @@
 #include "clock.h"
 #include "clocks/clock_crow.h"
 #include "clocks/clock_internal.h"
+#include "clocks/clock_lattice.h"
 #include "clocks/clock_link.h"
 #include "clocks/clock_scheduler.h"
 #include "device_crow.h"
 #include "device_hid.h"
+#include "device_list.h"
+#include "device_loopback.h"
 #include "device_midi.h"
 #include "device_monome.h"
+#include "encoders.h"
 #include "event_custom.h"
 #include "events.h"
 #include "hello.h"
@@ -41,6 +45,7 @@
 #include "metro.h"
 #include "oracle.h"
 #include "osc.h"
+#include "osc_packet.h"
 #include "platform.h"
 #include "screen.h"
 #include "screen_events.h"
@@ -80,6 +85,7 @@ void w_handle_exec_code_line(char *line) {
 // grid
 static int _grid_set_led(lua_State *l);
 static int _grid_all_led(lua_State *l);
+static int _grid_set_region(lua_State *l);
 static int _grid_rows(lua_State *l);
 static int _grid_cols(lua_State *l);
 static int _grid_set_rotation(lua_State *l);
@@ -88,8 +94,11 @@ static int _grid_tilt_disable(lua_State *l);
 
 static int _arc_set_led(lua_State *l);
 static int _arc_all_led(lua_State *l);
+static int _arc_set_ring(lua_State *l);
+static int _arc_ring_range(lua_State *l);
 static int _monome_refresh(lua_State *l);
 static int _monome_intensity(lua_State *l);
+static int _monome_refresh_rate(lua_State *l);
 
 // screen
 static int _screen_update(lua_State *l);
@@ -163,18 +172,36 @@ static int _screen_display_image_region(lua_State *l);
 // i2c
 static int _gain_hp(lua_State *l);
 static int _adc_rev(lua_State *l);
+static int _enc_accel(lua_State *l);
 
 // osc
 static int _osc_send(lua_State *l);
 static int _osc_send_crone(lua_State *l);
+static int _osc_invalidate(lua_State *l);
+static int _osc_send_stats(lua_State *l);
 
 // midi
 static int _midi_send(lua_State *l);
+static int _midi_send_at(lua_State *l);
+static int _midi_send_at_beat(lua_State *l);
+static int _midi_clear_scheduled(lua_State *l);
+static int _midi_set_filter(lua_State *l);
+static int _midi_clear_filters(lua_State *l);
+static int _midi_filter_stats(lua_State *l);
 static int _midi_clock_receive(lua_State *l);
 
 // crow
 static int _crow_send(lua_State *l);
 
+// hid
+static int _hid_subscribe(lua_State *l);
+
+// loopback devices
+static int _loopback_add(lua_State *l);
+static int _loopback_remove(lua_State *l);
+static int _loopback_rate(lua_State *l);
+static int _loopback_stats(lua_State *l);
+
 // crone
 /// engines
 static int _request_engine_report(lua_State *l);
@@ -182,6 +209,8 @@ static int _load_engine(lua_State *l);
 static int _free_engine(lua_State *l);
 /// commands
 static int _send_command(lua_State *l);
+static int _command_bundling(lua_State *l);
+static int _command_stats(lua_State *l);
 static int _start_poll(lua_State *l);
 static int _stop_poll(lua_State *l);
 static int _set_poll_time(lua_State *l);
@@ -290,7 +319,18 @@ static int _clock_link_set_transport_start(lua_State *l);
 static int _clock_link_set_start_stop_sync(lua_State *l);
 static int _clock_set_source(lua_State *l);
 static int _clock_get_time_beats(lua_State *l);
+static int _clock_get_system_time(lua_State *l);
 static int _clock_get_tempo(lua_State *l);
+static int _clock_lattice_new(lua_State *l);
+static int _clock_lattice_free(lua_State *l);
+static int _clock_lattice_free_all(lua_State *l);
+static int _clock_lattice_start(lua_State *l);
+static int _clock_lattice_stop(lua_State *l);
+static int _clock_lattice_reset(lua_State *l);
+static int _clock_lattice_add_sprocket(lua_State *l);
+static int _clock_lattice_remove_sprocket(lua_State *l);
+static int _clock_lattice_set_sprocket(lua_State *l);
+static int _clock_lattice_set_sprocket_delay(lua_State *l);
 
 // audio performance
 static int _audio_get_cpu_load(lua_State *l);
@@ -433,6 +473,15 @@ void w_init(void) {
     // crow
     lua_register_norns("crow_send", &_crow_send);
 
+    // hid
+    lua_register_norns("hid_subscribe", &_hid_subscribe);
+
+    // loopback devices
+    lua_register_norns("loopback_add", &_loopback_add);
+    lua_register_norns("loopback_remove", &_loopback_remove);
+    lua_register_norns("loopback_rate", &_loopback_rate);
+    lua_register_norns("loopback_stats", &_loopback_stats);
+
     // util
     lua_register_norns("system_cmd", &_system_cmd);
     lua_register_norns("system_glob", &_system_glob);
@@ -440,6 +489,7 @@ void w_init(void) {
     // low-level monome grid control
     lua_register_norns("grid_set_led", &_grid_set_led);
     lua_register_norns("grid_all_led", &_grid_all_led);
+    lua_register_norns("grid_set_region", &_grid_set_region);
     lua_register_norns("grid_rows", &_grid_rows);
     lua_register_norns("grid_cols", &_grid_cols);
     lua_register_norns("grid_set_rotation", &_grid_set_rotation);
@@ -447,8 +497,11 @@ void w_init(void) {
     lua_register_norns("grid_tilt_disable", &_grid_tilt_disable);
     lua_register_norns("arc_set_led", &_arc_set_led);
     lua_register_norns("arc_all_led", &_arc_all_led);
+    lua_register_norns("arc_set_ring", &_arc_set_ring);
+    lua_register_norns("arc_ring_range", &_arc_ring_range);
     lua_register_norns("monome_refresh", &_monome_refresh);
     lua_register_norns("monome_intensity", &_monome_intensity);
+    lua_register_norns("monome_refresh_rate", &_monome_refresh_rate);
 
     // register screen funcs
     lua_register_norns("screen_update", &_screen_update);
@@ -501,13 +554,22 @@ void w_init(void) {
     // analog output control
     lua_register_norns("gain_hp", &_gain_hp);
     lua_register_norns("adc_rev", &_adc_rev);
+    lua_register_norns("enc_accel", &_enc_accel);
 
     // osc
     lua_register_norns("osc_send", &_osc_send);
     lua_register_norns("osc_send_crone", &_osc_send_crone);
+    lua_register_norns("osc_invalidate", &_osc_invalidate);
+    lua_register_norns("osc_send_stats", &_osc_send_stats);
 
     // midi
     lua_register_norns("midi_send", &_midi_send);
+    lua_register_norns("midi_send_at", &_midi_send_at);
+    lua_register_norns("midi_send_at_beat", &_midi_send_at_beat);
+    lua_register_norns("midi_clear_scheduled", &_midi_clear_scheduled);
+    lua_register_norns("midi_set_filter", &_midi_set_filter);
+    lua_register_norns("midi_clear_filters", &_midi_clear_filters);
+    lua_register_norns("midi_filter_stats", &_midi_filter_stats);
     lua_register_norns("midi_clock_receive", &_midi_clock_receive);
 
     // get list of available crone engines
@@ -519,6 +581,8 @@ void w_init(void) {
 
     // send an indexed command
     lua_register_norns("send_command", &_send_command);
+    lua_register_norns("command_bundling", &_command_bundling);
+    lua_register_norns("command_stats", &_command_stats);
 
     // start/stop an indexed metro with callback
     lua_register_norns("metro_start", &_metro_start);
@@ -563,7 +627,18 @@ void w_init(void) {
     lua_register_norns("clock_link_set_start_stop_sync", &_clock_link_set_start_stop_sync);
     lua_register_norns("clock_set_source", &_clock_set_source);
     lua_register_norns("clock_get_time_beats", &_clock_get_time_beats);
+    lua_register_norns("clock_get_system_time", &_clock_get_system_time);
     lua_register_norns("clock_get_tempo", &_clock_get_tempo);
+    lua_register_norns("clock_lattice_new", &_clock_lattice_new);
+    lua_register_norns("clock_lattice_free", &_clock_lattice_free);
+    lua_register_norns("clock_lattice_free_all", &_clock_lattice_free_all);
+    lua_register_norns("clock_lattice_start", &_clock_lattice_start);
+    lua_register_norns("clock_lattice_stop", &_clock_lattice_stop);
+    lua_register_norns("clock_lattice_reset", &_clock_lattice_reset);
+    lua_register_norns("clock_lattice_add_sprocket", &_clock_lattice_add_sprocket);
+    lua_register_norns("clock_lattice_remove_sprocket", &_clock_lattice_remove_sprocket);
+    lua_register_norns("clock_lattice_set_sprocket", &_clock_lattice_set_sprocket);
+    lua_register_norns("clock_lattice_set_sprocket_delay", &_clock_lattice_set_sprocket_delay);
 
     lua_register_norns("audio_get_cpu_load", &_audio_get_cpu_load);
     lua_register_norns("audio_get_xrun_count", &_audio_get_xrun_count);
@@ -1454,6 +1529,21 @@ int _adc_rev(lua_State *l) {
     return 1;
 }
 
+/***
+ * encoders: enable or disable acceleration of hardware encoders
+ * @function enc_accel
+ * @param n encoder number, or 0 for all
+ * @param enabled boolean
+ */
+int _enc_accel(lua_State *l) {
+    lua_check_num_args(2);
+    int n = (int)luaL_checkinteger(l, 1);
+    luaL_checktype(l, 2, LUA_TBOOLEAN);
+    encoders_set_accel(n, lua_toboolean(l, 2));
+    lua_settop(l, 0);
+    return 0;
+}
+
 /***
  * osc: send to arbitrary address
  * @function osc_send
@@ -1603,73 +1693,386 @@ int _osc_send_crone(lua_State *l) {
     return 0;
 }
 
+/***
+ * osc: forget cached destinations, so they are resolved again on the next send
+ * @function osc_invalidate
+ * @param host (optional) hostname; all hosts if nil
+ * @param port (optional) port; all ports if nil
+ */
+int _osc_invalidate(lua_State *l) {
+    const char *host = luaL_optstring(l, 1, NULL);
+    const char *port = luaL_optstring(l, 2, NULL);
+    osc_invalidate(host, port);
+    lua_settop(l, 0);
+    return 0;
+}
+
+/***
+ * osc: counters for messages sent with osc_send
+ * @function osc_send_stats
+ * @return messages sent
+ * @return messages that failed to resolve or send
+ * @return sends to a cached destination
+ * @return sends that resolved a destination
+ * @return destinations dropped from the cache
+ */
+int _osc_send_stats(lua_State *l) {
+    struct osc_send_stats stats;
+    osc_get_send_stats(&stats);
+    lua_settop(l, 0);
+    lua_pushinteger(l, stats.sent);
+    lua_pushinteger(l, stats.errors);
+    lua_pushinteger(l, stats.hits);
+    lua_pushinteger(l, stats.misses);
+    lua_pushinteger(l, stats.evictions);
+    return 5;
+}
+
+// devices are handed to lua as their registry ids, and looked up again on every call.
+// the device is held until dev_list_release(), so one unplugged in the meantime is skipped
+// rather than freed while it's in use. check every argument before acquiring: a lua error
+// would skip the release.
+static uint32_t _dev_check_id(lua_State *l, int arg) {
+    return (uint32_t)luaL_checkinteger(l, arg);
+}
+
+// the device with `id`, held, if it is still there and of the given type; NULL otherwise
+static union dev *_dev_acquire(uint32_t id, device_t type) {
+    union dev *d = dev_list_acquire(id);
+    if (d == NULL) {
+        return NULL;
+    }
+    device_t t = d->base.type == DEV_TYPE_MIDI_VIRTUAL ? DEV_TYPE_MIDI : d->base.type;
+    if (t != type) {
+        dev_list_release();
+        return NULL;
+    }
+    return d;
+}
+
 /***
  * crow: send
  * @function _crow_send
  */
 int _crow_send(lua_State *l) {
-    struct dev_crow *d;
     const char *s;
 
     if (lua_gettop(l) != 2) {
         return luaL_error(l, "wrong number of arguments");
     }
 
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    d = lua_touserdata(l, 1);
+    uint32_t id = _dev_check_id(l, 1);
     s = luaL_checkstring(l, 2);
+
+    union dev *d = _dev_acquire(id, DEV_TYPE_CROW);
+    if (d != NULL) {
+        dev_crow_send(&d->crow, s);
+        dev_list_release();
+    }
     lua_settop(l, 0);
 
-    dev_crow_send(d, s);
+    return 0;
+}
 
+/***
+ * hid: choose which input codes are delivered
+ * @function hid_subscribe
+ * @param dev hid device
+ * @param type event type, or -1 for all types
+ * @param code event code, or -1 for all codes of the type
+ * @param enabled deliver (true) or drop (false)
+ */
+int _hid_subscribe(lua_State *l) {
+    lua_check_num_args(4);
+    uint32_t id = _dev_check_id(l, 1);
+    int type = (int)luaL_checkinteger(l, 2);
+    int code = (int)luaL_checkinteger(l, 3);
+    bool enabled = lua_toboolean(l, 4);
+    union dev *d = _dev_acquire(id, DEV_TYPE_HID);
+    if (d != NULL) {
+        dev_hid_subscribe(&d->hid, type, code, enabled);
+        dev_list_release();
+    }
+    lua_settop(l, 0);
     return 0;
 }
 
+// helper: device type and node path for a loopback device kind ("midi", "grid", "arc" or "hid") and index
+static device_t _loopback_check_path(lua_State *l, char *path, size_t size) {
+    static const char *const kinds[] = {"midi", "grid", "arc", "hid", NULL};
+    static const device_t types[] = {DEV_TYPE_MIDI, DEV_TYPE_MONOME, DEV_TYPE_MONOME, DEV_TYPE_HID};
+    int kind = luaL_checkoption(l, 1, NULL, kinds);
+    int n = (int)luaL_checkinteger(l, 2);
+    snprintf(path, size, DEV_LOOPBACK_PREFIX "%s/%d", kinds[kind], n);
+    return types[kind];
+}
+
+static struct dev_loopback *_loopback_check_dev(lua_State *l) {
+    char path[64];
+    _loopback_check_path(l, path, sizeof(path));
+    union dev *d = dev_list_lookup_path(path);
+    if (d == NULL) {
+        luaL_error(l, "no loopback device at %s", path);
+        return NULL;
+    }
+    return d->base.loopback;
+}
+
 /***
- * midi: send
- * @function midi_send
+ * loopback: add a software device, announced like hardware being plugged in
+ * @function loopback_add
+ * @param kind "midi", "grid", "arc" or "hid"
+ * @param n index, to tell devices of the same kind apart
  */
-int _midi_send(lua_State *l) {
-    struct dev_midi *md;
-    size_t nbytes;
-    uint8_t *data;
+int _loopback_add(lua_State *l) {
+    char path[64];
+    char name[64];
+    lua_check_num_args(2);
+    device_t type = _loopback_check_path(l, path, sizeof(path));
+    if (dev_list_lookup_path(path) != NULL) {
+        return luaL_error(l, "loopback device %s already exists", path);
+    }
+    snprintf(name, sizeof(name), "loopback %s", path + strlen(DEV_LOOPBACK_PREFIX));
+    lua_settop(l, 0);
+    // the device takes ownership of the name
+    dev_list_add(type, path, strdup(name));
+    return 0;
+}
 
+/***
+ * loopback: remove a software device
+ * @function loopback_remove
+ * @param kind "midi", "grid", "arc" or "hid"
+ * @param n index
+ */
+int _loopback_remove(lua_State *l) {
+    char path[64];
     lua_check_num_args(2);
+    device_t type = _loopback_check_path(l, path, sizeof(path));
+    lua_settop(l, 0);
+    dev_list_remove(type, path);
+    return 0;
+}
+
+/***
+ * loopback: set the rate of generated input
+ * @function loopback_rate
+ * @param kind "midi", "grid", "arc" or "hid"
+ * @param n index
+ * @param rate messages per second (0 to stop)
+ */
+int _loopback_rate(lua_State *l) {
+    lua_check_num_args(3);
+    struct dev_loopback *lb = _loopback_check_dev(l);
+    double rate = luaL_checknumber(l, 3);
+    dev_loopback_set_rate(lb, rate);
+    lua_settop(l, 0);
+    return 0;
+}
 
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    md = lua_touserdata(l, 1);
+/***
+ * loopback: count of generated messages
+ * @function loopback_stats
+ * @param kind "midi", "grid", "arc" or "hid"
+ * @param n index
+ * @return messages written to the device input
+ * @return messages dropped because the input was full
+ */
+int _loopback_stats(lua_State *l) {
+    uint64_t generated;
+    uint64_t dropped;
+    lua_check_num_args(2);
+    struct dev_loopback *lb = _loopback_check_dev(l);
+    dev_loopback_stats(lb, &generated, &dropped);
+    lua_settop(l, 0);
+    lua_pushinteger(l, generated);
+    lua_pushinteger(l, dropped);
+    return 2;
+}
 
-    luaL_checktype(l, 2, LUA_TTABLE);
-    nbytes = lua_rawlen(l, 2);
-    data = malloc(nbytes);
+// helper: copy a table of midi bytes at stack index idx into a new buffer
+static uint8_t *_midi_check_data(lua_State *l, int idx, size_t *nbytes) {
+    luaL_checktype(l, idx, LUA_TTABLE);
+    *nbytes = lua_rawlen(l, idx);
+    uint8_t *data = malloc(*nbytes);
 
-    for (unsigned int i = 1; i <= nbytes; i++) {
+    for (unsigned int i = 1; i <= *nbytes; i++) {
         lua_pushinteger(l, i);
-        lua_gettable(l, 2);
+        lua_gettable(l, idx);
 
         // TODO: lua_isnumber
         data[i - 1] = lua_tointeger(l, -1);
         lua_pop(l, 1);
     }
+    return data;
+}
 
-    dev_midi_send(md, data, nbytes);
+/***
+ * midi: send
+ * queues bytes for immediate output; does not wait for the device
+ * @function midi_send
+ */
+int _midi_send(lua_State *l) {
+    size_t nbytes;
+    uint8_t *data;
+
+    lua_check_num_args(2);
+
+    uint32_t id = _dev_check_id(l, 1);
+
+    data = _midi_check_data(l, 2, &nbytes);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MIDI);
+    if (d != NULL) {
+        dev_midi_send(&d->midi, data, nbytes);
+        dev_list_release();
+    }
+    free(data);
+
+    return 0;
+}
+
+// helper: schedule bytes at a timestamp in the given domain
+static int _midi_send_stamped(lua_State *l, midi_out_stamp_t type) {
+    size_t nbytes;
+    uint8_t *data;
+
+    lua_check_num_args(3);
+
+    uint32_t id = _dev_check_id(l, 1);
+    double stamp = luaL_checknumber(l, 3);
+
+    data = _midi_check_data(l, 2, &nbytes);
+    ssize_t res = -1;
+    union dev *d = _dev_acquire(id, DEV_TYPE_MIDI);
+    if (d != NULL) {
+        res = dev_midi_send_at(&d->midi, type, stamp, data, nbytes);
+        dev_list_release();
+    }
     free(data);
 
+    lua_settop(l, 0);
+    lua_pushboolean(l, res >= 0);
+    return 1;
+}
+
+/***
+ * midi: send at a future clock time
+ * @function midi_send_at
+ * @param dev midi device
+ * @param data table of bytes
+ * @param time clock system time in seconds
+ * @treturn boolean false if the output queue is full
+ */
+int _midi_send_at(lua_State *l) {
+    return _midi_send_stamped(l, MIDI_OUT_STAMP_TIME);
+}
+
+/***
+ * midi: send at a future beat
+ * @function midi_send_at_beat
+ * @param dev midi device
+ * @param data table of bytes
+ * @param beat clock beat
+ * @treturn boolean false if the output queue is full
+ */
+int _midi_send_at_beat(lua_State *l) {
+    return _midi_send_stamped(l, MIDI_OUT_STAMP_BEAT);
+}
+
+/***
+ * midi: discard scheduled output
+ * @function midi_clear_scheduled
+ * @param dev midi device
+ */
+int _midi_clear_scheduled(lua_State *l) {
+    lua_check_num_args(1);
+    uint32_t id = _dev_check_id(l, 1);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MIDI);
+    if (d != NULL) {
+        dev_midi_clear_scheduled(&d->midi);
+        dev_list_release();
+    }
+    lua_settop(l, 0);
+    return 0;
+}
+
+/***
+ * midi: drop incoming messages before they are posted to lua
+ * @function midi_set_filter
+ * @param dev midi device
+ * @param status status byte (channel bits ignored)
+ * @param mask for channel messages, channels to drop (bit 0 = channel 1); otherwise non-zero to drop
+ */
+int _midi_set_filter(lua_State *l) {
+    lua_check_num_args(3);
+    uint32_t id = _dev_check_id(l, 1);
+    int status = (int)luaL_checkinteger(l, 2);
+    int mask = (int)luaL_checkinteger(l, 3);
+    if (status < 0x80 || status > 0xff) {
+        return luaL_error(l, "invalid midi status: %d", status);
+    }
+    union dev *d = _dev_acquire(id, DEV_TYPE_MIDI);
+    if (d != NULL) {
+        dev_midi_set_filter(&d->midi, status, mask & 0xffff);
+        dev_list_release();
+    }
+    lua_settop(l, 0);
+    return 0;
+}
+
+/***
+ * midi: remove all input filters
+ * @function midi_clear_filters
+ * @param dev midi device
+ */
+int _midi_clear_filters(lua_State *l) {
+    lua_check_num_args(1);
+    uint32_t id = _dev_check_id(l, 1);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MIDI);
+    if (d != NULL) {
+        dev_midi_clear_filters(&d->midi);
+        dev_list_release();
+    }
+    lua_settop(l, 0);
     return 0;
 }
 
+/***
+ * midi: input filter counters
+ * @function midi_filter_stats
+ * @param dev midi device
+ * @return number of messages delivered to lua
+ * @return number of messages dropped by the filter
+ */
+int _midi_filter_stats(lua_State *l) {
+    uint64_t delivered = 0, filtered = 0;
+    lua_check_num_args(1);
+    uint32_t id = _dev_check_id(l, 1);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MIDI);
+    if (d != NULL) {
+        dev_midi_filter_stats(&d->midi, &delivered, &filtered);
+        dev_list_release();
+    }
+    lua_settop(l, 0);
+    lua_pushinteger(l, delivered);
+    lua_pushinteger(l, filtered);
+    return 2;
+}
+
 /***
  * midi: clock_receive
  * @function midi_receive
  */
 int _midi_clock_receive(lua_State *l) {
-    struct dev_midi *md;
     lua_check_num_args(2);
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    md = lua_touserdata(l, 1);
+    uint32_t id = _dev_check_id(l, 1);
     int enabled = lua_tointeger(l, 2);
-    md->clock_enabled = enabled > 0;
-    // fprintf(stderr, "set clock_enabled to %d on device %p\n", enabled, md);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MIDI);
+    if (d != NULL) {
+        d->midi.clock_enabled = enabled > 0;
+        dev_list_release();
+    }
+    // fprintf(stderr, "set clock_enabled to %d on device %u\n", enabled, id);
     return 0;
 }
 
@@ -1683,24 +2086,30 @@ int _midi_clock_receive(lua_State *l) {
  */
 int _grid_set_led(lua_State *l) {
     lua_check_num_args(4);
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    struct dev_monome *md = lua_touserdata(l, 1);
+    uint32_t id = _dev_check_id(l, 1);
     int x = (int)luaL_checkinteger(l, 2) - 1; // convert from 1-base
     int y = (int)luaL_checkinteger(l, 3) - 1; // convert from 1-base
     int z = (int)luaL_checkinteger(l, 4);     // don't convert value!
-    dev_monome_grid_set_led(md, x, y, z);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        dev_monome_grid_set_led(&d->monome, x, y, z);
+        dev_list_release();
+    }
     lua_settop(l, 0);
     return 0;
 }
 
 int _arc_set_led(lua_State *l) {
     lua_check_num_args(4);
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    struct dev_monome *md = lua_touserdata(l, 1);
+    uint32_t id = _dev_check_id(l, 1);
     int n = (int)luaL_checkinteger(l, 2) - 1; // convert from 1-base
     int x = (int)luaL_checkinteger(l, 3) - 1; // convert from 1-base
     int val = (int)luaL_checkinteger(l, 4);   // don't convert value!
-    dev_monome_arc_set_led(md, n, x, val);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        dev_monome_arc_set_led(&d->monome, n, x, val);
+        dev_list_release();
+    }
     lua_settop(l, 0);
     return 0;
 }
@@ -1713,10 +2122,13 @@ int _arc_set_led(lua_State *l) {
  */
 int _grid_all_led(lua_State *l) {
     lua_check_num_args(2);
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    struct dev_monome *md = lua_touserdata(l, 1);
+    uint32_t id = _dev_check_id(l, 1);
     int z = (int)luaL_checkinteger(l, 2); // don't convert value!
-    dev_monome_all_led(md, z);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        dev_monome_all_led(&d->monome, z);
+        dev_list_release();
+    }
     lua_settop(l, 0);
     return 0;
 }
@@ -1725,6 +2137,94 @@ int _arc_all_led(lua_State *l) {
     return _grid_all_led(l);
 }
 
+// led levels packed one per byte, in a string or a full userdata
+static const uint8_t *_check_led_levels(lua_State *l, int arg, size_t *len) {
+    if (lua_type(l, arg) == LUA_TUSERDATA) {
+        *len = lua_rawlen(l, arg);
+        return lua_touserdata(l, arg);
+    }
+    return (const uint8_t *)luaL_checklstring(l, arg, len);
+}
+
+/***
+ * grid: set a rectangle of LEDs
+ * @function grid_set_region
+ * @param dev grid device
+ * @param x left column (1-based)
+ * @param y top row (1-based)
+ * @param w width
+ * @param h height
+ * @param levels string of w*h levels (0-15), one byte per LED, row by row
+ */
+int _grid_set_region(lua_State *l) {
+    lua_check_num_args(6);
+    uint32_t id = _dev_check_id(l, 1);
+    int x = (int)luaL_checkinteger(l, 2) - 1; // convert from 1-base
+    int y = (int)luaL_checkinteger(l, 3) - 1; // convert from 1-base
+    int w = (int)luaL_checkinteger(l, 4);
+    int h = (int)luaL_checkinteger(l, 5);
+    size_t len;
+    const uint8_t *levels = _check_led_levels(l, 6, &len);
+    if (w > 0 && h > 0 && len >= (size_t)w * h) {
+        union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+        if (d != NULL) {
+            dev_monome_grid_set_region(&d->monome, x, y, w, h, levels, w);
+            dev_list_release();
+        }
+    } else {
+        fprintf(stderr, "grid_set_region: expected %d levels, got %zu\n", w * h, len);
+    }
+    lua_settop(l, 0);
+    return 0;
+}
+
+/***
+ * arc: set LEDs of a ring
+ * @function arc_set_ring
+ * @param dev arc device
+ * @param n ring (1-based)
+ * @param levels string of up to 64 levels (0-15), one byte per LED
+ */
+int _arc_set_ring(lua_State *l) {
+    lua_check_num_args(3);
+    uint32_t id = _dev_check_id(l, 1);
+    int n = (int)luaL_checkinteger(l, 2) - 1; // convert from 1-base
+    size_t len;
+    const uint8_t *levels = _check_led_levels(l, 3, &len);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        dev_monome_arc_set_ring(&d->monome, n, levels, len);
+        dev_list_release();
+    }
+    lua_settop(l, 0);
+    return 0;
+}
+
+/***
+ * arc: set a range of LEDs on a ring
+ * @function arc_ring_range
+ * @param dev arc device
+ * @param n ring (1-based)
+ * @param x1 first LED (1-based)
+ * @param x2 last LED (1-based), wrapping past 64
+ * @param val level (0-15)
+ */
+int _arc_ring_range(lua_State *l) {
+    lua_check_num_args(5);
+    uint32_t id = _dev_check_id(l, 1);
+    int n = (int)luaL_checkinteger(l, 2) - 1;  // convert from 1-base
+    int x1 = (int)luaL_checkinteger(l, 3) - 1; // convert from 1-base
+    int x2 = (int)luaL_checkinteger(l, 4) - 1; // convert from 1-base
+    int val = (int)luaL_checkinteger(l, 5);    // don't convert value!
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        dev_monome_arc_ring_range(&d->monome, n, x1, x2, val);
+        dev_list_release();
+    }
+    lua_settop(l, 0);
+    return 0;
+}
+
 /***
  * grid: set rotation
  * @param dev grid device
@@ -1732,10 +2232,13 @@ int _arc_all_led(lua_State *l) {
  */
 int _grid_set_rotation(lua_State *l) {
     lua_check_num_args(2);
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    struct dev_monome *md = lua_touserdata(l, 1);
+    uint32_t id = _dev_check_id(l, 1);
     int z = (int)luaL_checkinteger(l, 2); // don't convert value!
-    dev_monome_set_rotation(md, z);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        dev_monome_set_rotation(&d->monome, z);
+        dev_list_release();
+    }
     lua_settop(l, 0);
     return 0;
 }
@@ -1747,10 +2250,13 @@ int _grid_set_rotation(lua_State *l) {
  */
 int _grid_tilt_enable(lua_State *l) {
     lua_check_num_args(2);
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    struct dev_monome *md = lua_touserdata(l, 1);
-    int id = (int)luaL_checkinteger(l, 2); // don't convert value!
-    dev_monome_tilt_enable(md, id);
+    uint32_t id = _dev_check_id(l, 1);
+    int sensor = (int)luaL_checkinteger(l, 2); // don't convert value!
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        dev_monome_tilt_enable(&d->monome, sensor);
+        dev_list_release();
+    }
     lua_settop(l, 0);
     return 0;
 }
@@ -1761,10 +2267,13 @@ int _grid_tilt_enable(lua_State *l) {
  */
 int _grid_tilt_disable(lua_State *l) {
     lua_check_num_args(2);
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    struct dev_monome *md = lua_touserdata(l, 1);
-    int id = (int)luaL_checkinteger(l, 2); // don't convert value!
-    dev_monome_tilt_disable(md, id);
+    uint32_t id = _dev_check_id(l, 1);
+    int sensor = (int)luaL_checkinteger(l, 2); // don't convert value!
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        dev_monome_tilt_disable(&d->monome, sensor);
+        dev_list_release();
+    }
     lua_settop(l, 0);
     return 0;
 }
@@ -1776,9 +2285,12 @@ int _grid_tilt_disable(lua_State *l) {
  */
 int _monome_refresh(lua_State *l) {
     lua_check_num_args(1);
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    struct dev_monome *md = lua_touserdata(l, 1);
-    dev_monome_refresh(md);
+    uint32_t id = _dev_check_id(l, 1);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        dev_monome_refresh(&d->monome);
+        dev_list_release();
+    }
     lua_settop(l, 0);
     return 0;
 }
@@ -1790,10 +2302,32 @@ int _monome_refresh(lua_State *l) {
  */
 int _monome_intensity(lua_State *l) {
     lua_check_num_args(2);
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    struct dev_monome *md = lua_touserdata(l, 1);
+    uint32_t id = _dev_check_id(l, 1);
     int i = (int)luaL_checkinteger(l, 2); // don't convert value!
-    dev_monome_intensity(md, i);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        dev_monome_intensity(&d->monome, i);
+        dev_list_release();
+    }
+    lua_settop(l, 0);
+    return 0;
+}
+
+/***
+ * monome: limit led updates per second
+ * @function monome_refresh_rate
+ * @param dev device
+ * @param fps frames per second
+ */
+int _monome_refresh_rate(lua_State *l) {
+    lua_check_num_args(2);
+    uint32_t id = _dev_check_id(l, 1);
+    double fps = luaL_checknumber(l, 2);
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        dev_monome_set_refresh_rate(&d->monome, fps);
+        dev_list_release();
+    }
     lua_settop(l, 0);
     return 0;
 }
@@ -1805,9 +2339,14 @@ int _monome_intensity(lua_State *l) {
  */
 int _grid_rows(lua_State *l) {
     lua_check_num_args(1);
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    struct dev_monome *md = lua_touserdata(l, 1);
-    lua_pushinteger(l, dev_monome_grid_rows(md));
+    uint32_t id = _dev_check_id(l, 1);
+    int n = 0;
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        n = dev_monome_grid_rows(&d->monome);
+        dev_list_release();
+    }
+    lua_pushinteger(l, n);
     return 1;
 }
 
@@ -1818,9 +2357,14 @@ int _grid_rows(lua_State *l) {
  */
 int _grid_cols(lua_State *l) {
     lua_check_num_args(1);
-    luaL_checktype(l, 1, LUA_TLIGHTUSERDATA);
-    struct dev_monome *md = lua_touserdata(l, 1);
-    lua_pushinteger(l, dev_monome_grid_cols(md));
+    uint32_t id = _dev_check_id(l, 1);
+    int n = 0;
+    union dev *d = _dev_acquire(id, DEV_TYPE_MONOME);
+    if (d != NULL) {
+        n = dev_monome_grid_cols(&d->monome);
+        dev_list_release();
+    }
+    lua_pushinteger(l, n);
     return 1;
 }
 
@@ -1846,68 +2390,85 @@ int _send_command(lua_State *l) {
         return luaL_error(l, "wrong number of arguments");
     }
 
-    char *cmd = NULL;
-    char *fmt = NULL;
-
     int idx = (int)luaL_checkinteger(l, 1) - 1; // 1-base to 0-base
-    // FIXME: this isn't really safe.
-    // to make it safe would mean locks, which is bad.
-    // might be better to put name/fmt on stack from lua on every call
-    cmd = o_get_commands()[idx].name;
-    fmt = o_get_commands()[idx].format;
+    // valid until we return to the event loop
+    const struct engine_command_table *table = o_get_command_table();
+    if (table == NULL || idx < 0 || idx >= table->count) {
+        return luaL_error(l, "invalid command index %d", idx + 1);
+    }
+    const struct engine_command_desc *cmd = &table->commands[idx];
 
-    // FIXME: refactor this, should go in oracle!
-    lo_message msg = lo_message_new();
+    struct engine_command_arg args[ENGINE_COMMAND_MAX_ARGS];
+    int argc = 0;
 
-    const char *s;
-    int d;
-    double f;
-
-    for (int i = 2; i <= nargs; i++) {
-        switch (fmt[i - 2]) {
+    // arguments beyond the format are ignored, as are format characters other than s, i and f
+    for (int i = 2; i <= nargs && cmd->format[i - 2] != '\0' && argc < cmd->argc; i++) {
+        switch (cmd->format[i - 2]) {
         case 's':
-            if (lua_isstring(l, i)) {
-                s = lua_tostring(l, i);
-                lo_message_add_string(msg, s);
-            } else {
-                lo_message_free(msg);
+            if (!lua_isstring(l, i)) {
                 return luaL_error(l, "failed string type check");
             }
+            args[argc].type = 's';
+            args[argc++].s = lua_tostring(l, i);
             break;
         case 'i':
-            if (lua_isnumber(l, i)) {
-                d = (int)lua_tonumber(l, i);
-                lo_message_add_int32(msg, d);
-            } else {
-                lo_message_free(msg);
+            if (!lua_isnumber(l, i)) {
                 return luaL_error(l, "failed int type check");
             }
+            args[argc].type = 'i';
+            args[argc++].i = (int32_t)lua_tonumber(l, i);
             break;
         case 'f':
-            if (lua_isnumber(l, i)) {
-                f = lua_tonumber(l, i);
-                lo_message_add_float(msg, (float)f);
-            } else {
-                lo_message_free(msg);
+            if (!lua_isnumber(l, i)) {
                 return luaL_error(l, "failed double type check");
             }
+            args[argc].type = 'f';
+            args[argc++].f = (float)lua_tonumber(l, i);
             break;
         default:
             break;
         } /* switch */
     }
 
-    if ((cmd == NULL) || (fmt == NULL)) {
-        lo_message_free(msg);
-        return luaL_error(l, "null format/command string");
-    }
+    o_send_command_args(cmd, args, argc);
+    lua_settop(l, 0);
+    return 0;
+}
 
-    o_send_command(cmd, msg);
-    lo_message_free(msg);
+/***
+ * engine: send the commands issued while handling each event as one OSC bundle
+ * @function command_bundling
+ * @param enabled boolean
+ * @param latency (optional) seconds ahead to timestamp bundles for scheduling; default 0 (immediate)
+ */
+int _command_bundling(lua_State *l) {
+    luaL_checktype(l, 1, LUA_TBOOLEAN);
+    bool enabled = lua_toboolean(l, 1);
+    double latency = luaL_optnumber(l, 2, 0);
+    if (latency < 0) {
+        return luaL_argerror(l, 2, "latency must not be negative");
+    }
+    o_set_command_bundling(enabled, latency);
     lua_settop(l, 0);
     return 0;
 }
 
+/***
+ * engine: count of commands sent and the packets that carried them
+ * @function command_stats
+ * @return commands sent
+ * @return UDP packets sent
+ */
+int _command_stats(lua_State *l) {
+    uint64_t commands;
+    uint64_t packets;
+    lua_check_num_args(0);
+    o_command_stats(&commands, &packets);
+    lua_pushinteger(l, commands);
+    lua_pushinteger(l, packets);
+    return 2;
+}
+
 int _request_engine_report(lua_State *l) {
     o_request_engine_report();
     return 0;
@@ -2110,11 +2671,120 @@ int _clock_get_time_beats(lua_State *l) {
     return 1;
 }
 
+int _clock_get_system_time(lua_State *l) {
+    lua_pushnumber(l, clock_get_system_time());
+    return 1;
+}
+
 int _clock_get_tempo(lua_State *l) {
     lua_pushnumber(l, clock_get_tempo());
     return 1;
 }
 
+/***
+ * clock: create a native lattice
+ * @function clock_lattice_new
+ * @param ppqn pulses per quarter note
+ * @return lattice id (1-based), or nil if none are available
+ */
+int _clock_lattice_new(lua_State *l) {
+    lua_check_num_args(1);
+    int ppqn = (int)luaL_checkinteger(l, 1);
+    int id = clock_lattice_new(ppqn);
+    if (id < 0) {
+        lua_pushnil(l);
+    } else {
+        lua_pushinteger(l, id + 1);
+    }
+    return 1;
+}
+
+int _clock_lattice_free(lua_State *l) {
+    lua_check_num_args(1);
+    int id = (int)luaL_checkinteger(l, 1) - 1;
+    clock_lattice_free(id);
+    return 0;
+}
+
+int _clock_lattice_free_all(lua_State *l) {
+    clock_lattice_free_all();
+    return 0;
+}
+
+int _clock_lattice_start(lua_State *l) {
+    lua_check_num_args(1);
+    int id = (int)luaL_checkinteger(l, 1) - 1;
+    clock_lattice_start(id);
+    return 0;
+}
+
+int _clock_lattice_stop(lua_State *l) {
+    lua_check_num_args(1);
+    int id = (int)luaL_checkinteger(l, 1) - 1;
+    clock_lattice_stop(id);
+    return 0;
+}
+
+int _clock_lattice_reset(lua_State *l) {
+    lua_check_num_args(1);
+    int id = (int)luaL_checkinteger(l, 1) - 1;
+    clock_lattice_reset(id);
+    return 0;
+}
+
+/***
+ * clock: add a sprocket to a native lattice
+ * @function clock_lattice_add_sprocket
+ * @param lattice lattice id
+ * @param sprocket sprocket id, unique within the lattice
+ * @param order firing order (1-5)
+ * @param division
+ * @param swing
+ * @param delay
+ * @param enabled
+ * @return true on success
+ */
+int _clock_lattice_add_sprocket(lua_State *l) {
+    lua_check_num_args(7);
+    int id = (int)luaL_checkinteger(l, 1) - 1;
+    int sprocket = (int)luaL_checkinteger(l, 2);
+    int order = (int)luaL_checkinteger(l, 3);
+    double division = luaL_checknumber(l, 4);
+    double swing = luaL_checknumber(l, 5);
+    double delay = luaL_checknumber(l, 6);
+    bool enabled = lua_toboolean(l, 7);
+    lua_pushboolean(l, clock_lattice_add_sprocket(id, sprocket, order, division, swing, delay, enabled));
+    return 1;
+}
+
+int _clock_lattice_remove_sprocket(lua_State *l) {
+    lua_check_num_args(2);
+    int id = (int)luaL_checkinteger(l, 1) - 1;
+    int sprocket = (int)luaL_checkinteger(l, 2);
+    clock_lattice_remove_sprocket(id, sprocket);
+    return 0;
+}
+
+int _clock_lattice_set_sprocket(lua_State *l) {
+    lua_check_num_args(5);
+    int id = (int)luaL_checkinteger(l, 1) - 1;
+    int sprocket = (int)luaL_checkinteger(l, 2);
+    bool enabled = lua_toboolean(l, 3);
+    double division = luaL_checknumber(l, 4);
+    double swing = luaL_checknumber(l, 5);
+    clock_lattice_set_sprocket(id, sprocket, enabled, division, swing);
+    return 0;
+}
+
+int _clock_lattice_set_sprocket_delay(lua_State *l) {
+    lua_check_num_args(3);
+    int id = (int)luaL_checkinteger(l, 1) - 1;
+    int sprocket = (int)luaL_checkinteger(l, 2);
+    double delay = luaL_checknumber(l, 3);
+    clock_lattice_set_sprocket_delay(id, sprocket, delay);
+    return 0;
+}
+
 int _audio_get_cpu_load(lua_State *l) {
     lua_pushnumber(l, jack_client_get_cpu_load());
     return 1;
@@ -2157,7 +2827,7 @@ void w_handle_monome_add(void *mdev) {
     lua_pushinteger(lvm, id + 1); // convert to 1-base
     lua_pushstring(lvm, serial);
     lua_pushstring(lvm, name);
-    lua_pushlightuserdata(lvm, mdev);
+    lua_pushinteger(lvm, id); // registry id, as a handle
     l_report(lvm, l_docall(lvm, 4, 0));
 }
 
@@ -2226,7 +2896,7 @@ void w_handle_hid_add(void *p) {
         lua_rawseti(lvm, -2, i + 1);
     }
 
-    lua_pushlightuserdata(lvm, dev);
+    lua_pushinteger(lvm, id); // registry id, as a handle
     lua_pushstring(lvm, dev->guid);
     l_report(lvm, l_docall(lvm, 6, 0));
 }
@@ -2246,15 +2916,30 @@ void w_handle_hid_event(int id, uint8_t type, dev_code_t code, int value) {
     l_report(lvm, l_docall(lvm, 4, 0));
 }
 
+void w_handle_hid_frame(int id, struct event_hid_frame_entry *entries, size_t count) {
+    _push_norns_func("hid", "frame");
+    lua_pushinteger(lvm, id + 1); // convert to 1-base
+    // flat array of type, code, value triples
+    lua_createtable(lvm, count * 3, 0);
+    for (size_t i = 0; i < count; i++) {
+        lua_pushinteger(lvm, entries[i].type);
+        lua_rawseti(lvm, -2, i * 3 + 1);
+        lua_pushinteger(lvm, entries[i].code);
+        lua_rawseti(lvm, -2, i * 3 + 2);
+        lua_pushinteger(lvm, entries[i].value);
+        lua_rawseti(lvm, -2, i * 3 + 3);
+    }
+    l_report(lvm, l_docall(lvm, 2, 0));
+}
+
 void w_handle_crow_add(void *p) {
-    struct dev_crow *dev = (struct dev_crow *)p;
     struct dev_common *base = (struct dev_common *)p;
     int id = base->id;
 
     _push_norns_func("crow", "add");
     lua_pushinteger(lvm, id + 1); // convert to 1-base
     lua_pushstring(lvm, base->name);
-    lua_pushlightuserdata(lvm, dev);
+    lua_pushinteger(lvm, id); // registry id, as a handle
     l_report(lvm, l_docall(lvm, 3, 0));
 }
 
@@ -2264,23 +2949,22 @@ void w_handle_crow_remove(int id) {
     l_report(lvm, l_docall(lvm, 1, 0));
 }
 
-void w_handle_crow_event(void *dev, int id) {
-    struct dev_crow *d = (struct dev_crow *)dev;
+void w_handle_crow_event(void *dev, int id, const char *line) {
+    (void)dev;
     _push_norns_func("crow", "event");
     lua_pushinteger(lvm, id + 1); // convert to 1-base
-    lua_pushstring(lvm, d->line);
+    lua_pushstring(lvm, line);
     l_report(lvm, l_docall(lvm, 2, 0));
 }
 
 void w_handle_midi_add(void *p) {
-    struct dev_midi *dev = (struct dev_midi *)p;
     struct dev_common *base = (struct dev_common *)p;
     int id = base->id;
 
     _push_norns_func("midi", "add");
     lua_pushinteger(lvm, id + 1); // convert to 1-base
     lua_pushstring(lvm, base->name);
-    lua_pushlightuserdata(lvm, dev);
+    lua_pushinteger(lvm, id); // registry id, as a handle
     l_report(lvm, l_docall(lvm, 3, 0));
 }
 
@@ -2290,7 +2974,7 @@ void w_handle_midi_remove(int id) {
     l_report(lvm, l_docall(lvm, 1, 0));
 }
 
-void w_handle_midi_event(int id, uint8_t *data, size_t nbytes) {
+void w_handle_midi_event(int id, uint8_t *data, size_t nbytes, double timestamp) {
     _push_norns_func("midi", "event");
     lua_pushinteger(lvm, id + 1); // convert to 1-base
     lua_createtable(lvm, nbytes, 0);
@@ -2298,51 +2982,41 @@ void w_handle_midi_event(int id, uint8_t *data, size_t nbytes) {
         lua_pushinteger(lvm, data[i]);
         lua_rawseti(lvm, -2, i + 1);
     }
-    l_report(lvm, l_docall(lvm, 2, 0));
+    lua_pushnumber(lvm, timestamp);
+    l_report(lvm, l_docall(lvm, 3, 0));
 }
 
-void w_handle_osc_event(char *from_host, char *from_port, char *path, lo_message msg) {
-    const char *types = NULL;
-    int argc;
-    lo_arg **argv = NULL;
-
-    types = lo_message_get_types(msg);
-    argc = lo_message_get_argc(msg);
-    argv = lo_message_get_argv(msg);
+void w_handle_midi_sysex(int id, uint8_t *data, size_t nbytes, double timestamp) {
+    _push_norns_func("midi", "sysex");
+    lua_pushinteger(lvm, id + 1); // convert to 1-base
+    lua_pushlstring(lvm, (const char *)data, nbytes);
+    lua_pushnumber(lvm, timestamp);
+    l_report(lvm, l_docall(lvm, 3, 0));
+}
 
+void w_handle_osc_event(const struct osc_packet *pkt) {
     _push_norns_func("osc", "event");
 
-    lua_pushstring(lvm, path);
+    lua_pushstring(lvm, pkt->path);
 
-    lua_createtable(lvm, argc, 0);
-    for (int i = 0; i < argc; i++) {
-        switch (types[i]) {
+    lua_createtable(lvm, pkt->argc, 0);
+    for (int i = 0; i < pkt->argc; i++) {
+        const struct osc_packet_arg *arg = &pkt->args[i];
+        switch (arg->type) {
         case LO_INT32:
-            lua_pushinteger(lvm, argv[i]->i);
-            break;
-        case LO_FLOAT:
-            lua_pushnumber(lvm, argv[i]->f);
-            break;
-        case LO_STRING:
-            lua_pushstring(lvm, &argv[i]->s);
-            break;
-        case LO_BLOB:
-            lua_pushlstring(lvm, lo_blob_dataptr((lo_blob)argv[i]), lo_blob_datasize((lo_blob)argv[i]));
-            break;
         case LO_INT64:
-            lua_pushinteger(lvm, argv[i]->h);
+            lua_pushinteger(lvm, arg->v.i);
             break;
+        case LO_FLOAT:
         case LO_DOUBLE:
-            lua_pushnumber(lvm, argv[i]->d);
+            lua_pushnumber(lvm, arg->v.f);
             break;
+        case LO_STRING:
         case LO_SYMBOL:
-            lua_pushstring(lvm, &argv[i]->S);
-            break;
+        case LO_BLOB:
         case LO_CHAR:
-            lua_pushlstring(lvm, (const char *)&argv[i]->c, 1);
-            break;
         case LO_MIDI:
-            lua_pushlstring(lvm, (const char *)&argv[i]->m, 4);
+            lua_pushlstring(lvm, arg->v.s, arg->len);
             break;
         case LO_TRUE:
             lua_pushboolean(lvm, 1);
@@ -2357,7 +3031,7 @@ void w_handle_osc_event(char *from_host, char *from_port, char *path, lo_message
             lua_pushnumber(lvm, INFINITY);
             break;
         default:
-            fprintf(stderr, "unknown osc typetag: %c\n", types[i]);
+            fprintf(stderr, "unknown osc typetag: %c\n", arg->type);
             lua_pushnil(lvm);
             break;
         } /* switch */
@@ -2365,9 +3039,9 @@ void w_handle_osc_event(char *from_host, char *from_port, char *path, lo_message
     }
 
     lua_createtable(lvm, 2, 0);
-    lua_pushstring(lvm, from_host);
+    lua_pushstring(lvm, pkt->host);
     lua_rawseti(lvm, -2, 1);
-    lua_pushstring(lvm, from_port);
+    lua_pushstring(lvm, pkt->port);
     lua_rawseti(lvm, -2, 2);
 
     l_report(lvm, l_docall(lvm, 3, 0));
@@ -2502,6 +3176,15 @@ void w_handle_clock_stop() {
     l_report(lvm, l_docall(lvm, 0, 0));
 }
 
+void w_handle_clock_lattice(int lattice, int sprocket, uint32_t transport, double phase) {
+    _push_norns_func("clock", "lattice");
+    lua_pushinteger(lvm, lattice + 1);
+    lua_pushinteger(lvm, sprocket);
+    lua_pushinteger(lvm, transport);
+    lua_pushnumber(lvm, phase);
+    l_report(lvm, l_docall(lvm, 4, 0));
+}
+
 // gpio handler
 void w_handle_key(const int n, const int val) {
     lua_getglobal(lvm, "_norns");
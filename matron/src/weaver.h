@@ -40,16 +40,18 @@ extern void w_handle_arc_encoder_key(int id, int number, int state);
 extern void w_handle_hid_add(void *dev);
 extern void w_handle_hid_remove(int id);
 extern void w_handle_hid_event(int id, uint8_t type, dev_code_t code, int val);
+extern void w_handle_hid_frame(int id, struct event_hid_frame_entry *entries, size_t count);
 
 extern void w_handle_midi_add(void *dev);
 extern void w_handle_midi_remove(int id);
-extern void w_handle_midi_event(int id, uint8_t *data, size_t nbytes);
+extern void w_handle_midi_event(int id, uint8_t *data, size_t nbytes, double timestamp);
+extern void w_handle_midi_sysex(int id, uint8_t *data, size_t nbytes, double timestamp);
 
 extern void w_handle_crow_add(void *dev);
 extern void w_handle_crow_remove(int id);
-extern void w_handle_crow_event(void *dev, int id);
+extern void w_handle_crow_event(void *dev, int id, const char *line);
 
-extern void w_handle_osc_event(char *from_host, char *from_port, char *path, lo_message msg);
+extern void w_handle_osc_event(const struct osc_packet *pkt);
 
 //--- audio engine introspection
 extern void w_handle_engine_report(const char **arr, const int num);
@@ -74,6 +76,7 @@ extern void w_handle_metro(const int idx, const int stage);
 extern void w_handle_clock_resume(const int thread_id, double value);
 extern void w_handle_clock_start();
 extern void w_handle_clock_stop();
+extern void w_handle_clock_lattice(int lattice, int sprocket, uint32_t transport, double phase);
 
 //--- crone poll handlers
 extern void w_handle_poll_value(int idx, float val);
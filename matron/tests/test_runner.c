@@ -14,6 +14,13 @@ extern void test_hal_input(void);
 extern void test_hal_audio(void);
 extern void test_hal_system(void);
 
+extern void test_shm_ring_init(void);
+extern void test_shm_ring_wraparound(void);
+extern void test_shm_ring_full(void);
+extern void test_shm_ring_wakeups(void);
+extern void test_shm_ring_wakeup_across_wrap(void);
+extern void test_shm_ring_oversized(void);
+
 // Mock function state tracking
 extern bool screen_init_called;
 extern bool screen_deinit_called;
@@ -42,5 +49,13 @@ int main(void) {
     RUN_TEST(test_hal_audio);
     RUN_TEST(test_hal_system);
 
+    // shared-memory ring tests
+    RUN_TEST(test_shm_ring_init);
+    RUN_TEST(test_shm_ring_wraparound);
+    RUN_TEST(test_shm_ring_full);
+    RUN_TEST(test_shm_ring_wakeups);
+    RUN_TEST(test_shm_ring_wakeup_across_wrap);
+    RUN_TEST(test_shm_ring_oversized);
+
     return UNITY_END();
 }
\ No newline at end of file
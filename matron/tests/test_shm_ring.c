@@ -0,0 +1,164 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "shm_ring.h"
+#include "unity.h"
+
+static struct shm_ring ring;
+
+// a packet of `len` bytes, each the low byte of `seq` plus its offset
+static void fill_packet(uint8_t *dst, size_t len, uint32_t seq) {
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = (uint8_t)(seq + i);
+    }
+}
+
+static bool check_packet(const uint8_t *src, size_t len, uint32_t seq) {
+    for (size_t i = 0; i < len; i++) {
+        if (src[i] != (uint8_t)(seq + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool push(size_t len, uint32_t seq) {
+    uint8_t *dst = shm_ring_reserve(&ring, len);
+    if (dst == NULL) {
+        return false;
+    }
+    fill_packet(dst, len, seq);
+    shm_ring_commit(&ring, len);
+    return true;
+}
+
+static void pop(size_t expected_len, uint32_t seq) {
+    size_t len = 0;
+    const uint8_t *src = shm_ring_peek(&ring, &len);
+    TEST_ASSERT_NOT_NULL(src);
+    TEST_ASSERT_EQUAL_UINT32(expected_len, len);
+    TEST_ASSERT_TRUE(check_packet(src, len, seq));
+    shm_ring_release(&ring, len);
+}
+
+void test_shm_ring_init(void) {
+    memset(&ring, 0, sizeof(ring));
+    TEST_ASSERT_FALSE(shm_ring_valid(&ring));
+    shm_ring_init(&ring);
+    TEST_ASSERT_TRUE(shm_ring_valid(&ring));
+    size_t len;
+    TEST_ASSERT_NULL(shm_ring_peek(&ring, &len));
+}
+
+// records of awkward sizes, with the producer running ahead, go round the ring many times
+void test_shm_ring_wraparound(void) {
+    enum { Backlog = 32 };
+    size_t lens[Backlog];
+    uint32_t produced = 0;
+    uint32_t consumed = 0;
+    uint32_t rng = 1;
+    int wraps = 0;
+    const uint8_t *last = NULL;
+
+    shm_ring_init(&ring);
+    while (consumed < 2000) {
+        // keep up to Backlog records in flight
+        while (produced - consumed < Backlog) {
+            rng = rng * 1664525u + 1013904223u;
+            size_t len = 1 + (rng >> 8) % 3000;
+            if (!push(len, produced)) {
+                break;
+            }
+            lens[produced % Backlog] = len;
+            produced++;
+        }
+        // then take some back, so head and tail both cross the end at varying offsets
+        uint32_t n = 1 + (rng >> 20) % (produced - consumed);
+        for (uint32_t i = 0; i < n; i++) {
+            size_t len;
+            const uint8_t *src = shm_ring_peek(&ring, &len);
+            TEST_ASSERT_NOT_NULL(src);
+            if (last != NULL && src < last) {
+                wraps++;
+            }
+            last = src;
+            pop(lens[consumed % Backlog], consumed);
+            consumed++;
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(10, wraps);
+}
+
+// a full ring refuses records until the consumer makes room
+void test_shm_ring_full(void) {
+    // 4 bytes of length plus 1020 of packet: 1024 to a record, so 64 fill the ring exactly
+    const size_t len = 1020;
+    const int fit = SHM_RING_SIZE / 1024;
+
+    shm_ring_init(&ring);
+    for (int i = 0; i < fit; i++) {
+        TEST_ASSERT_TRUE(push(len, i));
+    }
+    TEST_ASSERT_NULL(shm_ring_reserve(&ring, len));
+    TEST_ASSERT_NULL(shm_ring_reserve(&ring, 1));
+
+    pop(len, 0);
+    TEST_ASSERT_TRUE(push(len, fit));
+    TEST_ASSERT_NULL(shm_ring_reserve(&ring, 1));
+
+    for (int i = 1; i <= fit; i++) {
+        pop(len, i);
+    }
+    size_t n;
+    TEST_ASSERT_NULL(shm_ring_peek(&ring, &n));
+}
+
+// the producer wakes the consumer only on empty -> non-empty; the consumer sleeps only on empty
+void test_shm_ring_wakeups(void) {
+    shm_ring_init(&ring);
+
+    TEST_ASSERT_NOT_NULL(shm_ring_reserve(&ring, 16));
+    TEST_ASSERT_TRUE(shm_ring_commit(&ring, 16));
+    TEST_ASSERT_NOT_NULL(shm_ring_reserve(&ring, 16));
+    TEST_ASSERT_FALSE(shm_ring_commit(&ring, 16));
+
+    size_t len;
+    TEST_ASSERT_NOT_NULL(shm_ring_peek(&ring, &len));
+    TEST_ASSERT_FALSE(shm_ring_release(&ring, len));
+    TEST_ASSERT_NOT_NULL(shm_ring_peek(&ring, &len));
+    TEST_ASSERT_TRUE(shm_ring_release(&ring, len));
+
+    // empty again, so the next commit needs a wakeup
+    TEST_ASSERT_NOT_NULL(shm_ring_reserve(&ring, 16));
+    TEST_ASSERT_TRUE(shm_ring_commit(&ring, 16));
+}
+
+// a commit that has to skip the end of the ring still reports an empty ring
+void test_shm_ring_wakeup_across_wrap(void) {
+    const size_t len = 1000;
+    shm_ring_init(&ring);
+    // 65 records of 1008 bytes leave 16 at the end, too few for the next
+    for (int i = 0; i < 65; i++) {
+        TEST_ASSERT_TRUE(push(len, i));
+        pop(len, i);
+    }
+    TEST_ASSERT_NOT_NULL(shm_ring_reserve(&ring, len));
+    TEST_ASSERT_TRUE(shm_ring_commit(&ring, len));
+    size_t n;
+    const void *p = shm_ring_peek(&ring, &n);
+    TEST_ASSERT_EQUAL_PTR(&ring.data[sizeof(uint32_t)], p);
+    TEST_ASSERT_TRUE(shm_ring_release(&ring, n));
+}
+
+void test_shm_ring_oversized(void) {
+    shm_ring_init(&ring);
+    TEST_ASSERT_NULL(shm_ring_reserve(&ring, SHM_RING_RECORD_MAX + 1));
+    TEST_ASSERT_NULL(shm_ring_reserve(&ring, SHM_RING_SIZE));
+    // nothing was published by the refusals
+    size_t n;
+    TEST_ASSERT_NULL(shm_ring_peek(&ring, &n));
+
+    TEST_ASSERT_TRUE(push(SHM_RING_RECORD_MAX, 7));
+    pop(SHM_RING_RECORD_MAX, 7);
+}
@@ -0,0 +1,24 @@
+#include "unity.h"
+#include <stdio.h>
+
+// shared-memory ring test function declarations
+extern void test_shm_ring_init(void);
+extern void test_shm_ring_wraparound(void);
+extern void test_shm_ring_full(void);
+extern void test_shm_ring_wakeups(void);
+extern void test_shm_ring_wakeup_across_wrap(void);
+extern void test_shm_ring_oversized(void);
+
+// shared-memory ring test runner
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_shm_ring_init);
+    RUN_TEST(test_shm_ring_wraparound);
+    RUN_TEST(test_shm_ring_full);
+    RUN_TEST(test_shm_ring_wakeups);
+    RUN_TEST(test_shm_ring_wakeup_across_wrap);
+    RUN_TEST(test_shm_ring_oversized);
+
+    return UNITY_END();
+}
@@ -0,0 +1,98 @@
+// compare matron's OSC receive-side handling: the old per-message strdup/clone,
+// against decoding into pooled packets (matron/src/osc_packet.c).
+//
+// usage: osc-bench-rx [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <lo/lo.h>
+
+#include "osc_packet.h"
+
+#define BATCH 64
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct legacy_event {
+    char *path;
+    char *from_host;
+    char *from_port;
+    lo_message msg;
+};
+
+// what osc_receive() and event_data_free() used to do per message
+static double run_legacy(long iterations, const char *path, lo_message msg) {
+    struct legacy_event ev[BATCH];
+    double start = now();
+    for (long n = 0; n < iterations; n += BATCH) {
+        for (int i = 0; i < BATCH; i++) {
+            ev[i].path = strdup(path);
+            ev[i].msg = lo_message_clone(msg);
+            ev[i].from_host = strdup("192.168.1.20");
+            ev[i].from_port = strdup("57121");
+        }
+        for (int i = 0; i < BATCH; i++) {
+            free(ev[i].path);
+            free(ev[i].from_host);
+            free(ev[i].from_port);
+            lo_message_free(ev[i].msg);
+        }
+    }
+    return now() - start;
+}
+
+static double run_pooled(long iterations, const char *path, lo_message msg) {
+    struct osc_packet *pkt[BATCH];
+    const char *types = lo_message_get_types(msg);
+    int argc = lo_message_get_argc(msg);
+    lo_arg **argv = lo_message_get_argv(msg);
+    double start = now();
+    for (long n = 0; n < iterations; n += BATCH) {
+        // a batch in flight, as when the event loop falls behind the server thread
+        for (int i = 0; i < BATCH; i++) {
+            pkt[i] = osc_packet_new(path, types, argv, argc, "192.168.1.20", "57121");
+        }
+        for (int i = 0; i < BATCH; i++) {
+            osc_packet_free(pkt[i]);
+        }
+    }
+    return now() - start;
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 2000000;
+    const char *path = "/param/cutoff";
+
+    osc_packet_pool_init();
+
+    lo_message msg = lo_message_new();
+    lo_message_add_int32(msg, 1);
+    lo_message_add_float(msg, 0.5f);
+    lo_message_add_string(msg, "voice");
+    lo_message_add_double(msg, 440.0);
+
+    // warm up allocator and caches
+    run_legacy(iterations / 10, path, msg);
+    run_pooled(iterations / 10, path, msg);
+
+    double legacy = run_legacy(iterations, path, msg);
+    double pooled = run_pooled(iterations, path, msg);
+
+    printf("messages: %ld (%s ,ifsd)\n", iterations, path);
+    printf("legacy  %10.0f msg/s\n", iterations / legacy);
+    printf("pooled  %10.0f msg/s  (x%.2f)\n", iterations / pooled, legacy / pooled);
+
+    uint64_t in_pool, on_heap;
+    osc_packet_stats(&in_pool, &on_heap);
+    printf("pool slots used %llu, heap fallbacks %llu\n", (unsigned long long)in_pool, (unsigned long long)on_heap);
+
+    lo_message_free(msg);
+    return 0;
+}
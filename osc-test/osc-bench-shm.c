@@ -0,0 +1,233 @@
+// compare the transports between matron and crone: localhost UDP, against the shared-memory
+// rings with eventfd wakeups (matron/src/shm_ring.c).
+//
+// two processes exchange OSC-sized packets. latency is measured by ping-pong round trips;
+// throughput by streaming packets one way as fast as the receiver takes them. both transports
+// carry the same serialised bytes, so liblo's encode/decode cost is left out of the comparison.
+//
+// usage: osc-bench-shm [round trips] [streamed packets]
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shm_ring.h"
+
+// "/set/level/cut" ,if 1 0.5 -- a typical matron->crone message
+#define PACKET_SIZE 28
+#define UDP_PORT_A 57901
+#define UDP_PORT_B 57902
+
+struct shm_pair {
+    struct shm_ring a_to_b;
+    struct shm_ring b_to_a;
+};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void report_latency(const char *name, double *rtt, long n) {
+    qsort(rtt, n, sizeof(double), compare_double);
+    printf("%-4s one-way latency  median %7.2f us   p99 %7.2f us\n", name, rtt[n / 2] * 0.5e6,
+           rtt[n * 99 / 100] * 0.5e6);
+}
+
+//--- UDP
+
+static int udp_socket(int port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int size = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    // packets can be dropped; don't wait forever for one
+    struct timeval tv = {.tv_sec = 1, .tv_usec = 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        exit(1);
+    }
+    return fd;
+}
+
+static void udp_connect(int fd, int port) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+static void udp_echo(long rounds) {
+    int fd = udp_socket(UDP_PORT_B);
+    udp_connect(fd, UDP_PORT_A);
+    uint8_t buf[PACKET_SIZE];
+    for (long i = 0; i < rounds; i++) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            send(fd, buf, n, 0);
+        }
+    }
+    // stream: count until the end marker, then report how many arrived
+    long count = 0;
+    for (;;) {
+        if (recv(fd, buf, sizeof(buf), 0) < 0 || buf[0] == 0xff) {
+            break;
+        }
+        count++;
+    }
+    send(fd, &count, sizeof(count), 0);
+    close(fd);
+}
+
+static void udp_bench(long rounds, long stream, const uint8_t *packet) {
+    int fd = udp_socket(UDP_PORT_A);
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fd);
+        udp_echo(rounds);
+        _exit(0);
+    }
+    udp_connect(fd, UDP_PORT_B);
+    usleep(100000);
+
+    uint8_t buf[PACKET_SIZE];
+    double *rtt = malloc(rounds * sizeof(double));
+    for (long i = 0; i < rounds; i++) {
+        double t = now();
+        send(fd, packet, PACKET_SIZE, 0);
+        recv(fd, buf, sizeof(buf), 0);
+        rtt[i] = now() - t;
+    }
+    report_latency("udp", rtt, rounds);
+
+    double t = now();
+    for (long i = 0; i < stream; i++) {
+        send(fd, packet, PACKET_SIZE, 0);
+    }
+    uint8_t end[PACKET_SIZE] = {0xff};
+    send(fd, end, sizeof(end), 0);
+    long received = 0;
+    recv(fd, &received, sizeof(received), 0);
+    t = now() - t;
+    printf("udp  throughput %10.0f msg/s  (%ld of %ld delivered)\n", received / t, received, stream);
+
+    waitpid(pid, NULL, 0);
+    free(rtt);
+    close(fd);
+}
+
+//--- shared memory
+
+static void shm_send(struct shm_ring *ring, int wake_fd, const void *data, size_t len) {
+    void *dst;
+    // the benchmark never drops; spin until the receiver makes room
+    while ((dst = shm_ring_reserve(ring, len)) == NULL) {
+    }
+    memcpy(dst, data, len);
+    if (shm_ring_commit(ring, len)) {
+        uint64_t one = 1;
+        write(wake_fd, &one, sizeof(one));
+    }
+}
+
+// block until a packet arrives, copy it out and release it
+static size_t shm_recv(struct shm_ring *ring, int wake_fd, void *buf, size_t size) {
+    const void *data;
+    size_t len;
+    while ((data = shm_ring_peek(ring, &len)) == NULL) {
+        uint64_t count;
+        read(wake_fd, &count, sizeof(count));
+    }
+    memcpy(buf, data, len < size ? len : size);
+    shm_ring_release(ring, len);
+    return len;
+}
+
+static void shm_bench(long rounds, long stream, const uint8_t *packet) {
+    struct shm_pair *mem =
+        mmap(NULL, sizeof(struct shm_pair), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    shm_ring_init(&mem->a_to_b);
+    shm_ring_init(&mem->b_to_a);
+    int wake_a = eventfd(0, 0);
+    int wake_b = eventfd(0, 0);
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        uint8_t buf[PACKET_SIZE];
+        for (long i = 0; i < rounds; i++) {
+            size_t n = shm_recv(&mem->a_to_b, wake_b, buf, sizeof(buf));
+            shm_send(&mem->b_to_a, wake_a, buf, n);
+        }
+        long count = 0;
+        for (;;) {
+            shm_recv(&mem->a_to_b, wake_b, buf, sizeof(buf));
+            if (buf[0] == 0xff) {
+                break;
+            }
+            count++;
+        }
+        shm_send(&mem->b_to_a, wake_a, &count, sizeof(count));
+        _exit(0);
+    }
+
+    uint8_t buf[PACKET_SIZE];
+    double *rtt = malloc(rounds * sizeof(double));
+    for (long i = 0; i < rounds; i++) {
+        double t = now();
+        shm_send(&mem->a_to_b, wake_b, packet, PACKET_SIZE);
+        shm_recv(&mem->b_to_a, wake_a, buf, sizeof(buf));
+        rtt[i] = now() - t;
+    }
+    report_latency("shm", rtt, rounds);
+
+    double t = now();
+    for (long i = 0; i < stream; i++) {
+        shm_send(&mem->a_to_b, wake_b, packet, PACKET_SIZE);
+    }
+    uint8_t end[PACKET_SIZE] = {0xff};
+    shm_send(&mem->a_to_b, wake_b, end, sizeof(end));
+    long received = 0;
+    shm_recv(&mem->b_to_a, wake_a, &received, sizeof(received));
+    t = now() - t;
+    printf("shm  throughput %10.0f msg/s  (%ld of %ld delivered)\n", received / t, received, stream);
+
+    waitpid(pid, NULL, 0);
+    free(rtt);
+    close(wake_a);
+    close(wake_b);
+    munmap(mem, sizeof(struct shm_pair));
+}
+
+int main(int argc, char *argv[]) {
+    long rounds = argc > 1 ? atol(argv[1]) : 20000;
+    long stream = argc > 2 ? atol(argv[2]) : 1000000;
+
+    // "/set/level/cut\0\0" ",if\0" int32 float32, as lo_message_serialise would write it
+    uint8_t packet[PACKET_SIZE] = "/set/level/cut\0\0,if";
+    memset(packet + 20, 0, 8);
+
+    printf("packets: %d bytes, %ld round trips, %ld streamed\n", PACKET_SIZE, rounds, stream);
+    udp_bench(rounds, stream, packet);
+    shm_bench(rounds, stream, packet);
+    return 0;
+}